@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeBezier.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace
+{
+	std::vector< CubeCore::Vec3 > MakeControlPoints( const int32_t Count )
+	{
+		std::vector< CubeCore::Vec3 > Points;
+
+		for( int32_t i = 0; i < Count; ++i )
+			Points.emplace_back( i * 400.0f, ( i % 2 ) ? 300.0f : -300.0f, 0.0f );
+
+		return Points;
+	}
+
+	// Point count picks the quadratic / cubic closed forms or the general Bernstein sum
+	void BM_Bezier( benchmark::State& State )
+	{
+		const auto Points = MakeControlPoints( int32_t( State.range( 0 ) ) );
+		float Interval = 0.0f;
+
+		for( auto _ : State )
+		{
+			benchmark::DoNotOptimize( CubeCore::Bezier( Interval, Points.data(), int32_t( Points.size() ) ) );
+			Interval = Interval < 1.0f ? Interval + 0.001f : 0.0f;
+		}
+	}
+	BENCHMARK( BM_Bezier )->Arg( 3 )->Arg( 4 )->Arg( 6 )->Arg( 12 );
+
+	// Default step count of the evenly spaced obstacle spawner
+	void BM_BezierLength( benchmark::State& State )
+	{
+		const auto Points = MakeControlPoints( int32_t( State.range( 0 ) ) );
+
+		for( auto _ : State )
+			benchmark::DoNotOptimize( CubeCore::BezierLength( Points.data(), int32_t( Points.size() ), 150 ) );
+	}
+	BENCHMARK( BM_BezierLength )->Arg( 3 )->Arg( 4 )->Arg( 6 );
+
+	void BM_Binomial( benchmark::State& State )
+	{
+		int32_t n = 0;
+
+		for( auto _ : State )
+		{
+			benchmark::DoNotOptimize( CubeCore::Binomial( n, n / 2 ) );
+			n = ( n + 1 ) % ( CubeCore::MaxBinomialN + 1 );
+		}
+	}
+	BENCHMARK( BM_Binomial );
+}
@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Checks stay on in the Release builds the benchmarks default to
+#undef NDEBUG
+
+#include "CubeBezier.h"
+#include "CubeSpawnQueue.h"
+#include "CubeTrack.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	struct QueuePayload
+	{
+		int32_t Variation = -1;
+	};
+
+	using Queue = CubeCore::SpawnQueue< QueuePayload >;
+
+	bool NearlyEqual( const float A, const float B, const float Tolerance = 1.e-3f )
+	{
+		return std::fabs( A - B ) <= Tolerance;
+	}
+
+	bool NearlyEqual( const CubeCore::Vec3& A, const CubeCore::Vec3& B, const float Tolerance = 1.e-3f )
+	{
+		return NearlyEqual( A.X, B.X, Tolerance ) && NearlyEqual( A.Y, B.Y, Tolerance ) && NearlyEqual( A.Z, B.Z, Tolerance );
+	}
+
+	void TestSpawnQueueOrder()
+	{
+		Queue Pieces;
+		assert( !Pieces.Root() && Pieces.Num() == 0 );
+
+		for( int32_t i = 0; i < 3; ++i )
+			Pieces.Append()->Variation = i;
+
+		assert( Pieces.Num() == 3 );
+
+		for( int32_t i = 0; i < 3; ++i )
+		{
+			assert( Pieces.Root() && Pieces.Root()->Variation == i );
+			Pieces.PopFront();
+		}
+
+		assert( !Pieces.Root() && Pieces.Num() == 0 );
+
+		// Nothing to pop
+		Pieces.PopFront();
+		assert( !Pieces.Root() );
+	}
+
+	void TestSpawnQueueSplit()
+	{
+		// Split with two branches of one piece each, then a piece appended after the split closes
+		Queue Pieces;
+		Pieces.AppendSplit()->Variation = 0;
+		Pieces.Append()->Variation = 1;
+		Pieces.EndSplit( 3 );
+		Pieces.Append()->Variation = 2;
+		Pieces.EndSplit( 3 );
+		Pieces.ClearCursor();
+		Pieces.Append()->Variation = 3;
+
+		auto* Split = Pieces.Root();
+		assert( Split->Variation == 0 && Split->NextQueueItems.size() == 2 );
+		assert( Split->NextQueueItems[ 0 ]->Variation == 1 && Split->NextQueueItems[ 1 ]->Variation == 2 );
+
+		// Appending after a closed split continues from the last branch
+		assert( Split->NextQueueItems[ 1 ]->NextQueueItems.size() == 1 && Split->NextQueueItems[ 1 ]->NextQueueItems[ 0 ]->Variation == 3 );
+		assert( Pieces.Num() == 4 );
+
+		// Taking the second branch frees the first
+		Pieces.SelectBranch( 1 );
+		assert( Pieces.Root()->Variation == 2 && Pieces.Num() == 2 );
+
+		Pieces.PopFront();
+		assert( Pieces.Root()->Variation == 3 && Pieces.Num() == 1 );
+
+		// Out of range branch empties the queue
+		Pieces.Reset();
+		Pieces.AppendSplit();
+		Pieces.Append();
+		Pieces.EndSplit( 2 );
+		Pieces.SelectBranch( 5 );
+		assert( !Pieces.Root() && Pieces.Num() == 0 );
+
+		// Appends after popping the split item itself must not go through the freed cursor
+		Pieces.AppendSplit()->Variation = 4;
+		Pieces.SelectBranch( 0 );
+		Pieces.Append()->Variation = 5;
+		assert( Pieces.Root() && Pieces.Root()->Variation == 5 && Pieces.Num() == 1 );
+	}
+
+	void TestBinomial()
+	{
+		assert( CubeCore::Binomial( 0, 0 ) == 1 );
+		assert( CubeCore::Binomial( 5, 2 ) == 10 );
+		assert( CubeCore::Binomial( 10, 5 ) == 252 );
+		assert( CubeCore::Binomial( CubeCore::MaxBinomialN, 1 ) == CubeCore::MaxBinomialN );
+		assert( CubeCore::Binomial( 4, 5 ) == 0 && CubeCore::Binomial( 4, -1 ) == 0 );
+		assert( CubeCore::Binomial( CubeCore::MaxBinomialN + 1, 1 ) == 0 );
+	}
+
+	void TestBezier()
+	{
+		const CubeCore::Vec3 Points[] = { { 0.0f, 0.0f, 0.0f }, { 100.0f, 200.0f, 0.0f }, { 300.0f, 200.0f, 50.0f }, { 400.0f, 0.0f, 0.0f } };
+
+		// Every form starts and ends on the first and last control points
+		for( int32_t Count = 2; Count <= 4; ++Count )
+		{
+			assert( NearlyEqual( CubeCore::Bezier( 0.0f, Points, Count ), Points[ 0 ] ) );
+			assert( NearlyEqual( CubeCore::Bezier( 1.0f, Points, Count ), Points[ Count - 1 ] ) );
+		}
+
+		// Closed forms agree with the general path
+		assert( NearlyEqual( CubeCore::Bezier( 0.5f, Points, 3 ), CubeCore::BezierQuadratic( 0.5f, Points[ 0 ], Points[ 1 ], Points[ 2 ] ) ) );
+		assert( NearlyEqual( CubeCore::Bezier( 0.25f, Points, 4 ), CubeCore::BezierCubic( 0.25f, Points[ 0 ], Points[ 1 ], Points[ 2 ], Points[ 3 ] ) ) );
+		assert( NearlyEqual( CubeCore::BezierQuadratic( 0.5f, Points[ 0 ], Points[ 1 ], Points[ 2 ] ), CubeCore::Vec3( 125.0f, 150.0f, 12.5f ) ) );
+
+		// Two points is a straight line, the length stops one step short of the end as it always has
+		assert( NearlyEqual( CubeCore::Bezier( 0.5f, Points, 2 ), CubeCore::Vec3( 50.0f, 100.0f, 0.0f ) ) );
+		assert( NearlyEqual( CubeCore::BezierLength( Points, 2, 16 ), CubeCore::Length( Points[ 1 ] - Points[ 0 ] ) * 15.0f / 16.0f ) );
+
+		// Never shorter than the chord it covers or longer than the control polygon
+		const auto CurveLength = CubeCore::BezierLength( Points, 4, 64 );
+		assert( CurveLength >= CubeCore::Length( CubeCore::Bezier( 63.0f / 64.0f, Points, 4 ) - Points[ 0 ] ) );
+		assert( CurveLength <= CubeCore::Length( Points[ 1 ] - Points[ 0 ] ) + CubeCore::Length( Points[ 2 ] - Points[ 1 ] ) + CubeCore::Length( Points[ 3 ] - Points[ 2 ] ) );
+	}
+
+	void TestTrackExit()
+	{
+		const CubeCore::Vec3 Exit( 1000.0f, 0.0f, 0.0f );
+		const CubeCore::Vec3 Forward( 1.0f, 0.0f, 0.0f );
+
+		assert( !CubeCore::HasPassedPlane( CubeCore::Vec3( 999.0f, 500.0f, 0.0f ), Exit, Forward ) );
+		assert( CubeCore::HasPassedPlane( Exit, Exit, Forward ) );
+		assert( CubeCore::HasPassedPlane( CubeCore::Vec3( 1001.0f, -500.0f, 100.0f ), Exit, Forward ) );
+
+		// Exit of a left turn faces sideways
+		const CubeCore::Vec3 Left( 0.0f, -1.0f, 0.0f );
+		assert( !CubeCore::HasPassedPlane( CubeCore::Vec3( 2000.0f, 0.0f, 0.0f ), CubeCore::Vec3( 1000.0f, -500.0f, 0.0f ), Left ) );
+		assert( CubeCore::HasPassedPlane( CubeCore::Vec3( 1000.0f, -600.0f, 0.0f ), CubeCore::Vec3( 1000.0f, -500.0f, 0.0f ), Left ) );
+
+		const CubeCore::Vec3 Entry( 0.0f, 0.0f, 0.0f );
+		assert( NearlyEqual( CubeCore::TrackProgress( Entry, Entry, Exit ), 0.0f ) );
+		assert( NearlyEqual( CubeCore::TrackProgress( CubeCore::Vec3( 250.0f, 300.0f, 0.0f ), Entry, Exit ), 0.25f ) );
+		assert( NearlyEqual( CubeCore::TrackProgress( Exit, Entry, Exit ), 1.0f ) );
+		assert( CubeCore::TrackProgress( CubeCore::Vec3( 1500.0f, 0.0f, 0.0f ), Entry, Exit ) > 1.0f );
+
+		// A piece with no length counts as finished
+		assert( NearlyEqual( CubeCore::TrackProgress( CubeCore::Vec3( -50.0f, 0.0f, 0.0f ), Entry, Entry ), 1.0f ) );
+	}
+}
+
+int main()
+{
+	TestSpawnQueueOrder();
+	TestSpawnQueueSplit();
+	TestBinomial();
+	TestBezier();
+	TestTrackExit();
+
+	std::printf( "CubeCoreTests passed\n" );
+	return 0;
+}
@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeGridPath.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+	// Path length in grid cells, with every seventh lateral column blocked to force some backtracking
+	void BM_FindGridPath( benchmark::State& State )
+	{
+		CubeCore::GridPathParams Params;
+		Params.Forward = CubeCore::Vec3( 1.0f, 0.0f, 0.0f );
+		Params.Right = CubeCore::Vec3( 0.0f, 1.0f, 0.0f );
+		Params.MaxDistance = Params.GridSize * float( State.range( 0 ) );
+
+		const auto IsBlocked = [ &Params ]( const CubeCore::Vec3& Location )
+		{
+			const auto Column = int32_t( Location.Y / Params.GridSize );
+			return Column != 0 && Column % 7 == 0;
+		};
+
+		CubeCore::RandomStream Random( 1234 );
+		std::vector< CubeCore::Vec3 > Path;
+
+		for( auto _ : State )
+		{
+			Path.clear();
+			benchmark::DoNotOptimize( CubeCore::FindGridPath( Params, IsBlocked, Random, Path ) );
+		}
+	}
+	BENCHMARK( BM_FindGridPath )->Arg( 10 )->Arg( 40 )->Arg( 160 );
+}
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubePieceSelection.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace
+{
+	// Candidate count, four pieces per difficulty with probabilities that add up to 1
+	void BM_SelectPieceByDifficulty( benchmark::State& State )
+	{
+		std::vector< CubeCore::PieceCandidate > Candidates;
+
+		for( int32_t i = 0; i < State.range( 0 ); ++i )
+			Candidates.push_back( { 1 + i / 4, 0.25f } );
+
+		CubeCore::RandomStream Random( 1234 );
+		const float GameProgress = float( Candidates.back().Difficulty );
+
+		for( auto _ : State )
+			benchmark::DoNotOptimize( CubeCore::SelectPieceByDifficulty( Candidates.data(), int32_t( Candidates.size() ), GameProgress, Random ) );
+	}
+	BENCHMARK( BM_SelectPieceByDifficulty )->Arg( 8 )->Arg( 32 )->Arg( 128 );
+}
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeSpawnQueue.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+	struct QueuePayload
+	{
+		const void* PieceClass = nullptr;
+		int32_t Variation = -1;
+	};
+
+	// Fills and drains the queue the way a run does, a split with two branches every eight pieces
+	void BM_SpawnQueueFillDrain( benchmark::State& State )
+	{
+		const auto Pieces = int32_t( State.range( 0 ) );
+
+		for( auto _ : State )
+		{
+			CubeCore::SpawnQueue< QueuePayload > Queue;
+
+			for( int32_t i = 0; i < Pieces; ++i )
+			{
+				if( i % 8 == 7 )
+				{
+					Queue.AppendSplit();
+					Queue.Append();
+					Queue.EndSplit( 2 );
+					Queue.Append();
+					Queue.EndSplit( 2 );
+				}
+				else Queue.Append()->Variation = i;
+			}
+
+			while( auto* Front = Queue.Root() )
+			{
+				if( Front->NextQueueItems.size() > 1 )
+					Queue.SelectBranch( 0 );
+				else
+					Queue.PopFront();
+			}
+
+			benchmark::DoNotOptimize( Queue.Root() );
+		}
+	}
+	BENCHMARK( BM_SpawnQueueFillDrain )->Arg( 16 )->Arg( 256 );
+}
@@ -3,21 +3,10 @@
 #pragma once
 
 #include "BasePlayerPawn.h"
+#include "Core/CubeCoreTypes.h"
 #include <vector>
 #include "BaseAIPawn.generated.h"
 
-struct PathNode
-{
-	PathNode* CameFrom;
-	FVector Location;
-	
-	PathNode( FVector Pos ) 
-		: CameFrom( nullptr )
-		, Location( Pos )
-	{ 
-	}
-};
-
 UCLASS()
 class CUBERUNNER_API ABaseAIPawn : public ABasePlayerPawn
 {
@@ -33,7 +22,6 @@ public:
 
 private:
 	void ProcessPathFinding( float DeltaSeconds );
-	void ReconstructPath( PathNode* FinalNode );
 	void ProcessAIMovement( float DeltaSeconds );
 	bool CheckLocationCollision( FVector Location );
 
@@ -44,5 +32,5 @@ public:
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Stats" ) int32 MaximumPathDistance;
 
 private:
-	std::vector< FVector > CurrentPath;
+	std::vector< CubeCore::Vec3 > CurrentPath;
 };
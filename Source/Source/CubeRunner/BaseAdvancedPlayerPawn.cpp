@@ -27,6 +27,14 @@ void ABaseAdvancedPlayerPawn::SetupPlayerInputComponent( class UInputComponent*
 }
 
 void ABaseAdvancedPlayerPawn::MoveForwards( float AxisValue )
+{
+	if( IsInputLocked() )
+		return;
+
+	FrameInput.Forwards = AxisValue;
+}
+
+void ABaseAdvancedPlayerPawn::AddForwardInput( float AxisValue, float DeltaTime )
 {
 	if( AxisValue != 0.0f && !DisableMovement )
 	{
@@ -38,7 +46,6 @@ void ABaseAdvancedPlayerPawn::MoveForwards( float AxisValue )
 		if( IsAlive )
 		{
 			// With the advanced forward / backward movement, either direction causes your strafe max speed to decrease (not increase if going faster)
-			const float DeltaTime = GetWorld()->DeltaTimeSeconds;
 			auto Increase = AddedForwardAcceleration * AxisValue * ( IsValid( CurrentTurnFloorPiece ) ? 0.8f : 1.0f );
 			AddedForwardVelocity = FMath::Clamp( AddedForwardVelocity + Increase * DeltaTime, -AddedForwardMaxSpeed * 0.8f, AddedForwardMaxSpeed );
 			UpdateStrafeMaxSpeed();
@@ -54,6 +61,11 @@ void ABaseAdvancedPlayerPawn::JumpInput()
 
 void ABaseAdvancedPlayerPawn::Jump()
 {
+	if( IsInputLocked() )
+		return;
+
+	FrameInput.Jump = true;
+
 	if( !JumpTimerHandle.IsValid() && StartTimer == 0.0f && IsAlive && !DisableMovement )
 	{
 		// Can only jump when you are closish to the ground
@@ -79,31 +91,38 @@ void ABaseAdvancedPlayerPawn::ProcessMovement( float DeltaTime )
 	{
 		const auto Forward = GetActorForwardVector() * AddedForwardVelocity;
 		TotalDistanceTravelled += AddedForwardVelocity * DeltaTime;
-		AddActorWorldOffset( Forward * DeltaTime );
+		SweptMove( Forward * DeltaTime, true );
 	}
 }
 
-void ABaseAdvancedPlayerPawn::Gravity( FVector Gravity )
+void ABaseAdvancedPlayerPawn::ApplyFrameInput( float DeltaTime )
 {
-	ABasePlayerPawn::Gravity( Gravity );
+	ABasePlayerPawn::ApplyFrameInput( DeltaTime );
+	AddForwardInput( FrameInput.Forwards, DeltaTime );
 
-	if( InputMode == EInputMode::EIM_GYROSCOPIC && !DisableMovement )
+	if( InputMode == EInputMode::EIM_GYROSCOPIC && FrameInput.Gravity.Size() != 0.0f )
 	{
-		if( Gravity.Size() != 0.0f )
-		{
-			const auto NormalisedAngle = FMath::Min( 1.0f, FMath::Max( -1.0f, ( Gravity.Z + 4.5f ) / 4.0f ) );
-			MoveForwards( FMath::Min( 1.0f, FMath::Max( -1.0f, NormalisedAngle * RotationRateSensitivity ) ) );
-		}
+		const auto NormalisedAngle = FMath::Min( 1.0f, FMath::Max( -1.0f, ( FrameInput.Gravity.Z + 4.5f ) / 4.0f ) );
+		AddForwardInput( FMath::Min( 1.0f, FMath::Max( -1.0f, NormalisedAngle * RotationRateSensitivity ) ), DeltaTime );
 	}
 }
 
-void ABaseAdvancedPlayerPawn::ApplyFriction()
+void ABaseAdvancedPlayerPawn::ApplyReplayFrame( const FCubeReplayFrame& Frame )
+{
+	ABasePlayerPawn::ApplyReplayFrame( Frame );
+	MoveForwards( Frame.Forwards );
+
+	if( Frame.Jump )
+		Jump();
+}
+
+void ABaseAdvancedPlayerPawn::ApplyFriction( float DeltaTime )
 {
-	ABasePlayerPawn::ApplyFriction();
+	ABasePlayerPawn::ApplyFriction( DeltaTime );
 
 	if( !IsValid( CurrentTurnFloorPiece ) )
 	{
-		AddedForwardVelocity *= AddedForwardFriction;
+		AddedForwardVelocity *= ScaleToStep( AddedForwardFriction, DeltaTime );
 
 		if( FMath::Abs( AddedForwardVelocity ) <= 0.1f )
 			AddedForwardVelocity = 0.0f;
@@ -28,9 +28,11 @@ public:
 	void JumpReset();
 
 protected:
-	void Gravity( FVector Gravity ) override;
+	void ApplyReplayFrame( const FCubeReplayFrame& Frame ) override;
+	void ApplyFrameInput( float DeltaTime ) override;
+	void AddForwardInput( float AxisValue, float DeltaTime );
 	void ProcessMovement( float DeltaTime ) override;
-	void ApplyFriction() override;
+	void ApplyFriction( float DeltaTime ) override;
 	void UpdateStrafeMaxSpeed() override;
 	void BeginTurn( ABaseTurnFloorPiece* TurnPiece ) override;
 
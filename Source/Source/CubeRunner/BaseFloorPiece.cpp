@@ -6,25 +6,122 @@
 #include "CubeRunnerGameMode.h"
 #include "Components/ArrowComponent.h"
 #include "BaseTransitionFloorPiece.h"
-#include <vector>
+#include "BaseTurnFloorPiece.h"
 #include "BaseObstacle.h"
+#include "BaseUpgrade.h"
+#include "ObstacleInstanceManager.h"
+#include "BaseWallPiece.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "CubeDataSingleton.h"
 #include "BaseObstacleComponent.h"
+#include "ObstacleLayoutCache.h"
+#include "FloorPieceProfiler.h"
+#include "CubeMemory.h"
+#include "CubeCoreBridge.h"
+#include "Core/CubeBezier.h"
 #include "CubeGameInstance.h"
 #include "CubeSingletonDataLibrary.h"
 #include "Components/BoxComponent.h"
 #include "GameFramework/Actor.h"
 #include "Kismet/GameplayStatics.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "Engine/SimpleConstructionScript.h"
+#include "Engine/SCS_Node.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT( TEXT( "Piece Components Per Spawn" ), STAT_PieceComponentsPerSpawn, STATGROUP_CubeRunner );
+DECLARE_DWORD_ACCUMULATOR_STAT( TEXT( "Piece Components Pruned Per Spawn" ), STAT_PieceComponentsPrunedPerSpawn, STATGROUP_CubeRunner );
+DECLARE_DWORD_COUNTER_STAT( TEXT( "Piece Variation Tables Built" ), STAT_PieceVariationTablesBuilt, STATGROUP_CubeRunner );
 
 // Static data
 namespace
 {
 	bool InstancedObstacleSpawningEnabled = true;
 	float ObstacleSpawnTraceHeight = 3000.0f;
-}
+	float UpgradeCellSize = 120.0f;
+	float UpgradeEdgeMargin = 60.0f;
+
+	// Which of a piece class's construction script obstacles belong to which variation
+	struct FVariationTable
+	{
+		TMap< FName, TArray< int32 > > ComponentVariations;
+		TMap< FName, int32 > ChildActorVariations;
+		TMap< int32, TArray< FName > > ExcludedChildActors;
+		int32 ComponentCount = 0;
+
+		const TArray< FName >& GetExcludedChildActors( const int32 Variation )
+		{
+			if( const auto* Found = ExcludedChildActors.Find( Variation ) )
+				return *Found;
+
+			auto& Excluded = ExcludedChildActors.Add( Variation );
+
+			for( const auto& Pair : ChildActorVariations )
+				if( Pair.Value != 0 && Pair.Value != Variation )
+					Excluded.Add( Pair.Key );
+
+			return Excluded;
+		}
+	};
+
+	TMap< UClass*, FVariationTable > VariationTables;
+
+	void BuildVariationTable( UClass* Class, FVariationTable& Table )
+	{
+		INC_DWORD_STAT( STAT_PieceVariationTablesBuilt );
+		auto* ActualClass = Cast< UBlueprintGeneratedClass >( Class );
+
+		for( auto* Current = Class; Current; Current = Current->GetSuperClass() )
+		{
+			const auto* BPClass = Cast< UBlueprintGeneratedClass >( Current );
+
+			if( !BPClass || !BPClass->SimpleConstructionScript )
+				continue;
+
+			for( auto* Node : BPClass->SimpleConstructionScript->GetAllNodes() )
+			{
+				const auto* Template = Node ? Node->GetActualComponentTemplate( ActualClass ) : nullptr;
+
+				if( !Template )
+					continue;
+
+				Table.ComponentCount++;
+
+				if( const auto* Obstacle = Cast< UBaseObstacleComponent >( Template ) )
+				{
+					Table.ComponentVariations.Add( Node->GetVariableName(), Obstacle->Variations );
+				}
+				else if( const auto* ChildActor = Cast< UChildActorComponent >( Template ) )
+				{
+					const auto* ChildTemplate = Cast< ABaseObstacle >( ChildActor->GetChildActorTemplate() );
+
+					if( !ChildTemplate && ChildActor->GetChildActorClass() )
+						ChildTemplate = Cast< ABaseObstacle >( ChildActor->GetChildActorClass()->GetDefaultObject() );
+
+					if( ChildTemplate )
+						Table.ChildActorVariations.Add( Node->GetVariableName(), ChildTemplate->Variation );
+				}
+			}
+		}
+	}
+
+	// Built once per class in game, rebuilt every time in the editor where blueprints are recompiled
+	FVariationTable& GetVariationTable( UClass* Class, UWorld* World, FVariationTable& Scratch )
+	{
+		if( !World || !World->IsGameWorld() )
+		{
+			Scratch = FVariationTable();
+			BuildVariationTable( Class, Scratch );
+			return Scratch;
+		}
 
-TArray< TArray < int32 > > ABaseFloorPiece::BinomialLookUpTable;
+		if( auto* Found = VariationTables.Find( Class ) )
+			return *Found;
+
+		auto& Table = VariationTables.Add( Class );
+		BuildVariationTable( Class, Table );
+		return Table;
+	}
+}
 
 // Sets default values
 ABaseFloorPiece::ABaseFloorPiece( const FObjectInitializer& ObjectInitializer )
@@ -37,11 +134,21 @@ ABaseFloorPiece::ABaseFloorPiece( const FObjectInitializer& ObjectInitializer )
 	, MaxVariationAdvanced( 0 )
 	, UpgradeActor( nullptr )
 	, EndLevelPiece( false )
+	, ConnectionTransform( FTransform::Identity )
+	, UpgradeZoneTransform( FTransform::Identity )
+	, UpgradeZoneExtent( 0.0f, 0.0f, 0.0f )
+	, CacheObstacleLayout( true )
+	, AllowPooling( true )
 	, SpawnedChildObstacles( TArray< FChildObstacle >() )
 	, InstancedObstacleData( TMap< UStaticMesh*, FInstancedObstacleDataContainer >() )
 	, CoolDownCounter( 0 )
 	, ConstructionScriptRun( false )
 	, HasTriggered( false )
+	, InstancedObstaclesCommitted( false )
+	, InstancedObstaclesHidden( false )
+	, ObstacleLayoutState( EObstacleLayoutState::Unknown )
+	, UpgradeCellCount( 0, 0 )
+	, UpgradeCellStep( 0.0f, 0.0f )
 {
 	PrimaryActorTick.bCanEverTick = true;
 
@@ -49,28 +156,65 @@ ABaseFloorPiece::ABaseFloorPiece( const FObjectInitializer& ObjectInitializer )
 	Root = CreateDefaultSubobject<USceneComponent>( TEXT( "Root" ) );
 	RootComponent = Root;
 
-	RootDir = CreateDefaultSubobject<UArrowComponent>( TEXT( "Root Direction" ) );
-	RootDir->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
-	RootDir->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+	// Markers only, their transforms are baked into data so nothing needs to register at runtime
+	RootDir = CreateEditorOnlyDefaultSubobject<UArrowComponent>( TEXT( "Root Direction" ) );
+
+	if( RootDir )
+	{
+		RootDir->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
+		RootDir->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+	}
 
 	FloorMesh = CreateDefaultSubobject<UStaticMeshComponent>( TEXT( "Floor Mesh" ) );
 	FloorMesh->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
 
-	ConnectionPoint = CreateDefaultSubobject<UArrowComponent>( TEXT( "Connection Point" ) );
-	ConnectionPoint->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
-	ConnectionPoint->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+	ConnectionPoint = CreateEditorOnlyDefaultSubobject<UArrowComponent>( TEXT( "Connection Point" ) );
+
+	if( ConnectionPoint )
+	{
+		ConnectionPoint->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
+		ConnectionPoint->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+	}
 
 	SpawnCollison = CreateDefaultSubobject<UBoxComponent>( TEXT( "Spawn Collision" ) );
 	SpawnCollison->AttachToComponent( FloorMesh, FAttachmentTransformRules::KeepRelativeTransform );
-	SpawnCollison->SetCollisionEnabled( ECollisionEnabled::QueryOnly );
-	SpawnCollison->SetGenerateOverlapEvents( true );
+	SpawnCollison->SetCollisionEnabled( ECollisionEnabled::NoCollision );
+	SpawnCollison->SetGenerateOverlapEvents( false );
+
+	UpgradeSpawnZone = CreateEditorOnlyDefaultSubobject<UBoxComponent>( TEXT( "Upgade Spawn Zone" ) );
+
+	if( UpgradeSpawnZone )
+	{
+		UpgradeSpawnZone->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
+		UpgradeSpawnZone->SetCollisionEnabled( ECollisionEnabled::NoCollision );
+		UpgradeSpawnZone->SetGenerateOverlapEvents( false );
+		UpgradeSpawnZone->SetWorldScale3D( FVector( 0.0f, 0.0f, 0.0f ) );
+	}
+}
+
+#if WITH_EDITOR
+void ABaseFloorPiece::PreSave( const ITargetPlatform* TargetPlatform )
+{
+	// Covers the class defaults, which is what cooked builds spawn from
+	BakeMarkers();
+
+	Super::PreSave( TargetPlatform );
+}
+
+void ABaseFloorPiece::BakeMarkers()
+{
+	// The arrows are scaled up to be visible, only their position and direction matter
+	if( ConnectionPoint )
+		ConnectionTransform = FTransform( ConnectionPoint->GetRelativeRotation(), ConnectionPoint->GetRelativeLocation() );
 
-	UpgradeSpawnZone = CreateDefaultSubobject<UBoxComponent>( TEXT( "Upgade Spawn Zone" ) );
-	UpgradeSpawnZone->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
-	UpgradeSpawnZone->SetCollisionEnabled( ECollisionEnabled::NoCollision );
-	UpgradeSpawnZone->SetGenerateOverlapEvents( false );
-	UpgradeSpawnZone->SetWorldScale3D( FVector( 0.0f, 0.0f, 0.0f ) );
+	if( UpgradeSpawnZone )
+	{
+		UpgradeZoneTransform = FTransform( UpgradeSpawnZone->GetRelativeRotation(), UpgradeSpawnZone->GetRelativeLocation() );
+		UpgradeZoneExtent = UpgradeSpawnZone->GetUnscaledBoxExtent() * UpgradeSpawnZone->GetRelativeScale3D();
+		UpgradeZoneExtent.Z = 0.0f;
+	}
 }
+#endif
 
 void ABaseFloorPiece::Cleanup()
 {
@@ -83,68 +227,21 @@ void ABaseFloorPiece::Cleanup()
 		}
 	}
 
+	ReleaseInstancedObstacles();
+
+	// Upgrades are pooled by the game mode rather than destroyed with the piece
 	if( UpgradeActor )
-		UpgradeActor->Destroy();
+	{
+		if( auto* CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() ) )
+			CubeGM->ReleaseUpgrade( UpgradeActor );
+
+		UpgradeActor = nullptr;
+	}
 }
 
 void ABaseFloorPiece::BeginPlay()
 {
 	Super::BeginPlay();
-
-	// Random chance to spawn an upgrade
-	const auto* GameData = UCubeSingletonDataLibrary::GetGameData();
-
-	if( GameData->DefaultUpgradeBPClass )
-	{
-		if( UpgradeSpawnZone->GetComponentScale() != FVector( 0.0f, 0.0f, 0.0f ) )
-		{
-			// Chance to spawn an upgrade
-			if( GameData->UpgradeSpawnChancePerPiecePercent > FMath::RandRange( 0, 99 ) )
-			{
-				int32 safety = 0;
-
-				while( safety++ < 20 && !UpgradeActor )
-				{
-					// Location
-					const auto Origin = UpgradeSpawnZone->GetComponentLocation();
-					const auto BoxExtent = UpgradeSpawnZone->Bounds.BoxExtent;
-					auto RandPos = UKismetMathLibrary::RandomPointInBoundingBox( Origin, FVector( BoxExtent.X - 60.0f, BoxExtent.Y - 60.0f, 0.0f ) );
-					FRotator Rotation( 0.0f, 0.0f, 0.0f );
-
-					// Find correct height to hover at
-					FCollisionQueryParams trace_params = FCollisionQueryParams( FName( TEXT( "Spawn_Trace" ) ), true, nullptr );
-					FHitResult trace_hit( ForceInit );
-
-					auto start = FVector( RandPos.X, RandPos.Y, FloorMesh->GetComponentLocation().Z + ObstacleSpawnTraceHeight );
-					auto end = FVector( RandPos.X, RandPos.Y, FloorMesh->GetComponentLocation().Z - ObstacleSpawnTraceHeight );
-
-					if ( !ActorLineTraceSingle( trace_hit, start, end, ECC_Visibility, trace_params ) )
-					{
-						UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::BeginPlay | UpgradeBPClass failed to adjust hover height due to line trace returning NULL", LogDisplayType::Warn );
-					}
-					else
-					{
-						RandPos.Z += trace_hit.ImpactPoint.Z;
-						Rotation = FRotationMatrix::MakeFromX( trace_hit.ImpactNormal ).ToQuat().Rotator();
-					}
-
-					// Spawn params
-					FActorSpawnParameters SpawnParams;
-					SpawnParams.bAllowDuringConstructionScript = false;
-					SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
-					SpawnParams.bDeferConstruction = false;
-
-					UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::BeginPlay | Tying to spawn upgrade: " + GameData->DefaultUpgradeBPClass->GetPathName() +
-						", Pos: " + FString::FromInt( RandPos.X ) + ", " + FString::FromInt( RandPos.Y ) );
-					UpgradeActor = GetWorld()->SpawnActor( GameData->DefaultUpgradeBPClass, &RandPos, &Rotation, SpawnParams );
-				}
-
-				if( safety >= 20 )
-					UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::BeginPlay | UpgradeBPClass failed to spawn", LogDisplayType::Warn );
-			}
-		}
-	}
-	else UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::BeginPlay | UpgradeBPClass UClass not valid ", LogDisplayType::Warn );
 }
 
 void ABaseFloorPiece::OnConstruction( const FTransform& Transform )
@@ -153,36 +250,60 @@ void ABaseFloorPiece::OnConstruction( const FTransform& Transform )
 
 	ConstructionScriptRun = false;
 
-	auto scale = UpgradeSpawnZone->GetComponentScale();
-	scale.Z = 0.0f;
-	UpgradeSpawnZone->SetWorldScale3D( scale );
+#if WITH_EDITOR
+	if( UpgradeSpawnZone )
+	{
+		auto scale = UpgradeSpawnZone->GetComponentScale();
+		scale.Z = 0.0f;
+		UpgradeSpawnZone->SetWorldScale3D( scale );
+	}
 
-	TArray< USceneComponent* > children;
-	GetRootComponent()->GetChildrenComponents( true, children );
+	BakeMarkers();
+#endif
 
-	// Destroys obstacles that don't match the current variation (not permanently) 
-	for( auto* component : children )
+	FVariationTable Scratch;
+	auto& Table = GetVariationTable( GetClass(), GetWorld(), Scratch );
+	int32 Pruned = 0;
+
+	// Obstacle components of other variations were never registered (see UBaseObstacleComponent::OnComponentCreated), so they are cheap to drop
+	for( const auto& Pair : Table.ComponentVariations )
 	{
-		auto* child_actor = Cast< UChildActorComponent >( component );
+		if( IsVariationComponent( Pair.Value ) )
+			continue;
 
-		if( IsValid( child_actor ) )
+		if( auto* Obstacle = FindObjectFast< UBaseObstacleComponent >( this, Pair.Key ) )
 		{
-			auto* obstacle = Cast< ABaseObstacle >( child_actor->GetChildActor() );
-
-			if( IsValid( obstacle ) && obstacle->Variation != 0 && obstacle->Variation != Variation )
-				obstacle->Destroy();
+			Obstacle->DestroyComponent();
+			Pruned++;
 		}
+	}
 
-		auto* obstacle = Cast< UBaseObstacleComponent >( component );
+	// Child actors are spawned before we get a say, so they still have to be destroyed (not permanently)
+	for( const auto& Name : Table.GetExcludedChildActors( Variation ) )
+	{
+		auto* ChildActor = FindObjectFast< UChildActorComponent >( this, Name );
 
-		if( IsValid( obstacle ) && obstacle->Variations.Num() )
-			if( obstacle->Variations.Num() && obstacle->Variations[0] != 0 && !obstacle->Variations.Contains( Variation ) )
-				obstacle->DestroyComponent();
+		if( ChildActor && IsValid( ChildActor->GetChildActor() ) )
+		{
+			ChildActor->GetChildActor()->Destroy();
+			Pruned++;
+		}
 	}
+
+	SET_DWORD_STAT( STAT_PieceComponentsPerSpawn, Table.ComponentCount - Pruned );
+	SET_DWORD_STAT( STAT_PieceComponentsPrunedPerSpawn, Pruned );
+}
+
+bool ABaseFloorPiece::IsVariationComponent( const TArray< int32 >& ComponentVariations ) const
+{
+	// No variations or a leading 0 means it belongs to every variation
+	return !ComponentVariations.Num() || ComponentVariations[0] == 0 || ComponentVariations.Contains( Variation );
 }
 
 void ABaseFloorPiece::DestroyObstacles()
 {
+	ReleaseInstancedObstacles();
+
 	for( auto& instance : InstancedObstacleData )
 	{
 		if( instance.Value.InstancedStaticMesh && instance.Value.InstancedStaticMesh->IsValidLowLevel() )
@@ -209,72 +330,495 @@ void ABaseFloorPiece::DestroyObstacles()
 	ConstructionScriptRun = true;
 }
 
+void ABaseFloorPiece::CommitInstancedObstacles( UStaticMesh* Mesh, FInstancedObstacleDataContainer& Container )
+{
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
+	auto* CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() );
+
+	if( !CubeGM )
+		return;
+
+	auto* Manager = CubeGM->GetObstacleInstanceManager();
+	Manager->ReleaseRange( Mesh, Container.RangeStart, Container.RangeCount );
+
+	TArray< FTransform > WorldTransforms;
+	WorldTransforms.Reserve( Container.LocalTransforms.Num() );
+
+	for( const auto& Local : Container.LocalTransforms )
+		WorldTransforms.Add( Local * GetActorTransform() );
+
+	Container.RangeStart = Manager->AllocateRange( Mesh, WorldTransforms );
+	Container.RangeCount = Container.RangeStart != INDEX_NONE ? WorldTransforms.Num() : 0;
+	Container.InstancedStaticMesh = Manager->FindComponent( Mesh );
+
+	if( InstancedObstaclesHidden )
+		Manager->HideRange( Mesh, Container.RangeStart, Container.RangeCount );
+}
+
+void ABaseFloorPiece::ReleaseInstancedObstacles()
+{
+	auto* CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() );
+
+	for( auto& instance : InstancedObstacleData )
+	{
+		if( instance.Value.RangeStart == INDEX_NONE )
+			continue;
+
+		if( CubeGM )
+			CubeGM->GetObstacleInstanceManager()->ReleaseRange( instance.Key, instance.Value.RangeStart, instance.Value.RangeCount );
+
+		// Shared component isn't ours to destroy
+		instance.Value.InstancedStaticMesh = nullptr;
+		instance.Value.RangeStart = INDEX_NONE;
+		instance.Value.RangeCount = 0;
+	}
+
+	InstancedObstaclesCommitted = false;
+	InstancedObstaclesHidden = false;
+}
+
+void ABaseFloorPiece::CommitInstancedObstacles()
+{
+	for( auto& Instance : InstancedObstacleData )
+		CommitInstancedObstacles( Instance.Key, Instance.Value );
+
+	InstancedObstaclesCommitted = true;
+}
+
+void ABaseFloorPiece::ShiftInstancedObstacles( const FVector& LocalDelta )
+{
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
+	for( auto& Instance : InstancedObstacleData )
+	{
+		for( auto& Local : Instance.Value.LocalTransforms )
+			Local.AddToTranslation( LocalDelta );
+
+		UpdateInstancedObstacleRange( Instance.Key, Instance.Value );
+	}
+}
+
+void ABaseFloorPiece::SetInstancedObstaclesHidden( const bool Hidden )
+{
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
+	if( InstancedObstaclesHidden == Hidden )
+		return;
+
+	InstancedObstaclesHidden = Hidden;
+
+	for( auto& Instance : InstancedObstacleData )
+		UpdateInstancedObstacleRange( Instance.Key, Instance.Value );
+}
+
+void ABaseFloorPiece::UpdateInstancedObstacleRange( UStaticMesh* Mesh, const FInstancedObstacleDataContainer& Container )
+{
+	auto* CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() );
+
+	if( !CubeGM || Container.RangeStart == INDEX_NONE )
+		return;
+
+	auto* Manager = CubeGM->GetObstacleInstanceManager();
+
+	if( InstancedObstaclesHidden )
+	{
+		Manager->HideRange( Mesh, Container.RangeStart, Container.RangeCount );
+		return;
+	}
+
+	TArray< FTransform > WorldTransforms;
+	WorldTransforms.Reserve( Container.LocalTransforms.Num() );
+
+	for( const auto& Local : Container.LocalTransforms )
+		WorldTransforms.Add( Local * GetActorTransform() );
+
+	Manager->UpdateRange( Mesh, Container.RangeStart, WorldTransforms );
+}
+
 void ABaseFloorPiece::FloorPieceBeginPlay()
 {
 	OnFloorPieceBeginPlay();
+	CloseObstacleLayout();
+
+	// Hand the instanced obstacles over to the world's shared components
+	if( GetWorld()->IsGameWorld() )
+		CommitInstancedObstacles();
+
+	if( !CorridorEdges.Num() )
+		BuildCorridorFromWalls();
+
+	// Obstacles are all placed and the piece is in its final position by now
+	SpawnUpgrade();
 }
 
-void ABaseFloorPiece::AddMultiConnection( UArrowComponent* Connection, UBoxComponent* Collider )
+void ABaseFloorPiece::FloorPieceReused()
 {
-	if( !MultiConnections.Num() )
-		MultiConnections.Add( FSplitConnection( ConnectionPoint, SpawnCollison ) );
+	SetPooled( false );
+	OnFloorPieceReused();
 
-	MultiConnections.Add( FSplitConnection( Connection, Collider ) );
+	// Construction script obstacles and the corridor are kept from the piece's first use
+	CommitInstancedObstacles();
+	SpawnUpgrade();
 }
 
-FVector ABaseFloorPiece::Bezier( float Interval, TArray< FVector > ControlPoints )
+bool ABaseFloorPiece::CanBePooled() const
 {
-	if( ControlPoints.Num() == 3 )
-		return BezierQuadratic( Interval, ControlPoints[ 0 ], ControlPoints[ 1 ], ControlPoints[ 2 ] );
+	// Obstacles have to be what a new piece of this class and variation would get, moving ones also carry run state
+	return AllowPooling && CacheObstacleLayout && !MultiConnections.Num() && !SpawnedChildObstacles.Num() && !HasWorldSpaceObstacles();
+}
 
-	if( ControlPoints.Num() == 4 )
-		return BezierCubic( Interval, ControlPoints[ 0 ], ControlPoints[ 1 ], ControlPoints[ 2 ], ControlPoints[ 3 ] );
+bool ABaseFloorPiece::HasWorldSpaceObstacles() const
+{
+	// Start location and waypoints are captured in world space when the obstacle begins play
+	TInlineComponentArray< UBaseObstacleComponent* > ObstacleComponents( this );
+
+	for( const auto* Obstacle : ObstacleComponents )
+		if( IsValid( Obstacle ) && Obstacle->IsRegistered() && ( Obstacle->MovementStyle != EMovementStyle::EMS_NONE || Obstacle->WaypointPositions.Num() ) )
+			return true;
+
+	// Child actor obstacles are attached to us
+	TArray< AActor* > AttachedActors;
+	GetAttachedActors( AttachedActors );
 
-	FVector Result( 0.0f, 0.0f, 0.0f );
-	int32 n = ControlPoints.Num() - 1;
+	for( const auto* Actor : AttachedActors )
+		if( Actor && Actor->IsA< ABaseObstacle >() )
+			return true;
+
+	return false;
+}
 
-	for( int32 k = 0; k < ControlPoints.Num(); ++k )
+void ABaseFloorPiece::ReturnToPool()
+{
+	Cleanup();
+	SetPooled( true );
+
+	HasTriggered = false;
+	CoolDownCounter = 0;
+}
+
+void ABaseFloorPiece::SetPooled( const bool Pooled )
+{
+	// Walls and other child actors aren't hidden along with us
+	TArray< AActor* > Actors;
+	GetAttachedActors( Actors );
+	Actors.Add( this );
+
+	for( auto* Actor : Actors )
+	{
+		Actor->SetActorHiddenInGame( Pooled );
+		Actor->SetActorEnableCollision( !Pooled );
+		Actor->SetActorTickEnabled( !Pooled );
+	}
+}
+
+bool ABaseFloorPiece::ReplayCachedObstacleLayout()
+{
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
+	if( ObstacleLayoutState != EObstacleLayoutState::Unknown )
+		return ObstacleLayoutState == EObstacleLayoutState::Replayed;
+
+	// Only the instanced path in game records local transforms, anything else is generated as normal
+	if( !CacheObstacleLayout || !InstancedObstacleSpawningEnabled || !GetWorld()->IsGameWorld() )
 	{
-		Result += ControlPoints[ k ] * Binomial( n, k ) * FMath::Pow( 1.0f - Interval, n - k ) * FMath::Pow( Interval, k );
+		ObstacleLayoutState = EObstacleLayoutState::Closed;
+		return false;
 	}
 
-	return Result;
+	auto* GameInstance = Cast< UCubeGameInstance >( UGameplayStatics::GetGameInstance( GetWorld() ) );
+	const bool ClassicMode = !IsValid( GameInstance ) || GameInstance->ClassicPlayerMode;
+	auto* Layout = FObstacleLayoutCache::Get().Find( GetClass(), Variation, ClassicMode );
+
+	if( !Layout )
+	{
+		ObstacleLayoutState = EObstacleLayoutState::Recording;
+		return false;
+	}
+
+	DestroyObstacles();
+
+	for( auto& LayoutMesh : Layout->Meshes )
+	{
+		auto& Container = InstancedObstacleData.FindOrAdd( LayoutMesh.Resolve() );
+		Container.LocalTransforms.Append( LayoutMesh.LocalTransforms );
+
+		for( const auto& Variations : LayoutMesh.Variations )
+			Container.Data.Emplace( Variations );
+	}
+
+	ObstacleLayoutState = EObstacleLayoutState::Replayed;
+	return true;
+}
+
+void ABaseFloorPiece::CloseObstacleLayout()
+{
+	if( ObstacleLayoutState == EObstacleLayoutState::Recording )
+	{
+		auto* GameInstance = Cast< UCubeGameInstance >( UGameplayStatics::GetGameInstance( GetWorld() ) );
+		const bool ClassicMode = !IsValid( GameInstance ) || GameInstance->ClassicPlayerMode;
+		FObstacleLayoutCache::Get().Add( GetClass(), Variation, ClassicMode, InstancedObstacleData );
+	}
+
+	// Anything spawned from here on isn't part of the class's layout
+	ObstacleLayoutState = EObstacleLayoutState::Closed;
+}
+
+void ABaseFloorPiece::BuildCorridorFromWalls()
+{
+	TArray< AActor* > AttachedActors;
+	GetAttachedActors( AttachedActors );
+
+	for( auto* Actor : AttachedActors )
+	{
+		auto* Wall = Cast< ABaseWallPiece >( Actor );
+
+		if( !IsValid( Wall ) || !Wall->WallMesh || !Wall->WallMesh->GetStaticMesh() )
+			continue;
+
+		// Wall mesh box in piece space
+		const auto Box = Wall->WallMesh->GetStaticMesh()->GetBoundingBox();
+		const auto WallTransform = Wall->WallMesh->GetComponentTransform().GetRelativeTransform( GetActorTransform() );
+		const auto LeftSide = WallTransform.TransformPosition( Box.GetCenter() ).Y < 0.0f;
+		const auto Inward = LeftSide ? FVector::RightVector : FVector::LeftVector;
+		Wall->LeftWall = LeftSide;
+
+		// The face of the box looking towards the middle of the piece (works for angled walls too)
+		const auto AxisX = WallTransform.TransformVectorNoScale( FVector::ForwardVector );
+		const auto AxisY = WallTransform.TransformVectorNoScale( FVector::RightVector );
+		const auto UseX = FMath::Abs( FVector::DotProduct( AxisX, Inward ) ) > FMath::Abs( FVector::DotProduct( AxisY, Inward ) );
+		const auto Sign = FMath::Sign( FVector::DotProduct( UseX ? AxisX : AxisY, Inward ) );
+		const auto Centre = Box.GetCenter();
+		const auto Extent = Box.GetExtent();
+
+		const auto CornerA = WallTransform.TransformPosition( Centre + ( UseX ? FVector( Sign * Extent.X, -Extent.Y, 0.0f ) : FVector( -Extent.X, Sign * Extent.Y, 0.0f ) ) );
+		const auto CornerB = WallTransform.TransformPosition( Centre + ( UseX ? FVector( Sign * Extent.X, Extent.Y, 0.0f ) : FVector( Extent.X, Sign * Extent.Y, 0.0f ) ) );
+		const auto& First = CornerA.X <= CornerB.X ? CornerA : CornerB;
+		const auto& Second = CornerA.X <= CornerB.X ? CornerB : CornerA;
+
+		CorridorEdges.Add( FCorridorEdge( FVector2D( First.X, First.Y ), FVector2D( Second.X, Second.Y ), LeftSide ) );
+	}
+}
+
+bool ABaseFloorPiece::GetCorridorBounds( const float X, float& OutMinY, float& OutMaxY ) const
+{
+	OutMinY = -MAX_flt;
+	OutMaxY = MAX_flt;
+	bool Constrained = false;
+
+	for( const auto& Edge : CorridorEdges )
+	{
+		if( X < FMath::Min( Edge.Start.X, Edge.End.X ) || X > FMath::Max( Edge.Start.X, Edge.End.X ) )
+			continue;
+
+		const auto Length = Edge.End.X - Edge.Start.X;
+		const auto Y = FMath::Abs( Length ) > KINDA_SMALL_NUMBER ? FMath::Lerp( Edge.Start.Y, Edge.End.Y, ( X - Edge.Start.X ) / Length ) : ( Edge.LeftSide ? FMath::Max( Edge.Start.Y, Edge.End.Y ) : FMath::Min( Edge.Start.Y, Edge.End.Y ) );
+
+		if( Edge.LeftSide )
+			OutMinY = FMath::Max( OutMinY, Y );
+		else
+			OutMaxY = FMath::Min( OutMaxY, Y );
+
+		Constrained = true;
+	}
+
+	return Constrained;
+}
+
+void ABaseFloorPiece::BuildUpgradeFreeCells()
+{
+	const auto& Extent = UpgradeZoneExtent;
+	const auto UsableSize = FVector2D( FMath::Max( Extent.X - UpgradeEdgeMargin, 0.0f ), FMath::Max( Extent.Y - UpgradeEdgeMargin, 0.0f ) ) * 2.0f;
+
+	UpgradeCellCount = FIntPoint( FMath::Max( 1, FMath::FloorToInt( UsableSize.X / UpgradeCellSize ) ), FMath::Max( 1, FMath::FloorToInt( UsableSize.Y / UpgradeCellSize ) ) );
+	UpgradeCellStep = FVector2D( FMath::Max( UsableSize.X / UpgradeCellCount.X, 1.0f ), FMath::Max( UsableSize.Y / UpgradeCellCount.Y, 1.0f ) );
+	UpgradeFreeCells.Init( true, UpgradeCellCount.X * UpgradeCellCount.Y );
+
+	const auto ZoneTransform = GetUpgradeZoneTransform();
+
+	// Clears every cell whose centre is within reach of the obstacle's footprint (conservative for rotated obstacles)
+	const auto BlockCells = [&]( const FBoxSphereBounds& Bounds )
+	{
+		const auto Local = ZoneTransform.InverseTransformPosition( Bounds.Origin );
+		const auto Reach = FMath::Max( Bounds.BoxExtent.X, Bounds.BoxExtent.Y ) + UpgradeEdgeMargin;
+		const auto MinX = FMath::Max( 0, FMath::CeilToInt( ( Local.X - Reach ) / UpgradeCellStep.X + UpgradeCellCount.X * 0.5f - 0.5f ) );
+		const auto MaxX = FMath::Min( UpgradeCellCount.X - 1, FMath::FloorToInt( ( Local.X + Reach ) / UpgradeCellStep.X + UpgradeCellCount.X * 0.5f - 0.5f ) );
+		const auto MinY = FMath::Max( 0, FMath::CeilToInt( ( Local.Y - Reach ) / UpgradeCellStep.Y + UpgradeCellCount.Y * 0.5f - 0.5f ) );
+		const auto MaxY = FMath::Min( UpgradeCellCount.Y - 1, FMath::FloorToInt( ( Local.Y + Reach ) / UpgradeCellStep.Y + UpgradeCellCount.Y * 0.5f - 0.5f ) );
+
+		for( int32 y = MinY; y <= MaxY; ++y )
+			for( int32 x = MinX; x <= MaxX; ++x )
+				UpgradeFreeCells[ y * UpgradeCellCount.X + x ] = false;
+	};
+
+	for( const auto& Instance : InstancedObstacleData )
+	{
+		if( !Instance.Key )
+			continue;
+
+		const auto MeshBounds = Instance.Key->GetBounds();
+
+		for( const auto& Local : Instance.Value.LocalTransforms )
+			BlockCells( MeshBounds.TransformBy( Local * GetActorTransform() ) );
+	}
+
+	for( const auto& Obstacle : SpawnedChildObstacles )
+		if( IsValid( Obstacle.Component ) )
+			BlockCells( Obstacle.Component->Bounds );
+
+	TArray< UBaseObstacleComponent* > ObstacleComponents;
+	GetComponents( ObstacleComponents );
+
+	for( auto* Obstacle : ObstacleComponents )
+		if( Obstacle->IsRegistered() )
+			BlockCells( Obstacle->Bounds );
+
+	TArray< UChildActorComponent* > ChildActors;
+	GetComponents( ChildActors );
+
+	for( auto* ChildActor : ChildActors )
+	{
+		if( auto* Obstacle = Cast< ABaseObstacle >( ChildActor->GetChildActor() ) )
+		{
+			FVector Origin, BoxExtent;
+			Obstacle->GetActorBounds( false, Origin, BoxExtent );
+			BlockCells( FBoxSphereBounds( Origin, BoxExtent, BoxExtent.Size() ) );
+		}
+	}
+}
+
+void ABaseFloorPiece::SpawnUpgrade()
+{
+	const auto* GameData = UCubeSingletonDataLibrary::GetGameData();
+
+	if( !GameData->DefaultUpgradeBPClass )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::SpawnUpgrade | UpgradeBPClass UClass not valid ", LogDisplayType::Warn );
+		return;
+	}
+
+	if( UpgradeActor || !HasUpgradeZone() )
+		return;
+
+	// Chance to spawn an upgrade
+	if( GameData->UpgradeSpawnChancePerPiecePercent <= FMath::RandRange( 0, 99 ) )
+		return;
+
+	BuildUpgradeFreeCells();
+
+	const auto FreeCount = UpgradeFreeCells.CountSetBits();
+
+	if( !FreeCount )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::SpawnUpgrade | No free space for an upgrade on " + GetName(), LogDisplayType::Warn );
+		return;
+	}
+
+	auto Pick = FMath::RandRange( 0, FreeCount - 1 );
+	auto CellIndex = 0;
+
+	for( TConstSetBitIterator<> Iter( UpgradeFreeCells ); Iter; ++Iter )
+	{
+		if( Pick-- == 0 )
+		{
+			CellIndex = Iter.GetIndex();
+			break;
+		}
+	}
+
+	// Location
+	const auto ZoneTransform = GetUpgradeZoneTransform();
+	const auto CellX = ( CellIndex % UpgradeCellCount.X ) + 0.5f - UpgradeCellCount.X * 0.5f;
+	const auto CellY = ( CellIndex / UpgradeCellCount.X ) + 0.5f - UpgradeCellCount.Y * 0.5f;
+	auto SpawnPos = ZoneTransform.TransformPosition( FVector( CellX * UpgradeCellStep.X, CellY * UpgradeCellStep.Y, 0.0f ) );
+	FRotator Rotation( 0.0f, 0.0f, 0.0f );
+
+	// Find correct height to hover at
+	FCollisionQueryParams trace_params = FCollisionQueryParams( FName( TEXT( "Spawn_Trace" ) ), true, nullptr );
+	FHitResult trace_hit( ForceInit );
+
+	auto start = FVector( SpawnPos.X, SpawnPos.Y, FloorMesh->GetComponentLocation().Z + ObstacleSpawnTraceHeight );
+	auto end = FVector( SpawnPos.X, SpawnPos.Y, FloorMesh->GetComponentLocation().Z - ObstacleSpawnTraceHeight );
+
+	FFloorPieceProfiler::Get().CountTrace();
+	if( !ActorLineTraceSingle( trace_hit, start, end, ECC_Visibility, trace_params ) )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::SpawnUpgrade | UpgradeBPClass failed to adjust hover height due to line trace returning NULL", LogDisplayType::Warn );
+	}
+	else
+	{
+		SpawnPos.Z += trace_hit.ImpactPoint.Z;
+		Rotation = FRotationMatrix::MakeFromX( trace_hit.ImpactNormal ).ToQuat().Rotator();
+	}
+
+	if( auto* CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() ) )
+		UpgradeActor = CubeGM->AcquireUpgrade( FTransform( Rotation, SpawnPos ) );
+}
+
+void ABaseFloorPiece::AddMultiConnection( UArrowComponent* Connection, UBoxComponent* Collider )
+{
+	if( !MultiConnections.Num() )
+		MultiConnections.Add( FSplitConnection( ConnectionPoint, SpawnCollison, ConnectionTransform ) );
+
+	if( !Connection )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::AddMultiConnection | Invalid connection point on " + GetName(), LogDisplayType::Error );
+		return;
+	}
+
+	auto Relative = Connection->GetComponentTransform().GetRelativeTransform( GetActorTransform() );
+	Relative.SetScale3D( FVector( 1.0f, 1.0f, 1.0f ) );
+	MultiConnections.Add( FSplitConnection( Connection, Collider, Relative ) );
+
+	// Branches are picked by the game mode's track progress rather than overlaps
+	if( Collider )
+	{
+		Collider->SetCollisionEnabled( ECollisionEnabled::NoCollision );
+		Collider->SetGenerateOverlapEvents( false );
+	}
+}
+
+FVector ABaseFloorPiece::Bezier( float Interval, const TArray< FVector >& ControlPoints )
+{
+	return Bezier( Interval, MakeArrayView( ControlPoints ) );
+}
+
+FVector ABaseFloorPiece::Bezier( float Interval, TArrayView< const FVector > ControlPoints ) const
+{
+	return ToEngine( CubeCore::Bezier( Interval, ToCore( ControlPoints.GetData() ), ControlPoints.Num() ) );
 }
 
 FVector ABaseFloorPiece::BezierQuadratic( float Interval, FVector Start, FVector Corner, FVector End )
 {
-	const auto t2 = Interval * Interval;
-	const auto mt = 1.0f - Interval;
-	const auto mt2 = mt * mt;
-	return Start * mt2 + Corner * 2.0f * mt * Interval + End * t2;
+	return ToEngine( CubeCore::BezierQuadratic( Interval, ToCore( Start ), ToCore( Corner ), ToCore( End ) ) );
 }
 
 FVector ABaseFloorPiece::BezierCubic( float Interval, FVector Start, FVector CornerA, FVector CornerB, FVector End )
 {
-	const auto t2 = Interval * Interval;
-	const auto t3 = t2 * Interval;
-	const auto mt = 1.0f - Interval;
-	const auto mt2 = mt * mt;
-	const auto mt3 = mt2 * mt;
-	return Start * mt3 + 3.0f * CornerA * mt2 * Interval + 3.0f * CornerB * mt * t2 + End * t3;
+	return ToEngine( CubeCore::BezierCubic( Interval, ToCore( Start ), ToCore( CornerA ), ToCore( CornerB ), ToCore( End ) ) );
 }
 
 void ABaseFloorPiece::SpawnObstacles( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, int32 SpawnVariation, bool SpawnEvenly /*= false*/, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
 {
-	SpawnObstaclesWithMask( ControlPoints, Count, SpawnStyle, TArray< int32 >(), SpawnVariation, SpawnEvenly, Class, BezierSteps );
+	SpawnObstaclesWithMaskMultiVariations( MakeArrayView( ControlPoints ), Count, SpawnStyle, TArrayView< const int32 >(), MakeArrayView( &SpawnVariation, 1 ), SpawnEvenly, Class, BezierSteps );
+}
+
+void ABaseFloorPiece::SpawnObstaclesMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, const TArray< int32 >& SpawnVariations, bool SpawnEvenly /*= false*/, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
+{
+	SpawnObstaclesWithMaskMultiVariations( MakeArrayView( ControlPoints ), Count, SpawnStyle, TArrayView< const int32 >(), MakeArrayView( SpawnVariations ), SpawnEvenly, Class, BezierSteps );
 }
 
-void ABaseFloorPiece::SpawnObstaclesMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > SpawnVariations, bool SpawnEvenly /*= false*/, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
+void ABaseFloorPiece::SpawnObstaclesWithMask( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, const TArray< int32 >& Mask, int32 SpawnVariation, bool SpawnEvenly /*= false*/, UClass* Class/*= nullptr*/, int32 BezierSteps /*= 150*/ )
 {
-	SpawnObstaclesWithMaskMultiVariations( ControlPoints, Count, SpawnStyle, TArray< int32 >(), SpawnVariations, SpawnEvenly, Class, BezierSteps );
+	SpawnObstaclesWithMaskMultiVariations( MakeArrayView( ControlPoints ), Count, SpawnStyle, MakeArrayView( Mask ), MakeArrayView( &SpawnVariation, 1 ), SpawnEvenly, Class, BezierSteps );
 }
 
-void ABaseFloorPiece::SpawnObstaclesWithMask( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, int32 SpawnVariation, bool SpawnEvenly /*= false*/, UClass* Class/*= nullptr*/, int32 BezierSteps /*= 150*/ )
+void ABaseFloorPiece::SpawnObstaclesWithMaskMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, const TArray< int32 >& Mask, const TArray< int32 >& SpawnVariations, bool SpawnEvenly /*= false*/, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
 {
-	SpawnObstaclesWithMaskMultiVariations( ControlPoints, Count, SpawnStyle, Mask, { SpawnVariation }, SpawnEvenly, Class, BezierSteps );
+	SpawnObstaclesWithMaskMultiVariations( MakeArrayView( ControlPoints ), Count, SpawnStyle, MakeArrayView( Mask ), MakeArrayView( SpawnVariations ), SpawnEvenly, Class, BezierSteps );
 }
 
-void ABaseFloorPiece::SpawnObstaclesWithMaskMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, TArray< int32 > SpawnVariations, bool SpawnEvenly /*= false*/, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
+void ABaseFloorPiece::SpawnObstaclesWithMaskMultiVariations( TArrayView< const FVector > ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArrayView< const int32 > Mask, TArrayView< const int32 > SpawnVariations, bool SpawnEvenly /*= false*/, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
 {
 	if( SpawnEvenly )
 		SpawnObstaclesEvenlyWithMaskInternal( ControlPoints, Count, SpawnStyle, Mask, SpawnVariations, Class, BezierSteps );
@@ -282,30 +826,45 @@ void ABaseFloorPiece::SpawnObstaclesWithMaskMultiVariations( UPARAM( ref )TArray
 		SpawnObstaclesWithMaskInternal( ControlPoints, Count, SpawnStyle, Mask, SpawnVariations, Class );
 }
 
-void ABaseFloorPiece::SpawnObstaclesWithMaskInternal( TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, TArray< int32 > SpawnVariations, UClass* Class /*= nullptr*/ )
+bool ABaseFloorPiece::PrepareObstacleSpawn( TArrayView< const int32 > SpawnVariations, FObstacleVariations& OutSortedVariations, UClass*& InOutClass )
 {
 	if( SpawnVariations.Num() > 0 && SpawnVariations[0] != 0 && !SpawnVariations.Contains( Variation ) )
-		return;
+		return false;
+
+	if( ReplayCachedObstacleLayout() )
+		return false;
 
-	if( Class == nullptr )
-		Class = FindObstacleClass();
+	if( InOutClass == nullptr )
+		InOutClass = FindObstacleClass();
 
-	if( !Class->IsChildOf< UPrimitiveComponent >() )
+	if( !InOutClass->IsChildOf< UPrimitiveComponent >() )
 	{
-		UCubeSingletonDataLibrary::CustomLog( "Spawning obstacle failed with invalid class type: " + ( Class ? Class->GetName() : "INVALID CLASS" ), LogDisplayType::Error );
-		Class = FindObstacleClass();
+		UCubeSingletonDataLibrary::CustomLog( "Spawning obstacle failed with invalid class type: " + ( InOutClass ? InOutClass->GetName() : "INVALID CLASS" ), LogDisplayType::Error );
+		InOutClass = FindObstacleClass();
 	}
 
 	if( !ConstructionScriptRun )
 		DestroyObstacles();
 
-	if( SpawnVariations.Num() )
+	OutSortedVariations.Append( SpawnVariations.GetData(), SpawnVariations.Num() );
+
+	if( OutSortedVariations.Num() )
 	{
-		SpawnVariations.Sort();
-		MaxVariationClassic = FMath::Max( MaxVariationClassic, SpawnVariations.Last() );
-		MaxVariationAdvanced = FMath::Max( MaxVariationAdvanced, SpawnVariations.Last() );
+		OutSortedVariations.Sort();
+		MaxVariationClassic = FMath::Max( MaxVariationClassic, OutSortedVariations.Last() );
+		MaxVariationAdvanced = FMath::Max( MaxVariationAdvanced, OutSortedVariations.Last() );
 	}
 
+	return true;
+}
+
+void ABaseFloorPiece::SpawnObstaclesWithMaskInternal( TArrayView< const FVector > ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArrayView< const int32 > Mask, TArrayView< const int32 > SpawnVariations, UClass* Class /*= nullptr*/ )
+{
+	FObstacleVariations SortedVariations;
+
+	if( !PrepareObstacleSpawn( SpawnVariations, SortedVariations, Class ) )
+		return;
+
 	Count += 2;
 	bool StatePlacing = true;
 	int32 StateCounter = 0;
@@ -345,6 +904,7 @@ void ABaseFloorPiece::SpawnObstaclesWithMaskInternal( TArray< FVector >& Control
 				const auto start = FVector( Position.X, Position.Y, FloorMesh->GetComponentLocation().Z + ObstacleSpawnTraceHeight );
 				const auto end = FVector( Position.X, Position.Y, FloorMesh->GetComponentLocation().Z - ObstacleSpawnTraceHeight );
 				
+				FFloorPieceProfiler::Get().CountTrace();
 				if( ActorLineTraceSingle( trace_hit, start, end, ECC_Visibility, trace_params ) )
 				{
 					Transform.SetLocation( trace_hit.ImpactPoint + FVector( 0.0f, 0.0f, 75.0f ) );
@@ -353,34 +913,17 @@ void ABaseFloorPiece::SpawnObstaclesWithMaskInternal( TArray< FVector >& Control
 				//else UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::SpawnObstaclesWithMaskInternal | Spawning failed with ESOAT_ATTACH style as line trace returned NULL", Warn );
 			}
 
-			SpawnObstacleMultiVariations( Class, Transform, SpawnVariations );
+			SpawnObstacleMultiVariations( Class, Transform, SortedVariations );
 		}
 	}
 }
 
-void ABaseFloorPiece::SpawnObstaclesEvenlyWithMaskInternal( TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, TArray< int32 > SpawnVariations, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
+void ABaseFloorPiece::SpawnObstaclesEvenlyWithMaskInternal( TArrayView< const FVector > ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArrayView< const int32 > Mask, TArrayView< const int32 > SpawnVariations, UClass* Class /*= nullptr*/, int32 BezierSteps /*= 150*/ )
 {
-	if( SpawnVariations.Num() > 0 && SpawnVariations[0] != 0 && !SpawnVariations.Contains( Variation ) )
-		return;
-
-	if( Class == nullptr )
-		Class = FindObstacleClass();
-
-	if( !Class->IsChildOf< UPrimitiveComponent >() )
-	{
-		UCubeSingletonDataLibrary::CustomLog( "Spawning obstacle failed with invalid class type: " + ( Class ? Class->GetName() : "INVALID CLASS" ), LogDisplayType::Error );
-		Class = FindObstacleClass();
-	}
-
-	if( !ConstructionScriptRun )
-		DestroyObstacles();
+	FObstacleVariations SortedVariations;
 
-	if( SpawnVariations.Num() )
-	{
-		SpawnVariations.Sort();
-		MaxVariationClassic = FMath::Max( MaxVariationClassic, SpawnVariations.Last() );
-		MaxVariationAdvanced = FMath::Max( MaxVariationAdvanced, SpawnVariations.Last() );
-	}
+	if( !PrepareObstacleSpawn( SpawnVariations, SortedVariations, Class ) )
+		return;
 
 	//const auto Steps = 150;// Count * 2; // Look into a good value for this
 	const float BezierLength = CalculateBezierCurveLength( ControlPoints, BezierSteps );
@@ -433,6 +976,7 @@ void ABaseFloorPiece::SpawnObstaclesEvenlyWithMaskInternal( TArray< FVector >& C
 					const auto start = FVector( NewPosition.X, NewPosition.Y, FloorMesh->GetComponentLocation().Z + ObstacleSpawnTraceHeight );
 					const auto end = FVector( NewPosition.X, NewPosition.Y, FloorMesh->GetComponentLocation().Z - ObstacleSpawnTraceHeight );
 
+					FFloorPieceProfiler::Get().CountTrace();
 					if( ActorLineTraceSingle( trace_hit, start, end, ECC_Visibility, trace_params ) )
 					{
 						Transform.SetLocation( trace_hit.ImpactPoint + FVector( 0.0f, 0.0f, 75.0f ) );
@@ -441,7 +985,7 @@ void ABaseFloorPiece::SpawnObstaclesEvenlyWithMaskInternal( TArray< FVector >& C
 					//else UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::SpawnObstaclesEvenlyWithMaskInternal | Spawning failed with ESOAT_ATTACH style as line trace returned NULL", Warn );
 				}
 
-				SpawnObstacleMultiVariations( Class, Transform, SpawnVariations );
+				SpawnObstacleMultiVariations( Class, Transform, SortedVariations );
 			}
 		}
 
@@ -451,35 +995,83 @@ void ABaseFloorPiece::SpawnObstaclesEvenlyWithMaskInternal( TArray< FVector >& C
 
 void ABaseFloorPiece::SpawnObstacle( UClass* Class, FTransform Transform, int32 SpawnVariation )
 {
-	SpawnObstacleMultiVariations( Class, Transform, { SpawnVariation } );
+	SpawnObstacleMultiVariations( Class, Transform, MakeArrayView( &SpawnVariation, 1 ) );
+}
+
+void ABaseFloorPiece::SpawnObstacleMultiVariations( UClass* Class, FTransform Transform, const TArray< int32 >& SpawnVariations )
+{
+	SpawnObstacleMultiVariations( Class, Transform, MakeArrayView( SpawnVariations ) );
 }
 
-void ABaseFloorPiece::SpawnObstacleMultiVariations( UClass* Class, FTransform Transform, TArray< int32 > SpawnVariations )
+void ABaseFloorPiece::SpawnObstacleMultiVariations( UClass* Class, const FTransform& Transform, TArrayView< const int32 > SpawnVariations )
 {
+	if( ReplayCachedObstacleLayout() )
+		return;
+
 	if( InstancedObstacleSpawningEnabled )
 	{
 		SpawnInstancedObstacleInternal( Class, Transform, SpawnVariations, EObjectFlags::RF_NoFlags );
 	}
 	else
 	{
-		if( const auto NewComponent = SpawnObstacleInternal( Class, Transform, SpawnVariations, EObjectFlags::RF_NoFlags ) )
-		{
-			FChildObstacle NewObstacle( NewComponent, SpawnVariations );
-			SpawnedChildObstacles.Add( NewObstacle );
-		}
+		if( const auto NewComponent = SpawnObstacleInternal( Class, Transform, EObjectFlags::RF_NoFlags ) )
+			SpawnedChildObstacles.Emplace( NewComponent, SpawnVariations );
 	}
 }
 
-void ABaseFloorPiece::SpawnInstancedObstacleInternal( UClass* Class, FTransform Transform, TArray< int32 > SpawnVariations, EObjectFlags Flags )
+void ABaseFloorPiece::SpawnObstaclesLocal( UClass* Class, const TArray< FTransform >& LocalTransforms, int32 SpawnVariation )
 {
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
+	if( !LocalTransforms.Num() || ReplayCachedObstacleLayout() )
+		return;
+
+	if( !InstancedObstacleSpawningEnabled || !GetWorld()->IsGameWorld() )
+	{
+		for( const auto& Local : LocalTransforms )
+			SpawnObstacle( Class, Local * GetActorTransform(), SpawnVariation );
+
+		return;
+	}
+
+	// Straight into the instance data, uploaded in one go when the piece commits
 	auto* Mesh = Cast< UStaticMeshComponent >( Class->GetDefaultObject() )->GetStaticMesh();
+	auto& Container = InstancedObstacleData.FindOrAdd( Mesh );
+	Container.LocalTransforms.Append( LocalTransforms );
+	Container.Data.Reserve( Container.Data.Num() + LocalTransforms.Num() );
+
+	for( int32 i = 0; i < LocalTransforms.Num(); ++i )
+		Container.Data.Emplace( MakeArrayView( &SpawnVariation, 1 ) );
+
+	if( InstancedObstaclesCommitted )
+		CommitInstancedObstacles( Mesh, Container );
+}
+
+void ABaseFloorPiece::SpawnInstancedObstacleInternal( UClass* Class, const FTransform& Transform, TArrayView< const int32 > SpawnVariations, EObjectFlags Flags )
+{
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
+	auto* Mesh = Cast< UStaticMeshComponent >( Class->GetDefaultObject() )->GetStaticMesh();
+
+	// In game one component per mesh is shared by every piece, so just record the instance until the piece is placed
+	if( GetWorld()->IsGameWorld() )
+	{
+		auto& Container = InstancedObstacleData.FindOrAdd( Mesh );
+		Container.LocalTransforms.Add( Transform.GetRelativeTransform( GetActorTransform() ) );
+		Container.Data.Emplace( SpawnVariations );
+
+		if( InstancedObstaclesCommitted )
+			CommitInstancedObstacles( Mesh, Container );
+
+		return;
+	}
 
 	auto* Result = InstancedObstacleData.Find( Mesh );
 
 	if( Result )
 	{
 		Result->InstancedStaticMesh->AddInstance( Transform );
-		Result->Data.Add( FInstancedObstacleData( SpawnVariations ) );
+		Result->Data.Emplace( SpawnVariations );
 	}
 	else
 	{
@@ -498,8 +1090,10 @@ void ABaseFloorPiece::SpawnInstancedObstacleInternal( UClass* Class, FTransform
 	}
 }
 
-UStaticMeshComponent* ABaseFloorPiece::SpawnObstacleInternal( UClass* Class, FTransform Transform, TArray< int32 > SpawnVariations, EObjectFlags Flags )
+UStaticMeshComponent* ABaseFloorPiece::SpawnObstacleInternal( UClass* Class, const FTransform& Transform, EObjectFlags Flags )
 {
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
 	// Create obstacle (component)
 	auto* NewComponent = NewObject<UStaticMeshComponent>( this, Class, NAME_None, Flags );
 
@@ -525,6 +1119,16 @@ FVector ABaseFloorPiece::CalculateCornerPosition( FVector Start, FVector End, FV
 
 TArray< FVector > ABaseFloorPiece::FindTurnControlPoints( USceneComponent* Start, USceneComponent* End )
 {
+	// Turn markers are editor-only, blueprints that still pass them in get null in cooked builds
+	if( !Start || !End )
+	{
+		if( auto* TurnPiece = Cast< ABaseTurnFloorPiece >( this ) )
+			return TurnPiece->FindBakedTurnControlPoints();
+
+		UCubeSingletonDataLibrary::CustomLog( "ABaseFloorPiece::FindTurnControlPoints | Invalid turn marker on " + GetName(), LogDisplayType::Error );
+		return TArray< FVector >();
+	}
+
 	const auto StartPos = Start->GetComponentLocation();
 	const auto EndPos = End->GetComponentLocation();
 
@@ -536,69 +1140,52 @@ TArray< FVector > ABaseFloorPiece::FindTurnControlPoints( USceneComponent* Start
 	return output;
 }
 
-float ABaseFloorPiece::CalculateBezierCurveLength( TArray< FVector > ControlPoints, const int32 StepCount )
+float ABaseFloorPiece::CalculateBezierCurveLength( const TArray< FVector >& ControlPoints, const int32 StepCount )
 {
-	float Length = 0.0f;
-	float Step = 0.0f;
-
-	for( int32 i = 0; i < StepCount - 1; ++i )
-	{
-		const auto Point0 = Bezier( Step, ControlPoints );
-		Step += ( 1.0f / StepCount );
-		const auto Point1 = Bezier( Step, ControlPoints );
-		Length += ( Point1 - Point0 ).Size();
-	}
+	return CalculateBezierCurveLength( MakeArrayView( ControlPoints ), StepCount );
+}
 
-	return Length;
+float ABaseFloorPiece::CalculateBezierCurveLength( TArrayView< const FVector > ControlPoints, const int32 StepCount ) const
+{
+	return CubeCore::BezierLength( ToCore( ControlPoints.GetData() ), ControlPoints.Num(), StepCount );
 }
 
 int32 ABaseFloorPiece::Binomial( int32 n, int32 k )
 {
-	if( BinomialLookUpTable.Num() == 0 )
-		InitialiseLookUpTable();
-
-	while( n >= BinomialLookUpTable.Num() )
-	{
-		TArray< int32 > NewRow;
-		NewRow.Add( 1 );
-		int32 length = BinomialLookUpTable.Num() - 1;
-
-		for( int32 i = 1; i < length; i++ )
-		{
-			NewRow.Add( BinomialLookUpTable[ length ][ i - 1 ] + BinomialLookUpTable[ length ][ i ] );
-		}
+	// Blueprints only get 32 bits, n past 33 overflows
+	return ( int32 )CubeCore::Binomial( n, k );
+}
 
-		NewRow.Add( 1 );
-		BinomialLookUpTable.Add( NewRow );
-	}
+TArray< int32 > ABaseFloorPiece::GetInstancedObstacleVariations( const FInstancedObstacleData& Data )
+{
+	return TArray< int32 >( Data.Variations );
+}
 
-	return BinomialLookUpTable[ n ][ k ];
+void ABaseFloorPiece::SetInstancedObstacleVariations( FInstancedObstacleData& Data, const TArray< int32 >& Variations )
+{
+	Data.Variations = Variations;
 }
 
-void ABaseFloorPiece::InitialiseLookUpTable()
+bool ABaseFloorPiece::IsInstancedObstacleSpawningEnabled()
 {
-	std::vector< std::vector< int32 > > values
-	{
-		{ 1 },
-		{ 1, 1 },
-		{ 1, 2, 1 },
-		{ 1, 3, 3, 1 },
-		{ 1, 4, 6, 4, 1 },
-		{ 1, 5, 10, 10, 5, 1 },
-		{ 1, 6, 15, 20, 15, 6, 1 }
-	};
+	return InstancedObstacleSpawningEnabled;
+}
 
-	BinomialLookUpTable.AddDefaulted( values.size() );
+void ABaseFloorPiece::SetInstancedObstacleSpawningEnabled( const bool Enabled )
+{
+	InstancedObstacleSpawningEnabled = Enabled;
+}
 
-	for( size_t i = 0; i < values.size(); ++i )
-	{
-		BinomialLookUpTable[ i ].AddDefaulted( values[ i ].size() );
+void ABaseFloorPiece::ResetVariationTables()
+{
+	VariationTables.Empty();
+}
 
-		for( size_t j = 0; j < values[ i ].size(); ++j )
-		{
-			BinomialLookUpTable[ i ][ j ] = values[ i ][ j ];
-		}
-	}
+int32 ABaseFloorPiece::GetTemplateComponentCount( UClass* Class )
+{
+	FVariationTable Table;
+	BuildVariationTable( Class, Table );
+	return Table.ComponentCount;
 }
 
 bool ABaseFloorPiece::IsReadyToBePlaced()
@@ -4,6 +4,7 @@
 
 #include "GameFramework/Actor.h"
 #include "Components/InstancedStaticMeshComponent.h"
+#include "ObstacleLayoutCache.h"
 #include "BaseFloorPiece.generated.h"
 
 UENUM( BlueprintType )
@@ -33,7 +34,7 @@ struct FChildObstacle
 
 public:
 	FChildObstacle() {}
-	FChildObstacle( UStaticMeshComponent* Comp, TArray< int32 > _Variations ) : Component( Comp ), Variations( _Variations ) {}
+	FChildObstacle( UStaticMeshComponent* Comp, TArrayView< const int32 > _Variations ) : Component( Comp ), Variations( _Variations.GetData(), _Variations.Num() ) {}
 
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) UStaticMeshComponent* Component;
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) TArray< int32 > Variations;
@@ -46,11 +47,29 @@ struct FSplitConnection
 
 public:
 	FSplitConnection() {}
-	FSplitConnection( UArrowComponent* Con, UBoxComponent* Col ) : ConnectionPoint( Con ), Collider( Col ) {}
+	FSplitConnection( UArrowComponent* Con, UBoxComponent* Col, const FTransform& _Transform ) : ConnectionPoint( Con ), Collider( Col ), Transform( _Transform ) {}
 
 	class UArrowComponent* ConnectionPoint = nullptr;
 	class UBoxComponent* Collider = nullptr;
 	class ABaseFloorPiece* ConnectedSpawnPiece = nullptr;
+
+	// Relative to the piece, the arrow isn't needed once this is known
+	FTransform Transform;
+};
+
+USTRUCT( BlueprintType )
+struct FCorridorEdge
+{
+	GENERATED_USTRUCT_BODY()
+
+public:
+	FCorridorEdge() : Start( 0.0f, 0.0f ), End( 0.0f, 0.0f ), LeftSide( true ) {}
+	FCorridorEdge( FVector2D _Start, FVector2D _End, bool _LeftSide ) : Start( _Start ), End( _End ), LeftSide( _LeftSide ) {}
+
+	// Piece space, X along the piece and Y to the right
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) FVector2D Start;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) FVector2D End;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) bool LeftSide;
 };
 
 USTRUCT( BlueprintType )
@@ -60,7 +79,7 @@ struct FInstancedObstacleData
 
 public:
 	FInstancedObstacleData() {}
-	FInstancedObstacleData( TArray< int32 >  _Variations ) : Variations( _Variations ) {}
+	FInstancedObstacleData( TArrayView< const int32 > _Variations ) : Variations( _Variations.GetData(), _Variations.Num() ) {}
 
 	// Members
 	//UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) int32 WaypointIndex;
@@ -68,7 +87,9 @@ public:
 	//UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) float MovementSpeed;
 	//UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) bool RotateTowardsTarget;
 	//UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) EMovementStyle MovementStyle;
-	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) TArray< int32 >  Variations;
+	// Not a UPROPERTY so it can be inline allocated, one is added for every instanced obstacle placed
+	// Blueprints reach it through ABaseFloorPiece::GetInstancedObstacleVariations / SetInstancedObstacleVariations
+	FObstacleVariations Variations;
 };
 
 USTRUCT( BlueprintType )
@@ -77,7 +98,7 @@ struct FInstancedObstacleDataContainer
 	GENERATED_USTRUCT_BODY()
 
 public:
-	FInstancedObstacleDataContainer() {}
+	FInstancedObstacleDataContainer() : InstancedStaticMesh( nullptr ) {}
 	FInstancedObstacleDataContainer( UInstancedStaticMeshComponent* _InstancedStaticMesh, FInstancedObstacleData _Data ) : InstancedStaticMesh( _InstancedStaticMesh ), Data()
 	{
 		Data.Add( _Data );
@@ -86,6 +107,20 @@ public:
 	// Members
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) UInstancedStaticMeshComponent* InstancedStaticMesh;
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) TArray< FInstancedObstacleData > Data;
+
+	// In game the instances live in the world's shared component, these are relative to the piece until committed
+	TArray< FTransform > LocalTransforms;
+	int32 RangeStart = INDEX_NONE;
+	int32 RangeCount = 0;
+};
+
+// Where a piece is in generating its construction script obstacles, see FObstacleLayoutCache
+enum class EObstacleLayoutState : uint8
+{
+	Unknown,
+	Recording,
+	Replayed,
+	Closed,
 };
 
 UCLASS()
@@ -101,14 +136,43 @@ public:
 	virtual void BeginPlay() override;
 	virtual void OnConstruction( const FTransform& Transform ) override;
 
+#if WITH_EDITOR
+	virtual void PreSave( const class ITargetPlatform* TargetPlatform ) override;
+#endif
+
 	UFUNCTION( BlueprintImplementableEvent, Category = "Core" )
 	void OnFloorPieceBeginPlay();
 
 	virtual void FloorPieceBeginPlay();
 
+	// Called instead of FloorPieceBeginPlay when the game mode hands out a pooled piece
+	UFUNCTION( BlueprintImplementableEvent, Category = "Core" )
+	void OnFloorPieceReused();
+
+	virtual void FloorPieceReused();
+	virtual bool CanBePooled() const;
+	virtual void ReturnToPool();
+
 	virtual bool IsReadyToBePlaced();
 	void NewFloorPieceSpawned( ABaseFloorPiece* NewPiece );
 
+	// Instanced obstacles by default, components when off (only pieces spawned afterwards are affected)
+	static bool IsInstancedObstacleSpawningEnabled();
+	static void SetInstancedObstacleSpawningEnabled( const bool Enabled );
+
+	// Per class variation tables are kept for the whole game, the editor drops them between play sessions
+	static void ResetVariationTables();
+
+	// Components and child actors a class's construction script creates before any are pruned by variation
+	static int32 GetTemplateComponentCount( UClass* Class );
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	FTransform GetConnectionTransform() const { return ConnectionTransform * GetActorTransform(); }
+
+	FTransform GetMultiConnectionTransform( const int32 Index ) const { return MultiConnections[ Index ].Transform * GetActorTransform(); }
+	FTransform GetUpgradeZoneTransform() const { return UpgradeZoneTransform * GetActorTransform(); }
+	bool HasUpgradeZone() const { return UpgradeZoneExtent.X > 0.0f && UpgradeZoneExtent.Y > 0.0f; }
+
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	UClass* FindObstacleClass();
 
@@ -119,19 +183,26 @@ public:
 	void SpawnObstacles( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, int32 SpawnVariation, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
-	void SpawnObstaclesMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > SpawnVariations, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
+	void SpawnObstaclesMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, const TArray< int32 >& SpawnVariations, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
-	void SpawnObstaclesWithMask( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, int32 SpawnVariation, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
+	void SpawnObstaclesWithMask( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, const TArray< int32 >& Mask, int32 SpawnVariation, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
-	void SpawnObstaclesWithMaskMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, TArray< int32 > SpawnVariations, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
+	void SpawnObstaclesWithMaskMultiVariations( UPARAM( ref )TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, const TArray< int32 >& Mask, const TArray< int32 >& SpawnVariations, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
+
+	// Native version the Blueprint entry points forward to, nothing is copied on the way down
+	void SpawnObstaclesWithMaskMultiVariations( TArrayView< const FVector > ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArrayView< const int32 > Mask, TArrayView< const int32 > SpawnVariations, bool SpawnEvenly = false, UClass* Class = nullptr, int32 BezierSteps = 150 );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	void SpawnObstacle( UClass* Class, FTransform Transform, int32 SpawnVariation );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
-	void SpawnObstacleMultiVariations( UClass* Class, FTransform Transform, TArray< int32 > SpawnVariations );
+	void SpawnObstacleMultiVariations( UClass* Class, FTransform Transform, const TArray< int32 >& SpawnVariations );
+	void SpawnObstacleMultiVariations( UClass* Class, const FTransform& Transform, TArrayView< const int32 > SpawnVariations );
+
+	// Bulk version of SpawnObstacle for layouts generated ahead of time, transforms are relative to the piece
+	void SpawnObstaclesLocal( UClass* Class, const TArray< FTransform >& LocalTransforms, int32 SpawnVariation );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	FVector CalculateCornerPosition( FVector Start, FVector End, FVector StartForward );
@@ -140,7 +211,8 @@ public:
 	TArray< FVector > FindTurnControlPoints( USceneComponent* Start, USceneComponent* End );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
-	FVector Bezier( float Interval, TArray< FVector > ControlPoints );
+	FVector Bezier( float Interval, const TArray< FVector >& ControlPoints );
+	FVector Bezier( float Interval, TArrayView< const FVector > ControlPoints ) const;
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	FVector BezierQuadratic( float Interval, FVector Start, FVector Corner, FVector End );
@@ -149,24 +221,63 @@ public:
 	FVector BezierCubic( float Interval, FVector Start, FVector CornerA, FVector CornerB, FVector End );
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
-	float CalculateBezierCurveLength( TArray< FVector > ControlPoints, const int32 StepCount );
+	float CalculateBezierCurveLength( const TArray< FVector >& ControlPoints, const int32 StepCount );
+	float CalculateBezierCurveLength( TArrayView< const FVector > ControlPoints, const int32 StepCount ) const;
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	int32 Binomial( int32 n, int32 k );
 
-	static void InitialiseLookUpTable();
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	static TArray< int32 > GetInstancedObstacleVariations( const FInstancedObstacleData& Data );
+
+	UFUNCTION( BlueprintCallable, Category = "Utility" )
+	static void SetInstancedObstacleVariations( UPARAM( ref )FInstancedObstacleData& Data, const TArray< int32 >& Variations );
+
+	bool IsVariationComponent( const TArray< int32 >& ComponentVariations ) const;
+
+	// Drivable lateral range at a distance along the piece, false if nothing constrains it there
+	bool GetCorridorBounds( const float X, float& OutMinY, float& OutMaxY ) const;
+	bool HasCorridor() const { return CorridorEdges.Num() > 0; }
+
+	// The instanced obstacles live in the world's shared components so they aren't hidden along with the piece
+	void SetInstancedObstaclesHidden( const bool Hidden );
 
 protected:
 	void DestroyObstacles();
-
-	UStaticMeshComponent* SpawnObstacleInternal( UClass* Class, FTransform Transform, TArray< int32 > SpawnVariations, EObjectFlags Flags  );
-	void SpawnObstaclesWithMaskInternal( TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, TArray< int32 > SpawnVariations, UClass* Class = nullptr );
-	void SpawnObstaclesEvenlyWithMaskInternal( TArray< FVector >& ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArray< int32 > Mask, TArray< int32 > SpawnVariations, UClass* Class = nullptr, int32 BezierSteps = 150 );
-	void SpawnInstancedObstacleInternal( UClass* Class, FTransform Transform, TArray< int32 > SpawnVariations, EObjectFlags Flags );
+	void CommitInstancedObstacles( UStaticMesh* Mesh, FInstancedObstacleDataContainer& Container );
+	void CommitInstancedObstacles();
+	void ReleaseInstancedObstacles();
+	void SetPooled( const bool Pooled );
+
+	// Moves every instanced obstacle by an offset relative to the piece, committed ranges are rewritten in place
+	void ShiftInstancedObstacles( const FVector& LocalDelta );
+	void UpdateInstancedObstacleRange( UStaticMesh* Mesh, const FInstancedObstacleDataContainer& Container );
+	void BuildCorridorFromWalls();
+
+#if WITH_EDITOR
+	// Copies the editor-only marker components into the data used at runtime
+	virtual void BakeMarkers();
+#endif
+	bool ReplayCachedObstacleLayout();
+
+	// Obstacles placed in the blueprint that keep world space state from BeginPlay, so the piece can't move on reuse
+	bool HasWorldSpaceObstacles() const;
+	void CloseObstacleLayout();
+	void BuildUpgradeFreeCells();
+	void SpawnUpgrade();
+
+	UStaticMeshComponent* SpawnObstacleInternal( UClass* Class, const FTransform& Transform, EObjectFlags Flags );
+	void SpawnObstaclesWithMaskInternal( TArrayView< const FVector > ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArrayView< const int32 > Mask, TArrayView< const int32 > SpawnVariations, UClass* Class = nullptr );
+	void SpawnObstaclesEvenlyWithMaskInternal( TArrayView< const FVector > ControlPoints, int32 Count, ESpawnObstaclesType SpawnStyle, TArrayView< const int32 > Mask, TArrayView< const int32 > SpawnVariations, UClass* Class = nullptr, int32 BezierSteps = 150 );
+	void SpawnInstancedObstacleInternal( UClass* Class, const FTransform& Transform, TArrayView< const int32 > SpawnVariations, EObjectFlags Flags );
+
+	// Checks the variations apply to this piece and sorts a copy of them, false if nothing should be spawned
+	bool PrepareObstacleSpawn( TArrayView< const int32 > SpawnVariations, FObstacleVariations& OutSortedVariations, UClass*& InOutClass );
 
 	// Members
 public:
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class USceneComponent* Root;
+	// RootDir, ConnectionPoint and UpgradeSpawnZone are editor-only markers (null in cooked builds), read the baked data instead
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class UArrowComponent* RootDir;
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class UBoxComponent* SpawnCollison;
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class UArrowComponent* ConnectionPoint;
@@ -179,18 +290,37 @@ public:
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) int32 Variation;
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) int32 MaxVariationClassic;
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) int32 MaxVariationAdvanced;
-	AActor* UpgradeActor;
+	class ABaseUpgrade* UpgradeActor;
 
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) TArray< FSplitConnection > MultiConnections;
+
+	// Baked from the editor-only Connection Point and Upgrade Spawn Zone components, relative to the piece
+	UPROPERTY( VisibleAnywhere, BlueprintReadOnly, Category = Data ) FTransform ConnectionTransform;
+	UPROPERTY( VisibleAnywhere, BlueprintReadOnly, Category = Data ) FTransform UpgradeZoneTransform;
+	UPROPERTY( VisibleAnywhere, BlueprintReadOnly, Category = Data ) FVector UpgradeZoneExtent;
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) bool EndLevelPiece;
 
+	// Left empty to have it generated from the piece's wall pieces
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) TArray< FCorridorEdge > CorridorEdges;
+
+	// Disable for pieces whose obstacles aren't fully determined by their class and variation
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) bool CacheObstacleLayout;
+
+	// Disable for pieces whose blueprint keeps state that OnFloorPieceReused can't reset
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) bool AllowPooling;
+
 	UPROPERTY( Transient, BlueprintReadOnly, Category = Data ) TArray< FChildObstacle > SpawnedChildObstacles;
 	UPROPERTY( Transient, BlueprintReadOnly, Category = Data ) TMap< UStaticMesh*, FInstancedObstacleDataContainer > InstancedObstacleData;
 
 	int32 CoolDownCounter;
 	bool ConstructionScriptRun;
 	bool HasTriggered;
-
-private:
-	static TArray< TArray < int32 > > BinomialLookUpTable;
+	bool InstancedObstaclesCommitted;
+	bool InstancedObstaclesHidden;
+	EObstacleLayoutState ObstacleLayoutState;
+
+	// Cells of the upgrade spawn zone not covered by an obstacle, row major in the zone's local space
+	TBitArray<> UpgradeFreeCells;
+	FIntPoint UpgradeCellCount;
+	FVector2D UpgradeCellStep;
 };
@@ -69,6 +69,14 @@ void ABaseObstacle::AddDynamicWaypointLocation( const FVector Location )
 	WaypointPositions.Add( Location );
 }
 
+void ABaseObstacle::ApplyWorldOffset( const FVector& InOffset, bool bWorldShift )
+{
+	Super::ApplyWorldOffset( InOffset, bWorldShift );
+
+	for( auto& Position : WaypointPositions )
+		Position += InOffset;
+}
+
 void ABaseObstacle::AddDynamicWaypoints( const UChildActorComponent* Marker, const UChildActorComponent* Marker2 )
 {
 	AddDynamicWaypoint( Marker );
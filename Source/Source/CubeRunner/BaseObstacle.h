@@ -25,6 +25,7 @@ public:
 	ABaseObstacle( const FObjectInitializer& ObjectInitializer );
 
 	virtual void Tick( float DeltaSeconds ) override;
+	virtual void ApplyWorldOffset( const FVector& InOffset, bool bWorldShift ) override;
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	void SetDynamicObstacle( const float MovementSpeed, EMovementStyle MovementStyle );
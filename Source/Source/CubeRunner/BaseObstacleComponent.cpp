@@ -37,6 +37,32 @@ void UBaseObstacleComponent::BeginPlay()
 	}
 }
 
+void UBaseObstacleComponent::OnComponentCreated()
+{
+	Super::OnComponentCreated();
+
+	// Pieces are spawned deferred with their variation already set, so this runs before registration
+	if( const auto* Piece = Cast< ABaseFloorPiece >( GetOwner() ) )
+	{
+		if( !Piece->IsVariationComponent( Variations ) )
+		{
+			ExcludedVariation = true;
+			bAutoRegister = false;
+			PrimaryComponentTick.bStartWithTickEnabled = false;
+		}
+	}
+}
+
+bool UBaseObstacleComponent::ShouldCreateRenderState() const
+{
+	return !ExcludedVariation && Super::ShouldCreateRenderState();
+}
+
+bool UBaseObstacleComponent::ShouldCreatePhysicsState() const
+{
+	return !ExcludedVariation && Super::ShouldCreatePhysicsState();
+}
+
 void UBaseObstacleComponent::TickComponent( float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction )
 {
 	Super::TickComponent( DeltaTime, TickType, ThisTickFunction );
@@ -79,6 +105,17 @@ void UBaseObstacleComponent::TickComponent( float DeltaTime, enum ELevelTick Tic
 	}
 }
 
+void UBaseObstacleComponent::ApplyWorldOffset( const FVector& InOffset, bool bWorldShift )
+{
+	Super::ApplyWorldOffset( InOffset, bWorldShift );
+
+	// Waypoints and the circle centre are in world space
+	StartLocation += InOffset;
+
+	for( auto& Position : WaypointPositions )
+		Position += InOffset;
+}
+
 void UBaseObstacleComponent::AddDynamicWaypoint( const USceneComponent* Marker )
 {
 	if( Marker->IsValidLowLevel() && !Marker->IsPendingKill() )
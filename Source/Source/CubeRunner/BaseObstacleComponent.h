@@ -16,7 +16,11 @@ public:
 	UBaseObstacleComponent( const FObjectInitializer& ObjectInitializer );
 
 	virtual void BeginPlay() override;
+	virtual void OnComponentCreated() override;
+	virtual bool ShouldCreateRenderState() const override;
+	virtual bool ShouldCreatePhysicsState() const override;
 	virtual void TickComponent( float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction ) override;
+	virtual void ApplyWorldOffset( const FVector& InOffset, bool bWorldShift ) override;
 
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	void AddDynamicWaypoint( const USceneComponent* Marker );
@@ -44,4 +48,7 @@ public:
 
 private:
 	FVector StartLocation;
+
+	// Belongs to a different variation of the owning piece, so it is never registered
+	bool ExcludedVariation = false;
 };
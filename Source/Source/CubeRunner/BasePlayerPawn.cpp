@@ -16,6 +16,18 @@
 #include "Particles/ParticleSystemComponent.h"
 #include "Components/BoxComponent.h"
 #include "BaseTurnFloorPiece.h"
+#include "CubeGameInstance.h"
+#include "ObstacleInstanceManager.h"
+#include "Engine/StaticMesh.h"
+
+namespace
+{
+	TAutoConsoleVariable< int32 > CVarSimulationRate( TEXT( "cr.SimulationRate" ), 60, TEXT( "Player simulation steps per second, independent of the frame rate" ), ECVF_Default );
+
+	// Beyond this the simulation slows down rather than spiralling
+	const int32 MaxStepsPerFrame = 8;
+	const int32 MaxSweepSubsteps = 16;
+}
 
 // Sets default values
 ABasePlayerPawn::ABasePlayerPawn( const FObjectInitializer& ObjectInitializer )
@@ -31,8 +43,6 @@ ABasePlayerPawn::ABasePlayerPawn( const FObjectInitializer& ObjectInitializer )
 	, IsAlive( true )
 	, DisableMovement( true )
 	, CurrentTurnFloorPiece( nullptr )
-	, CurrentWallPiece( nullptr )
-	, TouchingWallPiece( false )
 	, StrafeMaxSpeed( 550.0f )
 	, StrafeVelocity( 0.0f )
 	, StrafeFriction( 0.98f )
@@ -44,10 +54,14 @@ ABasePlayerPawn::ABasePlayerPawn( const FObjectInitializer& ObjectInitializer )
 	, HoverFriction( 0.98f )
 	, RotationRateSensitivity( 0.005f )
 	, InputMode( EInputMode::EIM_KEYBOARD )
+	, MinObstacleExtent( MAX_flt )
 	, UpgradeTimer( 0.0f )
 	, PreviousForwardSpeed( 0.0f )
 	, HasFirstCollision( false )
 	, FloorToPawnDistance( 0.0f )
+	, SimulationAccumulator( 0.0f )
+	, ReplayMode( ECubeReplayMode::ECRM_NONE )
+	, ApplyingReplayFrame( false )
 {
 	PrimaryActorTick.bCanEverTick = true;
 	PrimaryActorTick.bStartWithTickEnabled = true;
@@ -75,6 +89,21 @@ void ABasePlayerPawn::BeginPlay()
 	ForwardBaseSpeed = ForwardSpeed; 
 	StrafeBaseAcceleration = StrafeAcceleration;
 
+	MeshRelativeTransform = Mesh->GetRelativeTransform();
+	ResetSimulationInterpolation();
+
+	// Obstacles spawned as components, instanced meshes are measured by the instance manager as they are placed
+	if( auto* GameData = UCubeSingletonDataLibrary::GetGameData() )
+	{
+		for( const auto& Class : { GameData->ClassicCubeObstacleBPClass, GameData->AdvancedCubeObstacleBPClass } )
+		{
+			const auto* Obstacle = Class ? Cast< UStaticMeshComponent >( Class->GetDefaultObject() ) : nullptr;
+
+			if( Obstacle && Obstacle->GetStaticMesh() )
+				MinObstacleExtent = FMath::Min( MinObstacleExtent, Obstacle->GetStaticMesh()->GetBounds().BoxExtent.GetMin() * Obstacle->GetRelativeScale3D().GetAbsMin() );
+		}
+	}
+
 	Mesh->OnComponentBeginOverlap.AddDynamic( this, &ABasePlayerPawn::OnMeshOverlapBegin );
 	Mesh->OnComponentEndOverlap.AddDynamic( this, &ABasePlayerPawn::OnMeshOverlapEnd );
 }
@@ -83,7 +112,45 @@ void ABasePlayerPawn::BeginPlay()
 void ABasePlayerPawn::Tick( float DeltaTime )
 {
 	Super::Tick( DeltaTime );
-	
+
+	if( ReplayMode == ECubeReplayMode::ECRM_PLAYBACK )
+	{
+		FCubeReplayFrame Frame;
+
+		if( GetGameInstance< UCubeGameInstance >()->ConsumeReplayFrame( Frame ) )
+		{
+			ApplyingReplayFrame = true;
+			ApplyReplayFrame( Frame );
+			ApplyingReplayFrame = false;
+		}
+	}
+
+	const auto StepTime = 1.0f / GetSimulationRate();
+	SimulationAccumulator = FMath::Min( SimulationAccumulator + DeltaTime, StepTime * MaxStepsPerFrame );
+
+	// Steps trace and collide from the simulated mesh position
+	if( SimulationAccumulator >= StepTime )
+		Mesh->SetRelativeTransform( MeshRelativeTransform );
+
+	while( SimulationAccumulator >= StepTime )
+	{
+		PreviousSimulationTransform = GetActorTransform();
+		SimulationStep( StepTime );
+		SimulationAccumulator -= StepTime;
+	}
+
+	InterpolateMesh( SimulationAccumulator / StepTime );
+
+	if( ReplayMode == ECubeReplayMode::ECRM_RECORD )
+	{
+		FrameInput.DeltaTime = DeltaTime;
+		GetGameInstance< UCubeGameInstance >()->RecordReplayFrame( FrameInput );
+		FrameInput.Jump = false;
+	}
+}
+
+void ABasePlayerPawn::SimulationStep( float DeltaTime )
+{
 	if( StartTimer == 0.0f )
 	{
 		ProcessHeightTracing( DeltaTime );
@@ -98,7 +165,10 @@ void ABasePlayerPawn::Tick( float DeltaTime )
 	}
 
 	if( !DisableMovement )
+	{
+		ApplyFrameInput( DeltaTime );
 		ProcessMovement( DeltaTime );
+	}
 
 	if( IsAlive && !DisableMovement )
 	{
@@ -106,13 +176,44 @@ void ABasePlayerPawn::Tick( float DeltaTime )
 			ProcessStrafeRoll( DeltaTime );
 
 		ProcessUpgradeTimer( DeltaTime );
-		ApplyFriction();
+		ApplyFriction( DeltaTime );
 
 		if( GetActorLocation().Z <= -500.0f )
 			Explode( true );
 	}
 }
 
+void ABasePlayerPawn::InterpolateMesh( const float Alpha )
+{
+	FTransform Visual;
+	Visual.Blend( PreviousSimulationTransform, GetActorTransform(), Alpha );
+	Mesh->SetWorldTransform( MeshRelativeTransform * Visual );
+}
+
+void ABasePlayerPawn::ApplyWorldOffset( const FVector& InOffset, bool bWorldShift )
+{
+	Super::ApplyWorldOffset( InOffset, bWorldShift );
+
+	// Shift the last step with the actor so the mesh interpolation doesn't jump
+	PreviousSimulationTransform.AddToTranslation( InOffset );
+}
+
+void ABasePlayerPawn::ResetSimulationInterpolation()
+{
+	PreviousSimulationTransform = GetActorTransform();
+	Mesh->SetRelativeTransform( MeshRelativeTransform );
+}
+
+int32 ABasePlayerPawn::GetSimulationRate()
+{
+	return FMath::Max( 1, CVarSimulationRate.GetValueOnGameThread() );
+}
+
+void ABasePlayerPawn::SetSimulationRate( const int32 Rate )
+{
+	CVarSimulationRate->Set( Rate, ECVF_SetByCode );
+}
+
 void ABasePlayerPawn::ProcessUpgradeTimer( float DeltaTime )
 {
 	if( UpgradeTimer )
@@ -132,45 +233,21 @@ void ABasePlayerPawn::ProcessMovement( float DeltaTime )
 {
 	if( !IsValid( CurrentTurnFloorPiece ) )
 	{
-		auto WallCorrection = 0.0f;
-
-		// Wall collision
-		if( IsValid( CurrentWallPiece ) )
-		{
-			StrafeVelocity = ( CurrentWallPiece->LeftWall ? FMath::Max( StrafeVelocity, 0.0f ) : FMath::Min( StrafeVelocity, 0.0f ) );
-
-			//if( TouchingWallPiece )
-			//{
-			//	const auto WallAngle = CurrentWallPiece->GetActorRotation().Yaw;
-			//	// Trig to caculate how much to move the pawn out by the avoid collision
-			//	if( ( CurrentWallPiece->LeftWall && WallAngle > 0 ) || ( !CurrentWallPiece->LeftWall && WallAngle < 0 ) )
-			//		WallCorrection = FMath::Tan( WallAngle ) * ForwardSpeed;
-			//}
-
-			//TouchingWallPiece = true;	
-		}
-		else
-		{
-			TouchingWallPiece = false;
-		}
-
-		const auto Side = FVector( GetActorRightVector().X, GetActorRightVector().Y, 0.0f ) * ( StrafeVelocity + WallCorrection );
+		const auto Side = FVector( GetActorRightVector().X, GetActorRightVector().Y, 0.0f ) * StrafeVelocity;
 		const auto Forward = GetActorForwardVector() * ForwardSpeed;
 		const auto Up = FVector( 0.0f, 0.0f, HoverVelocity );
 		TotalDistanceTravelled += ForwardSpeed * DeltaTime;
 
-		AddActorWorldOffset( ( Forward + Side + Up ) * DeltaTime );
+		SweptMove( ( Forward + Side + Up ) * DeltaTime, true );
 		IncreaseSpeed( ForwardSpeedIncrease * ( HoverHeight + 25.0f ? 1.0f : 0.9f ), DeltaTime );
 	}
 	else
 	{
-		auto NewTransform = CurrentTurnFloorPiece->GetTurnTargetTransform( StrafeVelocity * DeltaTime );
+		auto NewTransform = CurrentTurnFloorPiece->GetTurnTargetTransform( DeltaTime, StrafeVelocity * DeltaTime );
 
 		auto NewLocation = NewTransform.GetLocation();
 		NewLocation.Z = GetActorLocation().Z;
-		SetActorLocation( NewLocation );
-
-		AddActorWorldOffset( FVector( 0.0f, 0.0f, HoverVelocity ) * DeltaTime );
+		SweptMove( NewLocation - GetActorLocation() + FVector( 0.0f, 0.0f, HoverVelocity ) * DeltaTime, false );
 
 		auto NewRotation = GetActorRotation();
 		NewRotation.Yaw = NewTransform.GetRotation().Rotator().Yaw;
@@ -243,7 +320,7 @@ void ABasePlayerPawn::ProcessHeightTracing( float DeltaTime )
 		const auto Thrust = ThrustStrength * ThrustStrength * ( HoverHeight - FloorToPawnDistance );
 		const auto Smoothing = HoverVelocity * 2.0f * Damping * ThrustStrength;
 		const auto FinalThrust = ( Thrust - Smoothing );// *Mesh->GetMass();// -Gravity;
-		HoverVelocity += FinalThrust * FMath::Min( 0.1f, DeltaTime );
+		HoverVelocity += FinalThrust * DeltaTime;
 		HoverAcceleration = 0.0f;
 		const bool UsingFrontTrace = FloorToPawnDistance == FloorTraceResultFront.Distance;
 		const auto RotFromZ = UKismetMathLibrary::MakeRotFromZ( UsingFrontTrace ? FloorTraceResultFront.Normal : FloorTraceResultBack.Normal );
@@ -253,7 +330,7 @@ void ABasePlayerPawn::ProcessHeightTracing( float DeltaTime )
 	{
 		// Fake gravity ;)
 		HoverAcceleration += GetWorld()->GetGravityZ() * ( Mesh->IsGravityEnabled() ? 1.0f : 0.0f ) * DeltaTime;
-		HoverVelocity += HoverAcceleration;
+		HoverVelocity += HoverAcceleration * DeltaTime * 60.0f;
 		Rotation.Pitch = 0.0f;
 	}
 
@@ -270,7 +347,25 @@ void ABasePlayerPawn::SetupPlayerInputComponent( class UInputComponent* InputCmp
 	InputCmp->BindVectorAxis( "Gravity", this, &ABasePlayerPawn::Gravity );
 }
 
-void ABasePlayerPawn::MoveSideways( float AxisValue )
+void ABasePlayerPawn::ApplyFrameInput( float DeltaTime )
+{
+	// Input events only record the axis values, they are integrated here so every step sees the same input
+	if( InputMode == EInputMode::EIM_GYROSCOPIC )
+	{
+		if( FrameInput.Gravity.Size() != 0.0f )
+		{
+			const auto NormalisedAngle = FMath::Min( 1.0f, FMath::Max( -1.0f, FrameInput.Gravity.Y / 4.0f ) );
+			MoveSideways( FMath::Min( 1.0f, FMath::Max( -1.0f, NormalisedAngle * RotationRateSensitivity ) ), DeltaTime );
+			auto NewRotation = GetActorRotation();
+			NewRotation.Roll = CurrentRoll;
+			SetActorRotation( NewRotation );
+		}
+	}
+	else if( FrameInput.Sideways != 0.0f )
+		MoveSideways( FrameInput.Sideways, DeltaTime );
+}
+
+void ABasePlayerPawn::MoveSideways( float AxisValue, float DeltaTime )
 {
 	if( !DisableMovement )
 	{
@@ -281,7 +376,7 @@ void ABasePlayerPawn::MoveSideways( float AxisValue )
 
 		if( IsAlive )
 		{
-			auto Increase = StrafeAcceleration * AxisValue * GetWorld()->DeltaTimeSeconds * ( IsValid( CurrentTurnFloorPiece ) ? 0.6f : 1.0f );
+			auto Increase = StrafeAcceleration * AxisValue * DeltaTime * ( IsValid( CurrentTurnFloorPiece ) ? 0.6f : 1.0f );
 			StrafeVelocity = FMath::Clamp( StrafeVelocity + Increase, -StrafeMaxSpeed, StrafeMaxSpeed );
 		}
 	}
@@ -289,15 +384,10 @@ void ABasePlayerPawn::MoveSideways( float AxisValue )
 
 void ABasePlayerPawn::MoveSidewaysInput( float AxisValue )
 {
-	if( InputMode == EInputMode::EIM_KEYBOARD )
+	if( InputMode == EInputMode::EIM_KEYBOARD && !IsInputLocked() )
 	{
-		if( AxisValue )
-		{
-			CurrentRoll = AxisValue;
-			MoveSideways( AxisValue );
-		}
-		else
-			CurrentRoll = 0.0f;
+		FrameInput.Sideways = AxisValue;
+		CurrentRoll = AxisValue;
 	}
 }
 
@@ -309,42 +399,40 @@ void ABasePlayerPawn::SetInputMode( EInputMode NewInputMode )
 
 void ABasePlayerPawn::MoveSidewaysInputButtons( float AxisValue )
 {
-	if( InputMode == EInputMode::EIM_SCREEN_BUTTONS )
+	if( InputMode == EInputMode::EIM_SCREEN_BUTTONS && !IsInputLocked() )
 	{
-		if( AxisValue )
-		{
-			CurrentRoll = AxisValue;
-			MoveSideways( AxisValue );
-		}
-		else
-			CurrentRoll = 0.0f;
+		FrameInput.Sideways = AxisValue;
+		CurrentRoll = AxisValue;
 	}
 }
 
 void ABasePlayerPawn::Gravity( FVector Gravity )
 {
-	if( InputMode == EInputMode::EIM_GYROSCOPIC && !DisableMovement )
+	if( InputMode == EInputMode::EIM_GYROSCOPIC && !DisableMovement && !IsInputLocked() )
 	{
+		FrameInput.Gravity = Gravity;
+
 		if( Gravity.Size() != 0.0f )
-		{
-			const auto NormalisedAngle = FMath::Min( 1.0f, FMath::Max( -1.0f, Gravity.Y / 4.0f ) );
-			CurrentRoll = NormalisedAngle * RollMax;
-			MoveSideways( FMath::Min( 1.0f, FMath::Max( -1.0f, NormalisedAngle * RotationRateSensitivity ) ) );
-			auto NewRotation = GetActorRotation();
-			NewRotation.Roll = CurrentRoll;
-			SetActorRotation( NewRotation );
-		}
+			CurrentRoll = FMath::Min( 1.0f, FMath::Max( -1.0f, Gravity.Y / 4.0f ) ) * RollMax;
 	}
 }
 
-void ABasePlayerPawn::ApplyFriction()
+void ABasePlayerPawn::ApplyReplayFrame( const FCubeReplayFrame& Frame )
+{
+	// Each of these only acts in the input mode it was recorded from
+	MoveSidewaysInput( Frame.Sideways );
+	MoveSidewaysInputButtons( Frame.Sideways );
+	Gravity( Frame.Gravity );
+}
+
+void ABasePlayerPawn::ApplyFriction( float DeltaTime )
 {
-	StrafeVelocity *= StrafeFriction;
+	StrafeVelocity *= ScaleToStep( StrafeFriction, DeltaTime );
 
 	if( FMath::Abs( StrafeVelocity ) <= 0.1f )
 		StrafeVelocity = 0.0f;
 
-	HoverVelocity *= HoverFriction;
+	HoverVelocity *= ScaleToStep( HoverFriction, DeltaTime );
 
 	if( FMath::Abs( HoverVelocity ) <= 0.1f )
 		HoverVelocity = 0.0f;
@@ -357,6 +445,114 @@ void ABasePlayerPawn::BeginTurn( ABaseTurnFloorPiece* TurnPiece )
 	CurrentTurnFloorPiece = TurnPiece;
 }
 
+void ABasePlayerPawn::ClampToCorridor( FVector& Offset )
+{
+	auto* CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() );
+	auto* Piece = CubeGM ? CubeGM->GetCurrentTrackPiece() : nullptr;
+
+	if( !IsValid( Piece ) || !Piece->HasCorridor() )
+		return;
+
+	const auto& PieceTransform = Piece->GetActorTransform();
+	auto Local = PieceTransform.InverseTransformPosition( GetActorLocation() + Offset );
+	float MinY, MaxY;
+
+	if( !Piece->GetCorridorBounds( Local.X, MinY, MaxY ) )
+		return;
+
+	// World bounds grow as the pawn yaws through a turn, the local extent is its real width
+	const auto HalfWidth = Mesh->CalcLocalBounds().BoxExtent.Y * FMath::Abs( Mesh->GetComponentScale().Y );
+	const auto ClampedY = MinY + HalfWidth > MaxY - HalfWidth ? ( MinY + MaxY ) * 0.5f : FMath::Clamp( Local.Y, MinY + HalfWidth, MaxY - HalfWidth );
+
+	if( ClampedY == Local.Y )
+		return;
+
+	// Slide along the wall rather than into it
+	StrafeVelocity = ClampedY > Local.Y ? FMath::Max( StrafeVelocity, 0.0f ) : FMath::Min( StrafeVelocity, 0.0f );
+	Local.Y = ClampedY;
+	Offset = PieceTransform.TransformPosition( Local ) - GetActorLocation();
+}
+
+void ABasePlayerPawn::SweptMove( const FVector& Offset, const bool ApplyCorridor )
+{
+	auto ObstacleExtent = MinObstacleExtent;
+
+	if( auto* CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() ) )
+		if( auto* InstanceManager = CubeGM->GetObstacleInstanceManager() )
+			ObstacleExtent = FMath::Min( ObstacleExtent, InstanceManager->GetSmallestObstacleExtent() );
+
+	const auto Substeps = FMath::Clamp( FMath::CeilToInt( Offset.Size() / FMath::Max( 1.0f, ObstacleExtent ) ), 1, MaxSweepSubsteps );
+	const auto Step = Offset / Substeps;
+
+	FCollisionQueryParams Params( SCENE_QUERY_STAT( PlayerSweep ), false, this );
+	// Everything overlaps so touching the floor can't end the sweep early
+	const FCollisionResponseParams Response( ECR_Overlap );
+	const auto Shape = Mesh->GetCollisionShape();
+	TArray< FHitResult > Hits;
+
+	for( int32 i = 0; i < Substeps && !DisableMovement; ++i )
+	{
+		auto SubstepOffset = Step;
+
+		if( ApplyCorridor )
+			ClampToCorridor( SubstepOffset );
+
+		const auto Start = Mesh->GetComponentLocation();
+		Hits.Reset();
+		GetWorld()->SweepMultiByChannel( Hits, Start, Start + SubstepOffset, Mesh->GetComponentQuat(), Mesh->GetCollisionObjectType(), Shape, Params, Response );
+
+		for( const auto& Hit : Hits )
+		{
+			if( !IsAlive )
+				break;
+
+			// Obstacle actors explode the pawn on overlap too, a fast sweep would otherwise step past them
+			if( IsObstacleComponent( Hit.GetComponent() ) || IsValid( Cast< ABaseObstacle >( Hit.GetActor() ) ) )
+			{
+				Explode();
+
+				// Stop where we hit it
+				if( !IsAlive )
+					SubstepOffset *= Hit.Time;
+			}
+			// Pickups passed between steps
+			else if( auto* Upgrade = Cast< ABaseUpgrade >( Hit.GetActor() ) )
+			{
+				if( !Upgrade->IsHidden() )
+					AddUpgrade( Upgrade );
+			}
+		}
+
+		AddActorWorldOffset( SubstepOffset );
+	}
+}
+
+bool ABasePlayerPawn::IsObstacleComponent( const UPrimitiveComponent* Component ) const
+{
+	return IsValid( Cast< UBaseObstacleComponent >( Component ) ) || IsValid( Cast< UInstancedStaticMeshComponent >( Component ) );
+}
+
+void ABasePlayerPawn::EnterTurnPiece( ABaseTurnFloorPiece* TurnPiece )
+{
+	if( CurrentTurnFloorPiece )
+	{
+		const auto Yaw = UKismetMathLibrary::MakeRotFromX( CurrentTurnFloorPiece->GetTurnEndTransform().GetUnitAxis( EAxis::X ) ).Yaw;
+		SetActorRotation( FRotator( GetActorRotation().Pitch, Yaw, GetActorRotation().Roll ) );
+	}
+
+	BeginTurn( TurnPiece );
+}
+
+void ABasePlayerPawn::ExitTurnPiece( ABaseTurnFloorPiece* TurnPiece )
+{
+	if( CurrentTurnFloorPiece && CurrentTurnFloorPiece == TurnPiece )
+	{
+		const auto Yaw = UKismetMathLibrary::MakeRotFromX( CurrentTurnFloorPiece->GetTurnEndTransform().GetUnitAxis( EAxis::X ) ).Yaw;
+		SetActorRotation( FRotator( GetActorRotation().Pitch, Yaw, GetActorRotation().Roll ) );
+		CurrentTurnFloorPiece = nullptr;
+	}
+}
+
 void ABasePlayerPawn::Explode( bool force /*= false*/ )
 {
 	if( force || this->CanBeDamaged() )
@@ -378,11 +574,13 @@ void ABasePlayerPawn::AddUpgrade( ABaseUpgrade* Upgrade )
 {
 	UCubeSingletonDataLibrary::CustomLog( "ABasePlayerPawn::AddUpgrade | Adding Upgrade: " + FString::FromInt( static_cast< int32 >( Upgrade->UpgradeType ) ), LogDisplayType::Gameplay );
 
-	// Destroy upgrade & spawn particle
-	if ( const auto Particle = UCubeSingletonDataLibrary::GetGameData()->UpgradeParticle )
-		UGameplayStatics::SpawnEmitterAtLocation( GetWorld(), Particle, GetActorLocation( ) )->SetWorldScale3D( FVector( 5.0f ) );
-
 	auto* GameMode = Cast< ACubeRunnerGameMode >( UGameplayStatics::GetGameMode( GetWorld() ) );
+
+	// Destroy upgrade & spawn particle (cosmetic, the quality governor may skip it)
+	const auto Particle = UCubeSingletonDataLibrary::GetGameData()->UpgradeParticle;
+
+	if ( Particle && ( !IsValid( GameMode ) || GameMode->QualityGovernor.AreEffectsEnabled() ) )
+		UGameplayStatics::SpawnEmitterAtLocation( GetWorld(), Particle, GetActorLocation( ) )->SetWorldScale3D( FVector( 5.0f ) );
 	
 	if( IsValid( GameMode ) )
 		GameMode->OnUpgradeAdded( Upgrade );
@@ -411,7 +609,8 @@ void ABasePlayerPawn::AddUpgrade( ABaseUpgrade* Upgrade )
 		}
 	}
 
-	//Upgrade->Destroy();
+	// The owning floor piece returns it to the pool when it is removed
+	Upgrade->SetUpgradeActive( false );
 }
 
 void ABasePlayerPawn::RemoveUpgrade( EUpgradeType Type )
@@ -436,105 +635,32 @@ void ABasePlayerPawn::RemoveUpgrade( EUpgradeType Type )
 
 void ABasePlayerPawn::OnMeshOverlapBegin( class UPrimitiveComponent* OverlappedComponent, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult )
 {
-	auto CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() );
-	const auto* DataSingleton = Cast<UCubeDataSingleton>( GEngine->GameSingleton );
-
 	// Obstacles (outside of IsAlive check because when you complete a level, the pawn keeps moving but IsAlive is false)
 	if( IsValid( Cast< ABaseObstacle >( OtherActor ) ) )
 		Explode();
 
-	if( IsValid( Cast< UBaseObstacleComponent >( OtherComp ) ) )
-		Explode();
-
-	if( IsValid( Cast< UInstancedStaticMeshComponent >( OtherComp ) ) )
+	if( IsObstacleComponent( OtherComp ) )
 		Explode();
 
 	UCubeSingletonDataLibrary::CustomLog( "ABasePlayerPawn::OverlapBegin: " + OtherActor->GetName() + ( OtherComp ? " : " + OtherComp->GetName() : "" ) );
 
 	if( IsAlive )
 	{
-		// Floor piece
-		if( auto* FloorPiece = Cast< ABaseFloorPiece >( OtherActor ) )
-		{
-			// Turn pieces
-			if( auto* TurnPiece = Cast< ABaseTurnFloorPiece >( OtherActor ) )
-			{
-				if( TurnPiece->TurnZone == OtherComp )
-				{
-					if( CurrentTurnFloorPiece )
-					{
-						const auto Yaw = UKismetMathLibrary::MakeRotFromX( CurrentTurnFloorPiece->TurnEndPoint->GetForwardVector() ).Yaw;
-						SetActorRotation( FRotator( GetActorRotation().Pitch, Yaw, GetActorRotation().Roll ) );
-					}
-
-					BeginTurn( TurnPiece );
-				}
-			}
-
-			// Collide
-			if( Cast< UBoxComponent >( OtherComp ) )
-			{
-				// Multi collision
-				if( FloorPiece->MultiConnections.Num() > 1 )
-				{
-					for( int32 i = 0; i < FloorPiece->MultiConnections.Num(); ++i )
-					{
-						if( OtherComp == FloorPiece->MultiConnections[ i ].Collider )
-						{
-							CubeGM->SpawnQueueRoot = ( CubeGM->SpawnQueueRoot->NextQueueItems.Num() ? CubeGM->SpawnQueueRoot->NextQueueItems[i] : nullptr );
-							CubeGM->SpawnFloorPiece( FloorPiece->MultiConnections[i].ConnectionPoint->GetComponentTransform() );
-							break;
-						}
-					}
-				}
-				// Floor piece collision
-				else if( FloorPiece->SpawnCollison == OtherComp && !FloorPiece->HasTriggered )
-				{
-					// Handle end collision
-					if( FloorPiece->EndLevelPiece )
-					{
-						UCubeSingletonDataLibrary::CustomLog( "Level Complete" );
-						CubeGM->GameEnd( EGameEndState::EGES_SUCCESS );
-
-						if( !CubeGM->LevelSpawnAfterFinish )
-							return;
-					}
-
-					// Only spawn / remove if not a transition piece
-					if( !IsValid( Cast< ABaseTransitionFloorPiece >( FloorPiece ) ) || ( !CubeGM->LevelSpawnTransitions && HasFirstCollision ) )
-					{
-						if( CubeGM->PreSpawnedPieces >= 1 )
-						{
-							CubeGM->PreSpawnedPieces--;
-							UCubeSingletonDataLibrary::CustomLog( "ACubeRunnerGameMode | PreSpawnedPieces: " + FString::FromInt( CubeGM->PreSpawnedPieces ) );
-							return;
-						}
-
-						CubeGM->SpawnFloorPiece( FloorPiece->ConnectionPoint->GetComponentTransform() );
-						CubeGM->RemoveFloorPiece();
-					}
-
-					FloorPiece->HasTriggered = true;
-					HasFirstCollision = true;
-				}
-			}
-		}
+		// Floor pieces are left alone, spawning, removal and turns are driven by the game mode's track progress
+		if( IsValid( Cast< ABaseFloorPiece >( OtherActor ) ) )
+			return;
 
 		// Upgrades
-		else if( auto* Upgrade = Cast< ABaseUpgrade >( OtherActor ) )
+		if( auto* Upgrade = Cast< ABaseUpgrade >( OtherActor ) )
 		{
 			AddUpgrade( Upgrade );
 		}
 
-		// Wall piece
-		else if( auto* WallPiece = Cast< ABaseWallPiece >( OtherActor ) )
+		else if( IsValid( Cast< ABaseWallPiece >( OtherActor ) ) )
 		{
-			CurrentWallPiece = WallPiece;
-			const auto Direction = CurrentWallPiece->GetActorLocation() - GetActorLocation();
-			const float Dist = FVector::DotProduct( Direction, GetActorRightVector() );
-			CurrentWallPiece->LeftWall = Dist <= 0.0f;
+			// ClampToCorridor already keeps the pawn off walls, so a graze mustn't reach the head on check below
 		}
-		
+
 		// If no matches, just check if we have directly hit into the actor (which results in the pawn exploding)
 		else if( IsValid( Cast< UStaticMeshComponent >( OtherComp ) ) )
 		{
@@ -558,19 +684,6 @@ void ABasePlayerPawn::OnMeshOverlapBegin( class UPrimitiveComponent* OverlappedC
 void ABasePlayerPawn::OnMeshOverlapEnd( class UPrimitiveComponent* OverlappedComponent, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex )
 {
 	//UCubeSingletonDataLibrary::CustomLog( "ABasePlayerPawn::OverlapEnd" );
-	if( auto* turn_piece = Cast< ABaseTurnFloorPiece >( OtherActor ) )
-	{
-		if( turn_piece->TurnZone == OtherComp && CurrentTurnFloorPiece && CurrentTurnFloorPiece == turn_piece )
-		{
-			const auto Yaw = UKismetMathLibrary::MakeRotFromX( CurrentTurnFloorPiece->TurnEndPoint->GetForwardVector() ).Yaw;
-			SetActorRotation( FRotator( GetActorRotation().Pitch, Yaw, GetActorRotation().Roll ) );
-			CurrentTurnFloorPiece = nullptr;
-		}
-	}
-	else if( auto* wall_piece = Cast< ABaseWallPiece >( OtherActor ) )
-	{
-		CurrentWallPiece = nullptr;
-	}
 }
 
 void ABasePlayerPawn::IncreaseSpeed( const int32 Speed, const float DeltaTime /*= 1.0f*/ )
@@ -6,6 +6,7 @@
 #include "BaseTurnFloorPiece.h"
 #include "BaseWallPiece.h"
 #include "BaseUpgrade.h"
+#include "CubeReplay.h"
 #include "BasePlayerPawn.generated.h"
 
 UENUM( BlueprintType )
@@ -28,6 +29,7 @@ public:
 	virtual void BeginPlay() override;
 	virtual void Tick( float DeltaSeconds ) override;
 	virtual void SetupPlayerInputComponent( class UInputComponent* InputComponent ) override;
+	virtual void ApplyWorldOffset( const FVector& InOffset, bool bWorldShift ) override;
 
 	UFUNCTION( BlueprintImplementableEvent, Category = "Events" )
 	void StartTimerComplete();
@@ -52,20 +54,47 @@ public:
 	UFUNCTION()
 	void OnMeshOverlapEnd( class UPrimitiveComponent* OverlappedComponent, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex );
 
+	// Driven by the game mode's track progress
+	void EnterTurnPiece( ABaseTurnFloorPiece* TurnPiece );
+	void ExitTurnPiece( ABaseTurnFloorPiece* TurnPiece );
+
 	// Utility
 	void IncreaseSpeed( const int32 Speed, const float DeltaTime = 1.0f );
 	void SetSpeed( const int32 Speed );
 	virtual void UpdateStrafeMaxSpeed();
 
+	// Call after teleporting the pawn so the mesh doesn't interpolate across the jump
+	void ResetSimulationInterpolation();
+
+	static int32 GetSimulationRate();
+	static void SetSimulationRate( const int32 Rate );
+
 protected:
+	void SimulationStep( float DeltaTime );
+	void InterpolateMesh( const float Alpha );
 	virtual void ProcessMovement( float DeltaTime );
-	virtual void ApplyFriction();
+	virtual void ApplyFriction( float DeltaTime );
 	virtual void BeginTurn( ABaseTurnFloorPiece* TurnPiece );
 
+	// Per frame factors (friction etc.) were tuned at 60fps, this gives the equivalent for a step
+	static float ScaleToStep( const float PerFrame, const float DeltaTime ) { return FMath::Pow( PerFrame, DeltaTime * 60.0f ); }
+
+	// Keeps a world space move inside the corridor of the piece we are on
+	void ClampToCorridor( FVector& Offset );
+
+	// Moves in substeps no longer than the smallest obstacle, sweeping each one so nothing is tunnelled through at speed
+	void SweptMove( const FVector& Offset, const bool ApplyCorridor );
+	bool IsObstacleComponent( const UPrimitiveComponent* Component ) const;
+
 	// Input
 	virtual void Gravity( FVector Gravity );
+	virtual void ApplyReplayFrame( const FCubeReplayFrame& Frame );
+
+	// Live input is ignored while a replay is feeding the pawn
+	bool IsInputLocked() const { return ReplayMode == ECubeReplayMode::ECRM_PLAYBACK && !ApplyingReplayFrame; }
 
-	void MoveSideways( float AxisValue );
+	virtual void ApplyFrameInput( float DeltaTime );
+	void MoveSideways( float AxisValue, float DeltaTime );
 	void ProcessUpgradeTimer( float DeltaTime );
 	void ProcessStrafeRoll( float DeltaTime );
 	void ProcessHeightTracing( float DeltaTime );
@@ -94,12 +123,10 @@ public:
 	// Used so that the pawn can keep moving once you complete the level, then stops after 5 seconds
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = "Stats" ) bool DisableMovement;
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = "Stats" ) ABaseTurnFloorPiece* CurrentTurnFloorPiece;
-	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = "Stats" ) ABaseWallPiece* CurrentWallPiece;
 
 	float StrafeBaseMaxSpeed;
 	float ForwardBaseSpeed;
 	float StrafeBaseAcceleration;
-	bool TouchingWallPiece;
 
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = "Stats" ) float StrafeMaxSpeed;
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = "Stats" ) float StrafeVelocity;
@@ -114,9 +141,20 @@ public:
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = "Stats" ) float HoverAcceleration;
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = "Stats" ) float RotationRateSensitivity;
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = "Stats" ) EInputMode InputMode;
+	// Half extent of the thinnest obstacle mesh, sweep substeps are kept shorter than it
+	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = "Stats" ) float MinObstacleExtent;
 
 	float UpgradeTimer;
 	float PreviousForwardSpeed;
 	bool HasFirstCollision;
 	float FloorToPawnDistance;
+
+	// Fixed rate simulation, the actor transform is the simulated state and the mesh is drawn between the last two steps
+	float SimulationAccumulator;
+	FTransform PreviousSimulationTransform;
+	FTransform MeshRelativeTransform;
+
+	ECubeReplayMode ReplayMode;
+	bool ApplyingReplayFrame;
+	FCubeReplayFrame FrameInput;
 };
\ No newline at end of file
@@ -6,46 +6,143 @@
 #include "Kismet/KismetMathLibrary.h"
 #include "CubeRunnerGameMode.h"
 #include "CubeSingletonDataLibrary.h"
+#include "CubeMemory.h"
+#include "Async/Async.h"
+#include "Misc/ScopeExit.h"
 
 #include <random>
 
 #include "Components/BoxComponent.h"
 #include "Components/ArrowComponent.h"
 
+DECLARE_CYCLE_STAT( TEXT( "Randomised Floor Recentre" ), STAT_RandomisedFloorRecentre, STATGROUP_CubeRunner );
+DECLARE_DWORD_COUNTER_STAT( TEXT( "Randomised Floor Recentres" ), STAT_RandomisedFloorRecentres, STATGROUP_CubeRunner );
+
+namespace
+{
+	int32 RecentreCount = 0;
+	double RecentreSeconds = 0.0;
+}
+
 ABaseRandomisedFloorPiece::ABaseRandomisedFloorPiece( const FObjectInitializer& ObjectInitializer )
 	: Super( ObjectInitializer )
 	, DensityVariation( 30 )
 	, HorizontalUpdateWidth( 400.0f )
+	, SpawnFloorMeshLocation( FVector::ZeroVector )
+	, SpawnConnectionTransform( FTransform::Identity )
 	, MoveThresholdMin( 0.0f )
 	, MoveThresholdMax( 0.0f )
 {
+	// Obstacles are scattered at random on every spawn
+	CacheObstacleLayout = false;
+
 	EndCollision = CreateDefaultSubobject< UBoxComponent >( TEXT( "End Collision" ) );
 	EndCollision->AttachToComponent( FloorMesh, FAttachmentTransformRules::KeepRelativeTransform );
-	EndCollision->SetCollisionEnabled( ECollisionEnabled::QueryOnly );
-	EndCollision->SetGenerateOverlapEvents( true );
+	EndCollision->SetCollisionEnabled( ECollisionEnabled::NoCollision );
+	EndCollision->SetGenerateOverlapEvents( false );
 }
 
-void ABaseRandomisedFloorPiece::BeginPlay()
+void ABaseRandomisedFloorPiece::FloorPieceBeginPlay()
 {
-	Super::BeginPlay();
+	SpawnFloorMeshLocation = FloorMesh->GetRelativeLocation();
+	SpawnConnectionTransform = ConnectionTransform;
 
-	EndCollision->OnComponentEndOverlap.AddDynamic( this, &ABaseRandomisedFloorPiece::OnEndCollisionOverlapEnd );
+	SpawnRandomisedObstacles();
+	Super::FloorPieceBeginPlay();
 }
 
-void ABaseRandomisedFloorPiece::FloorPieceBeginPlay()
+void ABaseRandomisedFloorPiece::FloorPieceReused()
+{
+	FloorMesh->SetRelativeLocation( SpawnFloorMeshLocation );
+	ConnectionTransform = SpawnConnectionTransform;
+	MoveThresholdMin = 0.0f;
+	MoveThresholdMax = 0.0f;
+
+	// A fresh field every time, the previous one was released when the piece was pooled
+	InstancedObstacleData.Empty();
+	SpawnRandomisedObstacles();
+
+	Super::FloorPieceReused();
+}
+
+bool ABaseRandomisedFloorPiece::CanBePooled() const
+{
+	// The obstacles are generated again on reuse so they don't need to come from the class
+	return AllowPooling && !MultiConnections.Num();
+}
+
+void ABaseRandomisedFloorPiece::SpawnRandomisedObstacles()
 {
 	const auto CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() );
-	const float fDensityBase = ( float )CubeGM->LevelRandomisedFloorPieceDensity;
-	const float fDensityVar = ( float )DensityVariation;
+	int32 Seed = 0;
+	auto PrefetchedLayout = CubeGM->TakeObstacleLayout( GetClass(), Seed );
 
-	std::default_random_engine generator;
-	std::normal_distribution< float > distribution( fDensityBase, fDensityVar );
+	// Pieces spawned outside the queue or past the lookahead weren't prefetched
+	const auto Layout = PrefetchedLayout.IsValid() ? PrefetchedLayout.Get() : GenerateLayout( MakeLayoutParams( ( float )CubeGM->LevelRandomisedFloorPieceDensity, Seed ) );
 
-	// Spawn obstacles
-	Density = ( int32 )distribution( generator ); 
-	SpawnObstacle( FloorMesh->GetComponentLocation(), FloorMesh->Bounds.BoxExtent, Density );
+	// Spawn obstacles, every one of them can be hit so the quality governor never thins them
+	Density = Layout.Density;
+	SpawnObstaclesLocal( UCubeSingletonDataLibrary::GetGameData()->ClassicCubeObstacleBPClass, Layout.LocalTransforms, 0 );
+}
 
-	Super::FloorPieceBeginPlay();
+FRandomisedObstacleLayoutParams ABaseRandomisedFloorPiece::MakeLayoutParams( const float DensityBase, const int32 Seed ) const
+{
+	FRandomisedObstacleLayoutParams Params;
+	Params.DensityBase = DensityBase;
+	Params.DensityVariation = ( float )DensityVariation;
+	Params.Seed = Seed;
+
+	const auto* Mesh = FloorMesh ? FloorMesh->GetStaticMesh() : nullptr;
+
+	if( !Mesh )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Randomised floor piece has no floor mesh: " + GetClass()->GetName(), LogDisplayType::Error );
+		return Params;
+	}
+
+	Params.Origin = FloorMesh->GetRelativeLocation();
+	Params.Extent = Mesh->GetBounds().BoxExtent * FloorMesh->GetRelativeScale3D();
+	Params.Rotation = FloorMesh->GetRelativeRotation().RotateVector( FVector::UpVector ).Rotation();
+	return Params;
+}
+
+FRandomisedObstacleLayout ABaseRandomisedFloorPiece::GenerateLayout( const FRandomisedObstacleLayoutParams& Params )
+{
+	FRandomisedObstacleLayout Layout;
+
+	if( Params.Extent.IsNearlyZero() )
+		return Layout;
+
+	// Only touches its own random state so it is safe to run on any thread
+	FRandomStream Stream( Params.Seed );
+	std::default_random_engine generator( Stream.GetUnsignedInt() );
+	std::normal_distribution< float > distribution( Params.DensityBase, FMath::Max( Params.DensityVariation, KINDA_SMALL_NUMBER ) );
+
+	Layout.Density = ( int32 )distribution( generator );
+	Layout.LocalTransforms.Reserve( FMath::Max( Layout.Density, 0 ) );
+
+	const auto Extent = FVector( Params.Extent.X - 60.0f, Params.Extent.Y - 60.0f, 0.0f );
+
+	for( int32 i = 0; i < Layout.Density; ++i )
+	{
+		const auto Position = Params.Origin + FVector( Stream.FRandRange( -Extent.X, Extent.X ), Stream.FRandRange( -Extent.Y, Extent.Y ), 75.0f );
+		Layout.LocalTransforms.Add( FTransform( Params.Rotation, Position, FVector( 1.0f, 1.0f, 1.0f ) ) );
+	}
+
+	return Layout;
+}
+
+TFuture< FRandomisedObstacleLayout > ABaseRandomisedFloorPiece::GenerateLayoutAsync( UClass* Class, const float DensityBase, const int32 Seed )
+{
+	const auto* Piece = Cast< ABaseRandomisedFloorPiece >( Class->GetDefaultObject() );
+	const auto Params = Piece->MakeLayoutParams( DensityBase, Seed );
+
+	return Async( EAsyncExecution::ThreadPool, [ Params ]()
+	{
+		// LLM scopes are per thread, so the worker needs its own
+		CUBE_LLM_SCOPE( SpawnQueue );
+		return GenerateLayout( Params );
+	} );
 }
 
 void ABaseRandomisedFloorPiece::SpawnObstacle( FVector Origin, FVector BoxExtent, int32 _Density )
@@ -61,11 +158,41 @@ void ABaseRandomisedFloorPiece::SpawnObstacle( FVector Origin, FVector BoxExtent
 	}
 }
 
+void ABaseRandomisedFloorPiece::ResetRecentreTotals()
+{
+	RecentreCount = 0;
+	RecentreSeconds = 0.0;
+}
+
+int32 ABaseRandomisedFloorPiece::GetRecentreCount()
+{
+	return RecentreCount;
+}
+
+double ABaseRandomisedFloorPiece::GetRecentreSeconds()
+{
+	return RecentreSeconds;
+}
+
 void ABaseRandomisedFloorPiece::MoveFloor( FVector Offset, float DistanceMoved )
 {
-	FVector Difference = ConnectionPoint->GetComponentLocation() - FloorMesh->GetComponentLocation();
+	SCOPE_CYCLE_COUNTER( STAT_RandomisedFloorRecentre );
+
+	const auto LocalDelta = GetActorTransform().InverseTransformVector( Offset - FloorMesh->GetComponentLocation() );
+
+	if( LocalDelta.IsNearlyZero() )
+		return;
+
+	INC_DWORD_STAT( STAT_RandomisedFloorRecentres );
+
+	++RecentreCount;
+	const auto RecentreStart = FPlatformTime::Seconds();
+	ON_SCOPE_EXIT{ RecentreSeconds += FPlatformTime::Seconds() - RecentreStart; };
+
+	// Obstacles live in the shared instance components so they are shifted as one batch rather than following the mesh
 	FloorMesh->SetWorldLocation( Offset );
-	ConnectionPoint->SetWorldLocation( Offset + Difference );
+	ConnectionTransform.AddToTranslation( LocalDelta );
+	ShiftInstancedObstacles( LocalDelta );
 	float DistDiff = FMath::Clamp( DistanceMoved, MoveThresholdMin - HorizontalUpdateWidth,  MoveThresholdMax + HorizontalUpdateWidth );
 
 	// Density & extent
@@ -97,12 +224,3 @@ void ABaseRandomisedFloorPiece::MoveFloor( FVector Offset, float DistanceMoved )
 		SpawnObstacle( GetOrigin( false ), Extent, FinalDensity );
 	}
 }
-
-void ABaseRandomisedFloorPiece::OnEndCollisionOverlapEnd( class UPrimitiveComponent* OverlappedComponent, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex )
-{
-	if( IsValid( Cast< ABasePlayerPawn >( OtherActor ) ) )
-	{
-		const auto CubeGM = Cast< ACubeRunnerGameMode >( GetWorld()->GetAuthGameMode() );
-		CubeGM->UpdateNewFloorPiecePosition = false;
-	}
-}
\ No newline at end of file
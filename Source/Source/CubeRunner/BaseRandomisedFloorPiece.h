@@ -3,8 +3,27 @@
 #pragma once
 
 #include "BaseFloorPiece.h"
+#include "Async/Future.h"
 #include "BaseRandomisedFloorPiece.generated.h"
 
+// Everything a randomised obstacle field depends on, so it can be generated away from the game thread
+struct FRandomisedObstacleLayoutParams
+{
+	// Piece space
+	FVector Origin = FVector::ZeroVector;
+	FVector Extent = FVector::ZeroVector;
+	FRotator Rotation = FRotator::ZeroRotator;
+	float DensityBase = 0.0f;
+	float DensityVariation = 0.0f;
+	int32 Seed = 0;
+};
+
+struct FRandomisedObstacleLayout
+{
+	int32 Density = 0;
+	TArray< FTransform > LocalTransforms;
+};
+
 UCLASS()
 class CUBERUNNER_API ABaseRandomisedFloorPiece : public ABaseFloorPiece
 {
@@ -14,16 +33,26 @@ class CUBERUNNER_API ABaseRandomisedFloorPiece : public ABaseFloorPiece
 public:
 	ABaseRandomisedFloorPiece( const FObjectInitializer& ObjectInitializer );
 
-	virtual void BeginPlay() override;
 	virtual void FloorPieceBeginPlay() override;
+	virtual void FloorPieceReused() override;
+	virtual bool CanBePooled() const override;
 
 	void SpawnObstacle( FVector Origin, FVector BoxExtent, int32 _Density );
 	void MoveFloor( FVector Offset, float DistanceMoved );
 
-	UFUNCTION()		
-	void OnEndCollisionOverlapEnd( class UPrimitiveComponent* OverlappedComponent, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex );
+	// Totals across every randomised piece so a replay benchmark can report the recentre cost without stats enabled
+	static void ResetRecentreTotals();
+	static int32 GetRecentreCount();
+	static double GetRecentreSeconds();
+
+	FRandomisedObstacleLayoutParams MakeLayoutParams( const float DensityBase, const int32 Seed ) const;
+	static FRandomisedObstacleLayout GenerateLayout( const FRandomisedObstacleLayoutParams& Params );
+
+	// Reads the class defaults on the game thread then generates the layout on the thread pool
+	static TFuture< FRandomisedObstacleLayout > GenerateLayoutAsync( UClass* Class, const float DensityBase, const int32 Seed );
 
 protected:
+	void SpawnRandomisedObstacles();
 
 	// Members
 public:
@@ -33,6 +62,10 @@ public:
 	UPROPERTY( EditAnywhere, Category = "Stats" ) float HorizontalUpdateWidth;
 
 private:
+	// Where the floor was before any recentring, a pooled piece goes back there on reuse
+	FVector SpawnFloorMeshLocation;
+	FTransform SpawnConnectionTransform;
+
 	float MoveThresholdMin;
 	float MoveThresholdMax;
 	int32 Density;
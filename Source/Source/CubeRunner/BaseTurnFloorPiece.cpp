@@ -5,23 +5,145 @@
 #include "Components/BoxComponent.h"
 #include "Components/ArrowComponent.h"
 
+void FTurnArc::Initialise( const FVector& Start, const FVector& StartForward, const FVector& End, const FVector& EndForward )
+{
+	StartTangent = FVector( StartForward.X, StartForward.Y, 0.0f ).GetSafeNormal();
+	EndTangent = FVector( EndForward.X, EndForward.Y, 0.0f ).GetSafeNormal();
+	TurnSign = FVector::CrossProduct( StartTangent, EndTangent ).Z >= 0.0f ? 1.0f : -1.0f;
+	SweepAngle = FMath::Acos( FMath::Clamp( FVector::DotProduct( StartTangent, EndTangent ), -1.0f, 1.0f ) );
+	Height = Start.Z;
+
+	const auto StartNormal = FVector( -StartTangent.Y, StartTangent.X, 0.0f ) * TurnSign;
+	const auto EndNormal = FVector( -EndTangent.Y, EndTangent.X, 0.0f ) * TurnSign;
+	const auto Start2D = FVector( Start.X, Start.Y, 0.0f );
+	const auto End2D = FVector( End.X, End.Y, 0.0f );
+	StartRadial = -StartNormal;
+	LeadIn = 0.0f;
+	LeadOut = 0.0f;
+
+	// Distances from each marker to the corner where their directions cross
+	const auto Delta = End2D - Start2D;
+	const auto Cross = StartTangent.X * EndTangent.Y - StartTangent.Y * EndTangent.X;
+	const auto ToCorner = FMath::Abs( Cross ) > KINDA_SMALL_NUMBER ? ( Delta.X * EndTangent.Y - Delta.Y * EndTangent.X ) / Cross : 0.0f;
+	const auto FromCorner = FMath::Abs( Cross ) > KINDA_SMALL_NUMBER ? ( StartTangent.X * Delta.Y - StartTangent.Y * Delta.X ) / Cross : 0.0f;
+
+	if( ToCorner <= 0.0f || FromCorner <= 0.0f )
+	{
+		// No corner between the markers (a u-turn), fit the radius to the normals of both ends
+		const auto NormalDelta = EndNormal - StartNormal;
+		Radius = NormalDelta.SizeSquared() > KINDA_SMALL_NUMBER ? FVector::DotProduct( Start2D - End2D, NormalDelta ) / NormalDelta.SizeSquared() : 0.0f;
+		Centre = Start2D + StartNormal * Radius;
+		return;
+	}
+
+	// The arc touches both lines the same distance from the corner, a straight covers whichever marker is further out
+	const auto TangentLength = FMath::Min( ToCorner, FromCorner );
+	LeadIn = ToCorner - TangentLength;
+	LeadOut = FromCorner - TangentLength;
+	Radius = TangentLength / FMath::Tan( SweepAngle / 2.0f );
+	Centre = Start2D + StartTangent * LeadIn + StartNormal * Radius;
+}
+
+FVector FTurnArc::GetLocation( const float Angle, const float ArcRadius ) const
+{
+	auto Location = Centre + Rotate( StartRadial, FMath::Min( Angle, SweepAngle ) ) * ArcRadius;
+
+	if( Angle > SweepAngle )
+		Location += EndTangent * ( Angle - SweepAngle ) * ArcRadius;
+
+	Location.Z = Height;
+	return Location;
+}
+
+FVector FTurnArc::GetTangent( const float Angle ) const
+{
+	return Angle >= SweepAngle ? EndTangent : Rotate( StartTangent, Angle );
+}
+
+float FTurnArc::GetLength( const float ArcRadius ) const
+{
+	return LeadIn + SweepAngle * ArcRadius + LeadOut;
+}
+
+float FTurnArc::GetRadiusAtOffset( const float LateralOffset ) const
+{
+	// Moving towards the inside of the turn shrinks the radius
+	return Radius - TurnSign * LateralOffset;
+}
+
+FVector FTurnArc::Rotate( const FVector& Direction, const float Angle ) const
+{
+	float Sin, Cos;
+	FMath::SinCos( &Sin, &Cos, Angle * TurnSign );
+	return FVector( Direction.X * Cos - Direction.Y * Sin, Direction.X * Sin + Direction.Y * Cos, 0.0f );
+}
+
 ABaseTurnFloorPiece::ABaseTurnFloorPiece( const FObjectInitializer& ObjectInitializer )
 	: Super( ObjectInitializer )
 {
 	TurnZone = CreateDefaultSubobject<UBoxComponent>( TEXT( "Turn Zone" ) );
 	TurnZone->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
-	TurnZone->SetCollisionEnabled( ECollisionEnabled::QueryOnly );
-	TurnZone->SetGenerateOverlapEvents( true );
+	TurnZone->SetCollisionEnabled( ECollisionEnabled::NoCollision );
+	TurnZone->SetGenerateOverlapEvents( false );
+
+	TurnStartPoint = CreateEditorOnlyDefaultSubobject<UArrowComponent>( TEXT( "Turn Start Point" ) );
+
+	if( TurnStartPoint )
+	{
+		TurnStartPoint->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
+		TurnStartPoint->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+	}
+
+	TurnEndPoint = CreateEditorOnlyDefaultSubobject<UArrowComponent>( TEXT( "Turn End Point" ) );
+
+	if( TurnEndPoint )
+	{
+		TurnEndPoint->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
+		TurnEndPoint->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+	}
+
+	TurnAngle = 0.0f;
+	LeadInRemaining = 0.0f;
+	LeadOutTravelled = 0.0f;
+	TurnRadius = 0.0f;
+	PlayerSpeed = 0.0f;
+}
 
-	TurnStartPoint = CreateDefaultSubobject<UArrowComponent>( TEXT( "Turn Start Point" ) );
-	TurnStartPoint->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
-	TurnStartPoint->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+#if WITH_EDITOR
+void ABaseTurnFloorPiece::BakeMarkers()
+{
+	Super::BakeMarkers();
 
-	TurnEndPoint = CreateDefaultSubobject<UArrowComponent>( TEXT( "Turn End Point" ) );
-	TurnEndPoint->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
-	TurnEndPoint->SetWorldScale3D( FVector( 20.0f, 20.0f, 20.0f ) );
+	if( TurnStartPoint )
+		TurnStartTransform = FTransform( TurnStartPoint->GetRelativeRotation(), TurnStartPoint->GetRelativeLocation() );
 
-	BezierInterpolation = 0.0f;
+	if( TurnEndPoint )
+		TurnEndTransform = FTransform( TurnEndPoint->GetRelativeRotation(), TurnEndPoint->GetRelativeLocation() );
+}
+#endif
+
+TArray< FVector > ABaseTurnFloorPiece::FindBakedTurnControlPoints()
+{
+	const auto Start = GetTurnStartTransform();
+	const auto End = GetTurnEndTransform();
+
+	TArray< FVector > output;
+	output.Add( Start.GetLocation() );
+	output.Add( CalculateCornerPosition( Start.GetLocation(), End.GetLocation(), Start.GetUnitAxis( EAxis::X ) ) );
+	output.Add( End.GetLocation() );
+
+	return output;
+}
+
+void ABaseTurnFloorPiece::ApplyWorldOffset( const FVector& InOffset, bool bWorldShift )
+{
+	Super::ApplyWorldOffset( InOffset, bWorldShift );
+
+	// A turn in progress keeps following the same arc
+	TurnArc.Centre += InOffset;
+	TurnArc.Height += InOffset.Z;
+	TurnStartPosition += InOffset;
+	TargetTransform.AddToTranslation( InOffset );
 }
 
 void ABaseTurnFloorPiece::BeginTurn( FVector Start, float CurrentPlayerSpeed )
@@ -30,62 +152,73 @@ void ABaseTurnFloorPiece::BeginTurn( FVector Start, float CurrentPlayerSpeed )
 	CalculateCurveData();
 
 	PlayerSpeed = CurrentPlayerSpeed;
-	InterpSpeed = PlayerSpeed / CalculateBezierCurveLengthSimple();
+	TurnAngle = 0.0f;
+	LeadInRemaining = TurnArc.LeadIn;
+	LeadOutTravelled = 0.0f;
 }
 
 void ABaseTurnFloorPiece::CalculateCurveData()
 {
-	auto TurnStartPointPos = TurnStartPoint->GetComponentLocation();
-	TurnStartPointPos.Z = TurnStartPosition.Z;
-
-	auto TurnEndPointPos = TurnEndPoint->GetComponentLocation();
-	TurnEndPointPos.Z = TurnStartPosition.Z;
-
-	const auto DirectionFromCentre = TurnStartPosition - TurnStartPointPos;
-	const auto DistFromCentre = FVector::DotProduct( DirectionFromCentre, TurnStartPoint->GetRightVector() );
-	TurnEndPosition = TurnEndPointPos + TurnEndPoint->GetRightVector() * DistFromCentre;
-
-	const auto DirectionFromEnd = TurnEndPosition - TurnStartPosition;
-	const auto DistFromStart = FVector::DotProduct( DirectionFromEnd, TurnStartPoint->GetForwardVector() );
-	TurnCornerPosition = TurnStartPosition + TurnStartPoint->GetForwardVector() * DistFromStart;
+	const auto Start = GetTurnStartTransform();
+	const auto End = GetTurnEndTransform();
+	TurnArc.Initialise( Start.GetLocation(), Start.GetUnitAxis( EAxis::X ), End.GetLocation(), End.GetUnitAxis( EAxis::X ) );
+	TurnArc.Height = TurnStartPosition.Z;
+
+	// The player's offset from the centre line decides the radius they go round the corner at
+	const auto DirectionFromCentre = TurnStartPosition - Start.GetLocation();
+	const auto DistFromCentre = FVector::DotProduct( DirectionFromCentre, Start.GetUnitAxis( EAxis::Y ) );
+	TurnRadius = FMath::Max( 1.0f, TurnArc.GetRadiusAtOffset( DistFromCentre ) );
 }
 
-FTransform ABaseTurnFloorPiece::GetTurnTargetTransform( float Offset /*= 0.0f*/ )
+FTransform ABaseTurnFloorPiece::GetTurnTargetTransform( float DeltaTime, float Offset /*= 0.0f*/ )
 {
-	BezierInterpolation += InterpSpeed * GetWorld()->GetDeltaSeconds();
-	return GetTurnTargetTransformInternal( BezierInterpolation, Offset );
+	TurnRadius = FMath::Max( 1.0f, TurnRadius - TurnArc.TurnSign * Offset );
+
+	AdvanceTurn( PlayerSpeed * DeltaTime );
+	UpdateTargetTransform();
+
+	return TargetTransform;
 }
 
 FTransform ABaseTurnFloorPiece::GetTurnTargetTransformInternal( float Interpolation, float Offset /*= 0.0f*/ )
 {
-	if( Offset != 0.0f )
-	{
-		TurnStartPosition += TurnStartPoint->GetRightVector() * Offset;
-		CalculateCurveData();
-		InterpSpeed = PlayerSpeed / CalculateBezierCurveLengthSimple();
-	}
+	TurnRadius = FMath::Max( 1.0f, TurnRadius - TurnArc.TurnSign * Offset );
+	TurnAngle = 0.0f;
+	LeadInRemaining = TurnArc.LeadIn;
+	LeadOutTravelled = 0.0f;
+	AdvanceTurn( Interpolation * TurnArc.GetLength( TurnRadius ) );
+	UpdateTargetTransform();
 
-	TArray< FVector > ControlPoints;
-	ControlPoints.Add( TurnStartPosition );
-	ControlPoints.Add( TurnCornerPosition );
-	ControlPoints.Add( TurnEndPosition );
+	return TargetTransform;
+}
 
-	TargetTransform.SetLocation( Bezier( Interpolation, ControlPoints ) );
-	auto NextTargetPosition = Bezier( Interpolation + 0.01f, ControlPoints );
+void ABaseTurnFloorPiece::AdvanceTurn( float Distance )
+{
+	// Straights are measured in distance so strafing on them doesn't move the player along the track
+	const auto LeadIn = FMath::Min( Distance, LeadInRemaining );
+	LeadInRemaining -= LeadIn;
+	Distance -= LeadIn;
+
+	// Constant speed at whatever radius the player is turning at
+	const auto Angle = FMath::Min( Distance / TurnRadius, TurnArc.SweepAngle - TurnAngle );
+	TurnAngle += Angle;
+	LeadOutTravelled += Distance - Angle * TurnRadius;
+}
 
-	auto TargetDirection = NextTargetPosition - TargetTransform.GetLocation();
-	TargetDirection.Normalize();
-	TargetTransform.SetRotation( FRotationMatrix::MakeFromX( TargetDirection ).ToQuat() );
+void ABaseTurnFloorPiece::UpdateTargetTransform()
+{
+	const auto Location = TurnArc.GetLocation( TurnAngle, TurnRadius ) - TurnArc.StartTangent * LeadInRemaining + TurnArc.EndTangent * LeadOutTravelled;
+	TargetTransform.SetLocation( Location );
+	TargetTransform.SetRotation( FRotationMatrix::MakeFromX( TurnArc.GetTangent( TurnAngle ) ).ToQuat() );
+}
 
-	return TargetTransform;
+bool ABaseTurnFloorPiece::IsTurnComplete() const
+{
+	return TurnAngle >= TurnArc.SweepAngle && LeadOutTravelled >= TurnArc.LeadOut;
 }
 
 float ABaseTurnFloorPiece::CalculateBezierCurveLengthSimple()
 {
-	// Radius calculation
-	const auto DirectionFromEnd = TurnEndPosition - TurnStartPosition;
-	const auto DistFromStart = FVector::DotProduct( DirectionFromEnd, TurnEndPoint->GetForwardVector() );
-
-	// Circumference = 2 * pi * R
-	return ( 2.0f * PI * DistFromStart ) / 4.0f;
+	// Exact path length at the current turning radius
+	return TurnArc.GetLength( TurnRadius );
 }
\ No newline at end of file
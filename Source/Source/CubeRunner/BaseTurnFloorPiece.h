@@ -6,6 +6,33 @@
 #include "Components/ArrowComponent.h"
 #include "BaseTurnFloorPiece.generated.h"
 
+// Circular arc between the turn start and end points, evaluated in closed form. When one marker is further from
+// the corner than the other the difference is a straight before (LeadIn) or after (LeadOut) the arc
+struct CUBERUNNER_API FTurnArc
+{
+	void Initialise( const FVector& Start, const FVector& StartForward, const FVector& End, const FVector& EndForward );
+
+	// Angle is in radians along the arc, past the end of the arc continues straight along the end direction
+	FVector GetLocation( const float Angle, const float ArcRadius ) const;
+	FVector GetTangent( const float Angle ) const;
+	float GetLength( const float ArcRadius ) const;
+	float GetRadiusAtOffset( const float LateralOffset ) const;
+
+	FVector Centre = FVector::ZeroVector;
+	FVector StartRadial = FVector::ForwardVector;
+	FVector StartTangent = FVector::ForwardVector;
+	FVector EndTangent = FVector::ForwardVector;
+	float Radius = 0.0f;
+	float SweepAngle = 0.0f;
+	float LeadIn = 0.0f;
+	float LeadOut = 0.0f;
+	float TurnSign = 1.0f;
+	float Height = 0.0f;
+
+private:
+	FVector Rotate( const FVector& Direction, const float Angle ) const;
+};
+
 UCLASS()
 class CUBERUNNER_API ABaseTurnFloorPiece : public ABaseFloorPiece
 {
@@ -15,8 +42,10 @@ class CUBERUNNER_API ABaseTurnFloorPiece : public ABaseFloorPiece
 public:
 	ABaseTurnFloorPiece( const FObjectInitializer& ObjectInitializer );
 
+	virtual void ApplyWorldOffset( const FVector& InOffset, bool bWorldShift ) override;
+
 	UFUNCTION( BlueprintCallable, Category = "TurnPiece" )
-	FTransform GetTurnTargetTransform( float Offset = 0.0f );
+	FTransform GetTurnTargetTransform( float DeltaTime, float Offset = 0.0f );
 
 	UFUNCTION( BlueprintCallable, Category = "TurnPiece" )
 	void BeginTurn( FVector Start, float PlayerSpeed );
@@ -30,18 +59,41 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "TurnPiece" )
 	void CalculateCurveData();
 
+	UFUNCTION( BlueprintPure, Category = "TurnPiece" )
+	bool IsTurnComplete() const;
+
+	// FindTurnControlPoints from the baked markers, use this over passing in TurnStartPoint and TurnEndPoint
+	UFUNCTION( BlueprintCallable, Category = "TurnPiece" )
+	TArray< FVector > FindBakedTurnControlPoints();
+
+	FTransform GetTurnStartTransform() const { return TurnStartTransform * GetActorTransform(); }
+	FTransform GetTurnEndTransform() const { return TurnEndTransform * GetActorTransform(); }
+
+protected:
+#if WITH_EDITOR
+	virtual void BakeMarkers() override;
+#endif
+
 	// Members
 public:
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class UBoxComponent* TurnZone;
+	// Editor-only (null in cooked builds), baked into TurnStartTransform and TurnEndTransform
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class UArrowComponent* TurnStartPoint;
 	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class UArrowComponent* TurnEndPoint;
 
+	UPROPERTY( VisibleAnywhere, BlueprintReadOnly, Category = Data ) FTransform TurnStartTransform;
+	UPROPERTY( VisibleAnywhere, BlueprintReadOnly, Category = Data ) FTransform TurnEndTransform;
+
 private:
+	void AdvanceTurn( float Distance );
+	void UpdateTargetTransform();
+
+	FTurnArc TurnArc;
 	FVector TurnStartPosition;
-	FVector TurnEndPosition;
-	FVector TurnCornerPosition;
-	float BezierInterpolation;
-	float InterpSpeed;
+	float TurnAngle;
+	float LeadInRemaining;
+	float LeadOutTravelled;
+	float TurnRadius;
 	float PlayerSpeed;
 	FTransform TargetTransform;
 };
@@ -14,6 +14,13 @@ ABaseUpgrade::ABaseUpgrade( const FObjectInitializer& ObjectInitializer )
 }
 
 void ABaseUpgrade::BeginPlay()
+{
+	RollUpgradeType();
+
+	Super::BeginPlay();
+}
+
+void ABaseUpgrade::RollUpgradeType()
 {
 	TPair< int32, int32 > range( 0, ( int32 )EUpgradeType::EUT_UPGRADE_MAX_TOTAL );
 	const auto* Data = UCubeSingletonDataLibrary::GetGameData();
@@ -28,7 +35,7 @@ void ABaseUpgrade::BeginPlay()
 
 	for ( int32 i = range.Get<0>(); i < range.Get<1>(); ++i )
 	{
-		if( ( int32 )UpgradeType >= Data->UpgradeInformation.Num() )
+		if( i >= Data->UpgradeInformation.Num() )
 		{
 			UpgradeType = static_cast< EUpgradeType >( i );
 			UCubeSingletonDataLibrary::CustomLog( "Upgrade index " + FString::FromInt( i ) + " doesn't have valid UpgradeInformation" );
@@ -45,8 +52,13 @@ void ABaseUpgrade::BeginPlay()
 	}
 
 	UCubeSingletonDataLibrary::CustomLog( "Upgrade spawned: " + FString::FromInt( static_cast< int32 >( UpgradeType ) ) );
+}
 
-	Super::BeginPlay();
+void ABaseUpgrade::SetUpgradeActive( const bool Active )
+{
+	SetActorHiddenInGame( !Active );
+	SetActorEnableCollision( Active );
+	SetActorTickEnabled( Active );
 }
 
 FString ABaseUpgrade::GetUpgradeDisplayName()
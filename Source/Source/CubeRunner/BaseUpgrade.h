@@ -34,6 +34,12 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	FString GetUpgradeDisplayName();
 
+	UFUNCTION( BlueprintCallable, Category = "Utility" )
+	void RollUpgradeType();
+
+	// Hides and disables the upgrade while it is picked up or sitting in the pool
+	void SetUpgradeActive( const bool Active );
+
 	// Members
 public:
 	UPROPERTY( BlueprintReadWrite, EditAnywhere ) EUpgradeType UpgradeType;
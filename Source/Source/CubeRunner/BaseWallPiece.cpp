@@ -23,8 +23,9 @@ ABaseWallPiece::ABaseWallPiece( const FObjectInitializer& ObjectInitializer )
 
 	WallCollision = CreateDefaultSubobject<UBoxComponent>( TEXT( "Spawn Collision" ) );
 	WallCollision->AttachToComponent( Root, FAttachmentTransformRules::KeepRelativeTransform );
-	WallCollision->SetCollisionEnabled( ECollisionEnabled::QueryOnly );
-	WallCollision->SetGenerateOverlapEvents( true );
+	// The floor piece's corridor keeps the player off the wall, so no overlaps are needed
+	WallCollision->SetCollisionEnabled( ECollisionEnabled::NoCollision );
+	WallCollision->SetGenerateOverlapEvents( false );
 }
 
 // Called when the game starts or when spawned
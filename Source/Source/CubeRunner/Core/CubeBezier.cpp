@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeBezier.h"
+
+#include <vector>
+
+namespace
+{
+	// Rows of Pascal's triangle packed back to back, row n starts at n * ( n + 1 ) / 2
+	const int64_t* BinomialRow( const int32_t N )
+	{
+		static const std::vector< int64_t > Table = []()
+		{
+			std::vector< int64_t > Rows;
+			Rows.reserve( ( CubeCore::MaxBinomialN + 1 ) * ( CubeCore::MaxBinomialN + 2 ) / 2 );
+
+			for( int32_t n = 0; n <= CubeCore::MaxBinomialN; ++n )
+			{
+				const auto Previous = Rows.size() - n;
+
+				for( int32_t k = 0; k <= n; ++k )
+					Rows.push_back( k == 0 || k == n ? 1 : Rows[ Previous + k - 1 ] + Rows[ Previous + k ] );
+			}
+
+			return Rows;
+		}();
+
+		return Table.data() + N * ( N + 1 ) / 2;
+	}
+
+	// Only for curves past the binomial table, repeated lerps need no coefficients
+	CubeCore::Vec3 DeCasteljau( const float Interval, const CubeCore::Vec3* ControlPoints, const int32_t Count )
+	{
+		std::vector< CubeCore::Vec3 > Points( ControlPoints, ControlPoints + Count );
+
+		for( int32_t Remaining = Count - 1; Remaining > 0; --Remaining )
+			for( int32_t i = 0; i < Remaining; ++i )
+				Points[ i ] = Points[ i ] * ( 1.0f - Interval ) + Points[ i + 1 ] * Interval;
+
+		return Points[ 0 ];
+	}
+}
+
+namespace CubeCore
+{
+	int64_t Binomial( int32_t N, int32_t K )
+	{
+		if( N < 0 || N > MaxBinomialN || K < 0 || K > N )
+			return 0;
+
+		return BinomialRow( N )[ K ];
+	}
+
+	Vec3 BezierQuadratic( float Interval, const Vec3& Start, const Vec3& Corner, const Vec3& End )
+	{
+		const auto t2 = Interval * Interval;
+		const auto mt = 1.0f - Interval;
+		const auto mt2 = mt * mt;
+		return Start * mt2 + Corner * 2.0f * mt * Interval + End * t2;
+	}
+
+	Vec3 BezierCubic( float Interval, const Vec3& Start, const Vec3& CornerA, const Vec3& CornerB, const Vec3& End )
+	{
+		const auto t2 = Interval * Interval;
+		const auto t3 = t2 * Interval;
+		const auto mt = 1.0f - Interval;
+		const auto mt2 = mt * mt;
+		const auto mt3 = mt2 * mt;
+		return Start * mt3 + 3.0f * CornerA * mt2 * Interval + 3.0f * CornerB * mt * t2 + End * t3;
+	}
+
+	Vec3 Bezier( float Interval, const Vec3* ControlPoints, int32_t Count )
+	{
+		if( Count <= 0 )
+			return Vec3();
+
+		if( Count == 3 )
+			return BezierQuadratic( Interval, ControlPoints[ 0 ], ControlPoints[ 1 ], ControlPoints[ 2 ] );
+
+		if( Count == 4 )
+			return BezierCubic( Interval, ControlPoints[ 0 ], ControlPoints[ 1 ], ControlPoints[ 2 ], ControlPoints[ 3 ] );
+
+		const int32_t n = Count - 1;
+
+		if( n > MaxBinomialN )
+			return DeCasteljau( Interval, ControlPoints, Count );
+
+		// Powers built up incrementally rather than a pow per term
+		float InversePowers[ MaxBinomialN + 1 ];
+		InversePowers[ 0 ] = 1.0f;
+
+		for( int32_t i = 1; i <= n; ++i )
+			InversePowers[ i ] = InversePowers[ i - 1 ] * ( 1.0f - Interval );
+
+		const auto* Row = BinomialRow( n );
+		float Power = 1.0f;
+		Vec3 Result;
+
+		for( int32_t k = 0; k <= n; ++k )
+		{
+			Result += ControlPoints[ k ] * ( float( Row[ k ] ) * InversePowers[ n - k ] * Power );
+			Power *= Interval;
+		}
+
+		return Result;
+	}
+
+	float BezierLength( const Vec3* ControlPoints, int32_t Count, int32_t StepCount )
+	{
+		float Length = 0.0f;
+		float Step = 0.0f;
+		auto Previous = Bezier( Step, ControlPoints, Count );
+
+		for( int32_t i = 0; i < StepCount - 1; ++i )
+		{
+			Step += ( 1.0f / StepCount );
+			const auto Next = Bezier( Step, ControlPoints, Count );
+			Length += CubeCore::Length( Next - Previous );
+			Previous = Next;
+		}
+
+		return Length;
+	}
+}
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+
+#include "CubeCoreTypes.h"
+
+namespace CubeCore
+{
+	// Largest n the binomial table holds, every C( 63, k ) still fits in 64 bits
+	const int32_t MaxBinomialN = 63;
+
+	// n choose k from a table built once on first use, 0 outside the table
+	int64_t Binomial( int32_t N, int32_t K );
+
+	Vec3 BezierQuadratic( float Interval, const Vec3& Start, const Vec3& Corner, const Vec3& End );
+	Vec3 BezierCubic( float Interval, const Vec3& Start, const Vec3& CornerA, const Vec3& CornerB, const Vec3& End );
+
+	// Point on the curve through Count control points, quadratic and cubic curves use the closed forms
+	Vec3 Bezier( float Interval, const Vec3* ControlPoints, int32_t Count );
+
+	// Chord length over StepCount samples, the sampling obstacle spacing on authored pieces was tuned against
+	float BezierLength( const Vec3* ControlPoints, int32_t Count, int32_t StepCount );
+}
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Engine independent types for the CubeCore kernels, nothing in Core may include UE headers
+namespace CubeCore
+{
+	struct Vec3
+	{
+		float X = 0.0f;
+		float Y = 0.0f;
+		float Z = 0.0f;
+
+		Vec3() = default;
+		Vec3( float InX, float InY, float InZ ) : X( InX ), Y( InY ), Z( InZ ) { }
+
+		Vec3& operator+=( const Vec3& Other ) { X += Other.X; Y += Other.Y; Z += Other.Z; return *this; }
+	};
+
+	inline Vec3 operator+( const Vec3& A, const Vec3& B ) { return Vec3( A.X + B.X, A.Y + B.Y, A.Z + B.Z ); }
+	inline Vec3 operator-( const Vec3& A, const Vec3& B ) { return Vec3( A.X - B.X, A.Y - B.Y, A.Z - B.Z ); }
+	inline Vec3 operator*( const Vec3& V, float Scale ) { return Vec3( V.X * Scale, V.Y * Scale, V.Z * Scale ); }
+	inline Vec3 operator*( float Scale, const Vec3& V ) { return V * Scale; }
+	inline bool operator==( const Vec3& A, const Vec3& B ) { return A.X == B.X && A.Y == B.Y && A.Z == B.Z; }
+
+	inline float Dot( const Vec3& A, const Vec3& B ) { return A.X * B.X + A.Y * B.Y + A.Z * B.Z; }
+	inline float Length( const Vec3& V ) { return std::sqrt( Dot( V, V ) ); }
+
+	// Random source the kernels draw from, the game forwards it to FMath so seeded runs stay deterministic
+	class IRandom
+	{
+	public:
+		virtual ~IRandom() = default;
+
+		// Inclusive on both ends, Max < Min returns Min (same contract as FMath::RandRange)
+		virtual int32_t RandRange( int32_t Min, int32_t Max ) = 0;
+
+		// [0, 1)
+		virtual float FRand() = 0;
+	};
+
+	// Seedable xorshift stream for running the kernels outside the engine
+	class RandomStream : public IRandom
+	{
+	public:
+		explicit RandomStream( uint32_t Seed = 0 ) : State( Seed ? Seed : 0x9E3779B9u ) { }
+
+		int32_t RandRange( int32_t Min, int32_t Max ) override
+		{
+			const int32_t Range = Max - Min + 1;
+			return Range > 0 ? Min + std::min( int32_t( FRand() * Range ), Range - 1 ) : Min;
+		}
+
+		float FRand() override
+		{
+			State ^= State << 13;
+			State ^= State >> 17;
+			State ^= State << 5;
+			return float( State >> 8 ) * ( 1.0f / 16777216.0f );
+		}
+
+	private:
+		uint32_t State;
+	};
+}
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeGridPath.h"
+
+#include <unordered_set>
+
+namespace
+{
+	struct GridNode
+	{
+		int32_t Step;
+		int32_t Lateral;
+		int32_t CameFrom;
+	};
+
+	uint64_t GridCellKey( const int32_t Step, const int32_t Lateral )
+	{
+		return ( uint64_t( uint32_t( Step ) ) << 32 ) | uint32_t( Lateral );
+	}
+}
+
+namespace CubeCore
+{
+	bool FindGridPath( const GridPathParams& Params, const std::function< bool( const Vec3& ) >& IsBlocked, IRandom& Random, std::vector< Vec3 >& OutPath )
+	{
+		if( Params.GridSize <= 0.0f || Dot( Params.Forward, Params.Forward ) <= 0.0f )
+			return false;
+
+		const auto StepForward = Params.Forward * Params.GridSize;
+		const auto StepRight = Params.Right * Params.GridSize;
+		const auto CellLocation = [ & ]( const GridNode& Node )
+		{
+			return Params.Start + StepForward * float( Node.Step ) + StepRight * float( Node.Lateral );
+		};
+
+		// Cells are keyed on their grid coordinates, so open and closed lookups don't compare float positions
+		std::vector< GridNode > Nodes{ { 0, 0, -1 } };
+		std::vector< int32_t > OpenList{ 0 };
+		std::unordered_set< uint64_t > Visited{ GridCellKey( 0, 0 ) };
+
+		while( !OpenList.empty() )
+		{
+			// Randomly pick a path (could add weightings to move forward more etc..)
+			const int32_t Pick = Random.RandRange( 0, int32_t( OpenList.size() ) - 1 );
+			const int32_t Current = OpenList[ Pick ];
+
+			// Check if we have pathed far enough
+			if( Dot( CellLocation( Nodes[ Current ] ) - Params.Origin, Params.Forward ) >= Params.MaxDistance )
+			{
+				const auto PathStart = OutPath.size();
+
+				for( int32_t Index = Current; Index != -1; Index = Nodes[ Index ].CameFrom )
+					OutPath.push_back( CellLocation( Nodes[ Index ] ) );
+
+				std::reverse( OutPath.begin() + PathStart, OutPath.end() );
+				return true;
+			}
+
+			OpenList[ Pick ] = OpenList.back();
+			OpenList.pop_back();
+
+			for( const int32_t Lateral : { 0, 1, -1 } )
+			{
+				const GridNode Neighbour{ Nodes[ Current ].Step + 1, Nodes[ Current ].Lateral + Lateral, Current };
+
+				// Blocked cells are only traced once too, they can't become free within a search
+				if( !Visited.insert( GridCellKey( Neighbour.Step, Neighbour.Lateral ) ).second )
+					continue;
+
+				if( IsBlocked && IsBlocked( CellLocation( Neighbour ) ) )
+					continue;
+
+				Nodes.push_back( Neighbour );
+				OpenList.push_back( int32_t( Nodes.size() ) - 1 );
+			}
+		}
+
+		return false;
+	}
+}
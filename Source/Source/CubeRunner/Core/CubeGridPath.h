@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+
+#include "CubeCoreTypes.h"
+
+#include <functional>
+#include <vector>
+
+namespace CubeCore
+{
+	struct GridPathParams
+	{
+		Vec3 Start;		// Where the path continues from
+		Vec3 Origin;	// Position of the pathing pawn, distance ahead is measured from here
+		Vec3 Forward;
+		Vec3 Right;
+		float GridSize = 50.0f;
+		float MaxDistance = 500.0f;
+	};
+
+	// Random search over a grid that steps forward, forward left or forward right each cell, skipping cells IsBlocked
+	// rejects, until one is MaxDistance ahead of Origin. Appends that path (Start included) to OutPath, false if boxed in
+	bool FindGridPath( const GridPathParams& Params, const std::function< bool( const Vec3& ) >& IsBlocked, IRandom& Random, std::vector< Vec3 >& OutPath );
+}
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubePieceSelection.h"
+
+namespace CubeCore
+{
+	bool ShouldQueueRandomisedRun( int32_t RepeatCount, int32_t PrivateLengthRemaining, IRandom& Random )
+	{
+		return ( ( RepeatCount <= 0 ) ||
+			( RepeatCount == 1 && Random.RandRange( 0, 1 ) == 0 ) ||
+			( RepeatCount == 2 && Random.RandRange( 0, 9 ) == 0 ) )
+			&& PrivateLengthRemaining == 0;
+	}
+
+	int32_t RandomisedRunLength( float GameProgress, IRandom& Random )
+	{
+		return Random.RandRange( 1, int32_t( GameProgress / 2 ) );
+	}
+
+	PieceSelection SelectPieceByDifficulty( const PieceCandidate* Candidates, int32_t Count, float GameProgress, IRandom& Random, int32_t MaxAttempts /*= 20*/ )
+	{
+		if( Count <= 0 )
+			return { PieceSelectionResult::NotFound, -1 };
+
+		const int32_t Min = Candidates[ 0 ].Difficulty;
+		const int32_t Max = Candidates[ Count - 1 ].Difficulty;
+		const int32_t Range = Max - Min;
+
+		for( int32_t Attempt = 0; Attempt < MaxAttempts; ++Attempt )
+		{
+			// Linear distribution from min -> min + progress, capped at max
+			const int32_t DifficultyVal = Range ? Min + Random.RandRange( 0, std::min( int32_t( GameProgress ), Range ) - 1 ) : Min;
+
+			float Roll = Random.FRand();
+			int32_t Matches = 0;
+			int32_t MatchIndex = 0;
+
+			// Weighted random selection from pieces that match the selected difficulty
+			for( int32_t i = 0; i < Count; ++i )
+			{
+				if( Candidates[ i ].Difficulty != DifficultyVal )
+					continue;
+
+				Matches++;
+				MatchIndex = i;
+
+				if( Roll < Candidates[ i ].Probability )
+					return { PieceSelectionResult::Selected, i };
+
+				Roll -= Candidates[ i ].Probability;
+			}
+
+			if( Matches > 0 )
+				return { PieceSelectionResult::Fallback, MatchIndex };
+
+			// No matches of this difficulty, try again
+		}
+
+		return { PieceSelectionResult::NotFound, -1 };
+	}
+}
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+
+#include "CubeCoreTypes.h"
+
+namespace CubeCore
+{
+	struct PieceCandidate
+	{
+		int32_t Difficulty;
+		float Probability;
+	};
+
+	enum class PieceSelectionResult
+	{
+		Selected,	// Won the weighted roll at the chosen difficulty
+		Fallback,	// Difficulty matched but the probabilities didn't add up to 1, Index is the last match
+		NotFound,	// No candidate at any of the difficulties rolled
+	};
+
+	struct PieceSelection
+	{
+		PieceSelectionResult Result;
+		int32_t Index;
+	};
+
+	// Randomised cube fields fill the gaps between authored pieces, less likely the more ran back to back
+	bool ShouldQueueRandomisedRun( int32_t RepeatCount, int32_t PrivateLengthRemaining, IRandom& Random );
+
+	// Number of randomised pieces in a run, grows with progress
+	int32_t RandomisedRunLength( float GameProgress, IRandom& Random );
+
+	// Rolls a difficulty between the easiest candidate and GameProgress above it, then a weighted pick among the
+	// candidates of exactly that difficulty. Candidates must be sorted by difficulty
+	PieceSelection SelectPieceByDifficulty( const PieceCandidate* Candidates, int32_t Count, float GameProgress, IRandom& Random, int32_t MaxAttempts = 20 );
+}
@@ -0,0 +1,178 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+
+#include "CubeCoreTypes.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace CubeCore
+{
+	// Pieces waiting to be spawned. Split pieces branch the queue, one branch per extra connection, and the front
+	// only moves down a branch once the pawn takes it. PayloadType carries whatever the game needs per item
+	template< typename PayloadType >
+	class SpawnQueue
+	{
+	public:
+		struct Item : PayloadType
+		{
+			int32_t QueueIndex = 0;
+			std::vector< Item* > NextQueueItems;
+		};
+
+		SpawnQueue() = default;
+		SpawnQueue( const SpawnQueue& ) = delete;
+		SpawnQueue& operator=( const SpawnQueue& ) = delete;
+		~SpawnQueue() { Reset(); }
+
+		Item* Root() const { return RootItem; }
+
+		// Queues a new item after the last one (or on the branch of the open split)
+		Item* Append()
+		{
+			auto* NewItem = new Item();
+
+			if( !RootItem )
+				RootItem = NewItem;
+			else
+				( Current ? Current : Tail() )->NextQueueItems.push_back( NewItem );
+
+			Current = NewItem;
+			return NewItem;
+		}
+
+		// Queues a split piece, items appended after it fill its current branch until EndSplit
+		Item* AppendSplit()
+		{
+			auto* NewItem = Append();
+			Splits.push_back( NewItem );
+			return NewItem;
+		}
+
+		// Returns to the innermost split for its next branch, closing it once QueueIndex reaches Connections - 1
+		void EndSplit( int32_t Connections )
+		{
+			if( Splits.empty() )
+				return;
+
+			auto* Split = Splits.back();
+			Split->QueueIndex++;
+			Current = Split;
+
+			if( Split->QueueIndex >= Connections - 1 )
+				Splits.pop_back();
+		}
+
+		// Drops the front once it has been spawned, it must not be a split
+		void PopFront()
+		{
+			auto* Front = RootItem;
+
+			if( !Front )
+				return;
+
+			RootItem = Front->NextQueueItems.empty() ? nullptr : Front->NextQueueItems[ 0 ];
+			Forget( Front );
+			delete Front;
+		}
+
+		// Moves the front down the branch the pawn took at a split and frees the others
+		void SelectBranch( int32_t Index )
+		{
+			auto* Front = RootItem;
+
+			if( !Front )
+				return;
+
+			RootItem = ( Index >= 0 && Index < int32_t( Front->NextQueueItems.size() ) ) ? Front->NextQueueItems[ Index ] : nullptr;
+
+			for( auto* Branch : Front->NextQueueItems )
+				if( Branch != RootItem )
+					DeleteTree( Branch );
+
+			Forget( Front );
+			delete Front;
+		}
+
+		// Next append goes after the last item rather than where the previous one went
+		void ClearCursor()
+		{
+			Current = nullptr;
+		}
+
+		void Reset()
+		{
+			DeleteTree( RootItem );
+			RootItem = nullptr;
+			Current = nullptr;
+			Splits.clear();
+		}
+
+		int32_t Num() const
+		{
+			int32_t Count = 0;
+			std::vector< const Item* > Pending;
+
+			if( RootItem )
+				Pending.push_back( RootItem );
+
+			while( !Pending.empty() )
+			{
+				const auto* Next = Pending.back();
+				Pending.pop_back();
+				Count++;
+
+				for( const auto* Child : Next->NextQueueItems )
+					if( Child )
+						Pending.push_back( Child );
+			}
+
+			return Count;
+		}
+
+	private:
+		Item* Tail() const
+		{
+			auto* Last = RootItem;
+
+			while( Last && !Last->NextQueueItems.empty() )
+				Last = Last->NextQueueItems.back();
+
+			return Last;
+		}
+
+		// Keeps the cursor and open splits off freed items
+		void Forget( const Item* Removed )
+		{
+			if( Current == Removed )
+				Current = nullptr;
+
+			Splits.erase( std::remove( Splits.begin(), Splits.end(), Removed ), Splits.end() );
+		}
+
+		void DeleteTree( Item* Top )
+		{
+			std::vector< Item* > Pending;
+
+			if( Top )
+				Pending.push_back( Top );
+
+			while( !Pending.empty() )
+			{
+				auto* Next = Pending.back();
+				Pending.pop_back();
+
+				for( auto* Child : Next->NextQueueItems )
+					if( Child )
+						Pending.push_back( Child );
+
+				Forget( Next );
+				delete Next;
+			}
+		}
+
+		Item* RootItem = nullptr;
+		Item* Current = nullptr;
+		std::vector< Item* > Splits;
+	};
+}
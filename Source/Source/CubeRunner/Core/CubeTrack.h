@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+
+#include "CubeCoreTypes.h"
+
+namespace CubeCore
+{
+	// Whether Location is on or past the plane through Point facing Normal, Normal must be unit length
+	inline bool HasPassedPlane( const Vec3& Location, const Vec3& Point, const Vec3& Normal )
+	{
+		return Dot( Location - Point, Normal ) >= 0.0f;
+	}
+
+	// 0 at Entry and 1 at Exit along the chord between them, 1 when they are the same point
+	inline float TrackProgress( const Vec3& Location, const Vec3& Entry, const Vec3& Exit )
+	{
+		const auto Chord = Exit - Entry;
+		const auto LengthSquared = Dot( Chord, Chord );
+		return LengthSquared > 1.e-4f ? Dot( Location - Entry, Chord ) / LengthSquared : 1.0f;
+	}
+}
@@ -7,6 +7,9 @@
 #include "CubeSaveGame.h"
 #include "CubeRunnerGameMode.h"
 #include "CubeSingletonDataLibrary.h"
+#include "BaseFloorPiece.h"
+#include "EngineUtils.h"
+#include "Components/InstancedStaticMeshComponent.h"
 
 void UCubeCheatManager::SetSpeed( int32 Speed )
 {
@@ -59,3 +62,235 @@ void UCubeCheatManager::UncompleteLevels()
 
 	Cast< ACubeRunnerGameMode >( UGameplayStatics::GetGameMode( GetWorld() ) )->ForceLevelUIReload();
 }
+
+void UCubeCheatManager::SpawnPieces( int32 Count )
+{
+	auto* GameMode = GetCubeGameMode();
+
+	if( !GameMode || !GameMode->FloorPieceArray.Num() )
+		return;
+
+	int32 Spawned = 0;
+
+	for( ; Spawned < Count; ++Spawned )
+	{
+		// Pieces past a split are only spawned once the pawn picks a side
+		const auto* LastPiece = GameMode->FloorPieceArray.Last();
+
+		if( !IsValid( LastPiece ) || LastPiece->MultiConnections.Num() )
+			break;
+
+		GameMode->SpawnFloorPiece( LastPiece->GetConnectionTransform() );
+	}
+
+	// Counted as pre spawned so the next triggers use them up instead of spawning more on top
+	GameMode->PreSpawnedPieces = FMath::Max( GameMode->PreSpawnedPieces, 0 ) + Spawned;
+
+	CheatMessage( FString::Printf( TEXT( "Spawned %d pieces, %d live" ), Spawned, GameMode->FloorPieceArray.Num() ) );
+}
+
+void UCubeCheatManager::ForcePieceClass( const FString& ClassName )
+{
+	auto* GameMode = GetCubeGameMode();
+
+	if( !GameMode )
+		return;
+
+	if( ClassName.IsEmpty() || ClassName == TEXT( "None" ) )
+	{
+		GameMode->FloorPieceOverride = nullptr;
+		CheatMessage( "Piece class no longer forced" );
+		return;
+	}
+
+	TArray< UClass* > PieceClasses;
+
+	for( const auto& PieceType : GameMode->FloorPieceBPClasses )
+		PieceClasses.Add( PieceType.FloorPieceBPClass );
+
+	PieceClasses.Add( UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass );
+
+	for( auto* Class : PieceClasses )
+	{
+		if( Class && Class->GetName().Contains( ClassName ) )
+		{
+			GameMode->FloorPieceOverride = Class;
+			CheatMessage( "Forcing piece class " + Class->GetName() );
+			return;
+		}
+	}
+
+	CheatMessage( "No registered piece class matches " + ClassName );
+}
+
+void UCubeCheatManager::ForcePieceVariation( int32 Variation )
+{
+	if( auto* GameMode = GetCubeGameMode() )
+	{
+		GameMode->FloorPieceVariationOverride = Variation < 0 ? INDEX_NONE : Variation;
+		CheatMessage( Variation < 0 ? FString( "Piece variation no longer forced" ) : "Forcing piece variation " + FString::FromInt( Variation ) );
+	}
+}
+
+void UCubeCheatManager::SetObstacleDensity( int32 Density )
+{
+	if( auto* GameMode = GetCubeGameMode() )
+	{
+		GameMode->LevelRandomisedFloorPieceDensity = FMath::Max( Density, 0 );
+		CheatMessage( "Randomised obstacle density " + FString::FromInt( GameMode->LevelRandomisedFloorPieceDensity ) );
+	}
+}
+
+void UCubeCheatManager::ToggleInstancedObstacles()
+{
+	const bool Enabled = !ABaseFloorPiece::IsInstancedObstacleSpawningEnabled();
+	ABaseFloorPiece::SetInstancedObstacleSpawningEnabled( Enabled );
+
+	// Pooled pieces still carry obstacles of the old kind
+	if( auto* GameMode = GetCubeGameMode() )
+		GameMode->FlushFloorPiecePool();
+
+	CheatMessage( Enabled ? "Instanced obstacles on" : "Instanced obstacles off, new pieces use components" );
+}
+
+void UCubeCheatManager::DumpCounts()
+{
+	int32 Actors = 0;
+	int32 FloorPieces = 0;
+	int32 Components = 0;
+	int32 Primitives = 0;
+	int32 InstancedComponents = 0;
+	int32 Instances = 0;
+
+	for( TActorIterator< AActor > It( GetWorld() ); It; ++It )
+	{
+		Actors++;
+
+		if( It->IsA< ABaseFloorPiece >() )
+			FloorPieces++;
+
+		for( const auto* Component : It->GetComponents() )
+		{
+			if( !Component )
+				continue;
+
+			Components++;
+
+			if( const auto* Instanced = Cast< UInstancedStaticMeshComponent >( Component ) )
+			{
+				InstancedComponents++;
+				Instances += Instanced->GetInstanceCount();
+			}
+			else if( Component->IsA< UPrimitiveComponent >() )
+			{
+				Primitives++;
+			}
+		}
+	}
+
+	CheatMessage( FString::Printf( TEXT( "Actors: %d (%d floor pieces)" ), Actors, FloorPieces ) );
+	CheatMessage( FString::Printf( TEXT( "Components: %d (%d primitives, %d instanced with %d instances)" ), Components, Primitives, InstancedComponents, Instances ) );
+
+	if( const auto* GameMode = GetCubeGameMode() )
+		CheatMessage( FString::Printf( TEXT( "Track: %d live pieces, %d pooled, %d queued" ), GameMode->FloorPieceArray.Num(), GameMode->GetPooledFloorPieceCount(), GameMode->SpawnQueue.Num() ) );
+}
+
+void UCubeCheatManager::StartStatCapture( float Seconds /*= 10.0f*/ )
+{
+	if( StatCaptureRunning )
+		StopStatCapture();
+
+	GetOuterAPlayerController()->ConsoleCommand( TEXT( "stat startfile" ) );
+	StatCaptureRunning = true;
+
+	if( Seconds > 0.0f )
+		GetWorld()->GetTimerManager().SetTimer( StatCaptureHandle, this, &UCubeCheatManager::StopStatCapture, Seconds );
+
+	CheatMessage( Seconds > 0.0f ? FString::Printf( TEXT( "Capturing stats for %.1fs" ), Seconds ) : FString( "Capturing stats until StopStatCapture" ) );
+}
+
+void UCubeCheatManager::StopStatCapture()
+{
+	if( !StatCaptureRunning )
+		return;
+
+	GetWorld()->GetTimerManager().ClearTimer( StatCaptureHandle );
+	GetOuterAPlayerController()->ConsoleCommand( TEXT( "stat stopfile" ) );
+	StatCaptureRunning = false;
+
+	CheatMessage( "Stat capture written to Saved/Profiling/UnrealStats" );
+}
+
+void UCubeCheatManager::BenchmarkPieceSpawns( int32 SpawnsPerVariation /*= 10*/ )
+{
+	auto* GameMode = GetCubeGameMode();
+
+	if( !GameMode || SpawnsPerVariation <= 0 )
+		return;
+
+	TSet< UClass* > PieceClasses;
+	GameMode->GatherLevelPieceClasses( PieceClasses );
+
+	// Far below the track so the pawn never touches them
+	const FTransform Transform( FVector( 0.0f, 0.0f, -100000.0f ) );
+
+	// Randomised pieces draw layout seeds, the run has to carry on with the seeds a replay of it would see
+	const auto LayoutSeedCount = GameMode->ObstacleLayoutSeedCount;
+	CheatMessage( "Piece spawns: class / variation, components registered of those in the construction script, ms per spawn" );
+
+	for( auto* Class : PieceClasses )
+	{
+		const auto* Defaults = Cast< ABaseFloorPiece >( Class->GetDefaultObject() );
+
+		if( !Defaults )
+			continue;
+
+		const auto TemplateComponents = ABaseFloorPiece::GetTemplateComponentCount( Class );
+		const auto MaxVariation = FMath::Max( Defaults->MaxVariationClassic, Defaults->MaxVariationAdvanced );
+
+		for( int32 Variation = 0; Variation <= MaxVariation; ++Variation )
+		{
+			int32 Spawned = 0;
+			int32 Registered = 0;
+			double Seconds = 0.0;
+
+			for( ; Spawned < SpawnsPerVariation; ++Spawned )
+			{
+				const auto StartTime = FPlatformTime::Seconds();
+				auto* Piece = Cast< ABaseFloorPiece >( UGameplayStatics::BeginDeferredActorSpawnFromClass( GameMode, Class, Transform, ESpawnActorCollisionHandlingMethod::AlwaysSpawn ) );
+
+				if( !Piece )
+					break;
+
+				Piece->Variation = Variation;
+				UGameplayStatics::FinishSpawningActor( Piece, Transform );
+				Seconds += FPlatformTime::Seconds() - StartTime;
+
+				for( const auto* Component : Piece->GetComponents() )
+					if( Component && Component->IsRegistered() )
+						Registered++;
+
+				Piece->Destroy();
+			}
+
+			if( Spawned )
+				CheatMessage( FString::Printf( TEXT( "  %s / %d: %.1f of %d, %.3fms" ), *Class->GetName(), Variation, float( Registered ) / Spawned, TemplateComponents, Seconds * 1000.0 / Spawned ) );
+		}
+	}
+
+	GameMode->ObstacleLayoutSeedCount = LayoutSeedCount;
+}
+
+ACubeRunnerGameMode* UCubeCheatManager::GetCubeGameMode() const
+{
+	return Cast< ACubeRunnerGameMode >( UGameplayStatics::GetGameMode( GetWorld() ) );
+}
+
+void UCubeCheatManager::CheatMessage( const FString& Message ) const
+{
+	// Cheats are mostly run on device, so the result goes to the console and not just the debug log
+	if( auto* PlayerController = GetOuterAPlayerController() )
+		PlayerController->ClientMessage( Message );
+
+	UCubeSingletonDataLibrary::CustomLog( Message, LogDisplayType::Gameplay );
+}
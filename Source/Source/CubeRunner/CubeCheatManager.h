@@ -5,6 +5,8 @@
 #include "GameFramework/CheatManager.h"
 #include "CubeCheatManager.generated.h"
 
+class ACubeRunnerGameMode;
+
 UCLASS()
 class CUBERUNNER_API UCubeCheatManager : public UCheatManager
 {
@@ -28,4 +30,47 @@ public:
 
 	UFUNCTION( exec )
 	void UncompleteLevels();
+
+	// Spawns pieces onto the end of the track straight away, stops at a split
+	UFUNCTION( exec )
+	void SpawnPieces( int32 Count );
+
+	// Every piece spawned is this class (name or part of one), None goes back to the queue
+	UFUNCTION( exec )
+	void ForcePieceClass( const FString& ClassName );
+
+	// Every non transition piece spawned uses this variation, -1 goes back to the queue
+	UFUNCTION( exec )
+	void ForcePieceVariation( int32 Variation );
+
+	// Obstacle density of randomised pieces queued from now
+	UFUNCTION( exec )
+	void SetObstacleDensity( int32 Density );
+
+	// Switches new pieces between instanced and component obstacles
+	UFUNCTION( exec )
+	void ToggleInstancedObstacles();
+
+	// Live actor, component and obstacle instance counts
+	UFUNCTION( exec )
+	void DumpCounts();
+
+	// Records a stats file (stat startfile), stopped after Seconds or by StopStatCapture if Seconds is 0
+	UFUNCTION( exec )
+	void StartStatCapture( float Seconds = 10.0f );
+
+	UFUNCTION( exec )
+	void StopStatCapture();
+
+	// Spawns every level piece class in each of its variations away from the track and reports the components
+	// left registered against those in its construction script, along with the spawn time
+	UFUNCTION( exec )
+	void BenchmarkPieceSpawns( int32 SpawnsPerVariation = 10 );
+
+private:
+	ACubeRunnerGameMode* GetCubeGameMode() const;
+	void CheatMessage( const FString& Message ) const;
+
+	FTimerHandle StatCaptureHandle;
+	bool StatCaptureRunning = false;
 };
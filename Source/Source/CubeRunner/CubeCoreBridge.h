@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/CubeCoreTypes.h"
+
+// Glue between engine types and the engine independent kernels in Core/
+static_assert( sizeof( FVector ) == sizeof( CubeCore::Vec3 ), "FVector and CubeCore::Vec3 must share a layout" );
+static_assert( alignof( FVector ) == alignof( CubeCore::Vec3 ), "FVector and CubeCore::Vec3 must share a layout" );
+static_assert( STRUCT_OFFSET( FVector, X ) == STRUCT_OFFSET( CubeCore::Vec3, X ) &&
+	STRUCT_OFFSET( FVector, Y ) == STRUCT_OFFSET( CubeCore::Vec3, Y ) &&
+	STRUCT_OFFSET( FVector, Z ) == STRUCT_OFFSET( CubeCore::Vec3, Z ), "FVector and CubeCore::Vec3 must share a layout" );
+static_assert( std::is_same< decltype( FVector::X ), decltype( CubeCore::Vec3::X ) >::value, "FVector and CubeCore::Vec3 must share a layout" );
+
+inline CubeCore::Vec3 ToCore( const FVector& Vector )
+{
+	return CubeCore::Vec3( Vector.X, Vector.Y, Vector.Z );
+}
+
+inline FVector ToEngine( const CubeCore::Vec3& Vector )
+{
+	return FVector( Vector.X, Vector.Y, Vector.Z );
+}
+
+// Both are three packed floats, so control point arrays are passed through without a copy
+inline const CubeCore::Vec3* ToCore( const FVector* Vectors )
+{
+	return reinterpret_cast< const CubeCore::Vec3* >( Vectors );
+}
+
+// Draws from the global FMath stream so seeded runs and replays stay deterministic
+class FCubeCoreRandom : public CubeCore::IRandom
+{
+public:
+	int32_t RandRange( int32_t Min, int32_t Max ) override { return FMath::RandRange( Min, Max ); }
+	float FRand() override { return FMath::FRand(); }
+};
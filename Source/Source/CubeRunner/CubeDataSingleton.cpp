@@ -4,6 +4,21 @@
 #include "CubeRunner.h"
 #include "BaseUpgrade.h"
 #include "CubeSingletonDataLibrary.h"
+#include "CubeMemory.h"
+
+#include "AssetRegistryModule.h"
+
+#if WITH_EDITOR
+namespace
+{
+	FAutoConsoleCommand SaveLevelManifestsCommand( TEXT( "cr.SaveLevelManifests" ), TEXT( "Write the level preload manifests that changed during play into the game data asset" ),
+		FConsoleCommandDelegate::CreateLambda( []()
+		{
+			if( auto* DataSingleton = UCubeSingletonDataLibrary::GetSingletonGameData() )
+				DataSingleton->SaveLevelManifests();
+		} ) );
+}
+#endif
 
 UCubeDataSingleton::UCubeDataSingleton( const FObjectInitializer& ObjectInitializer )
 	: Super( ObjectInitializer )
@@ -25,49 +40,359 @@ void UCubeDataSingleton::CorrectUpgradeSpawnOdds()
 
 void UCubeDataSingleton::PreloadGameObjects()
 {
-	UCubeSingletonDataLibrary::CustomLog( "Requesting preloading for " + FString::FromInt( GameData->AssetsToLoad.Num() ) + " assets", LogDisplayType::Gameplay );
+	CUBE_LLM_SCOPE( Preload );
+
+	if( PreloadHandle.IsValid() && PreloadHandle->IsLoadingInProgress() )
+		return;
+
+	TArray< FSoftObjectPath > AssetsToLoad;
+
+	for( auto& Asset : GameData->AssetsToLoad )
+		AssetsToLoad.AddUnique( Asset );
+
+	// With piece residency the folders are streamed per level instead of being pinned up front
+	if( !GameData->EnablePieceResidency )
+		GatherFolderAssets( AssetsToLoad );
+
+	UCubeSingletonDataLibrary::CustomLog( "Requesting preloading for " + FString::FromInt( AssetsToLoad.Num() ) + " assets", LogDisplayType::Gameplay );
 
-	for ( auto& asset : GameData->AssetsToLoad )
+	HaveAsyncObjectsFinishedLoading = false;
+
+	if( !AssetsToLoad.Num() )
 	{
-		auto* object = AssetLoader.LoadSynchronous( asset, true );
-		LoadedObjectHandles.Add( object );
+		OnPreloadingFinished();
+		return;
 	}
 
+	PreloadHandle = AssetLoader.RequestAsyncLoad( AssetsToLoad, FStreamableDelegate::CreateUObject( this, &UCubeDataSingleton::OnPreloadingFinished ), FStreamableManager::DefaultAsyncLoadPriority, true );
+}
+
+void UCubeDataSingleton::PreloadLevel( const bool ClassicMode, const int32 Level )
+{
+	CUBE_LLM_SCOPE( Preload );
+
+	const FIntPoint Key( ClassicMode ? 1 : 0, Level );
+
+	if( LevelPreloadKey == Key && LevelPreloadHandle.IsValid() )
+		return;
+
+	// The previous level's manifest is still covered by the general preload set
+	if( LevelPreloadHandle.IsValid() )
+		LevelPreloadHandle->ReleaseHandle();
+
+	LevelPreloadHandle.Reset();
+	LevelPreloadKey = Key;
+	HaveLevelObjectsFinishedLoading = false;
+
+	const auto* Manifest = FindLevelManifest( ClassicMode, Level );
+
+	if( !Manifest || !Manifest->Num() )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "No preload manifest for level " + FString::FromInt( Level ), LogDisplayType::Warn );
+		OnLevelPreloadingFinished();
+		return;
+	}
+
+	UCubeSingletonDataLibrary::CustomLog( "Requesting level preloading for " + FString::FromInt( Manifest->Num() ) + " assets", LogDisplayType::Gameplay );
+	LevelPreloadHandle = AssetLoader.RequestAsyncLoad( *Manifest, FStreamableDelegate::CreateUObject( this, &UCubeDataSingleton::OnLevelPreloadingFinished ), FStreamableManager::AsyncLoadHighPriority, true );
+}
+
+void UCubeDataSingleton::CancelPreloading()
+{
+	if( PreloadHandle.IsValid() && PreloadHandle->IsLoadingInProgress() )
+	{
+		PreloadHandle->CancelHandle();
+		PreloadHandle.Reset();
+		UCubeSingletonDataLibrary::CustomLog( "Preloading cancelled", LogDisplayType::Gameplay );
+	}
+
+	if( LevelPreloadHandle.IsValid() && LevelPreloadHandle->IsLoadingInProgress() )
+	{
+		LevelPreloadHandle->CancelHandle();
+		LevelPreloadHandle.Reset();
+		LevelPreloadKey = FIntPoint( INDEX_NONE, INDEX_NONE );
+	}
+}
+
+bool UCubeDataSingleton::IsPreloadingFinished()
+{
+	return HaveAsyncObjectsFinishedLoading;
+}
+
+bool UCubeDataSingleton::IsLevelPreloadingFinished()
+{
+	return HaveLevelObjectsFinishedLoading;
+}
+
+float UCubeDataSingleton::GetPreloadingProgress() const
+{
+	if( HaveAsyncObjectsFinishedLoading )
+		return 1.0f;
+
+	return PreloadHandle.IsValid() ? PreloadHandle->GetProgress() : 0.0f;
+}
+
+float UCubeDataSingleton::GetLevelPreloadingProgress() const
+{
+	if( HaveLevelObjectsFinishedLoading )
+		return 1.0f;
+
+	return LevelPreloadHandle.IsValid() ? LevelPreloadHandle->GetProgress() : 0.0f;
+}
+
+TArray< FSoftObjectPath >* UCubeDataSingleton::FindLevelManifest( const bool ClassicMode, const int32 Level ) const
+{
+	if( !GameData )
+		return nullptr;
+
+	if( Level == -1 )
+		return &GameData->EndlessPreloadManifest;
+
+	auto& Levels = ClassicMode ? GameData->ClassicLevelInformation : GameData->AdvancedLevelInformation;
+	return Levels.IsValidIndex( Level ) ? &Levels[ Level ].PreloadManifest : nullptr;
+}
+
+void UCubeDataSingleton::GatherFolderAssets( TArray< FSoftObjectPath >& OutAssets )
+{
 	if( !ObjectLibrary )
 	{
 		ObjectLibrary = UObjectLibrary::CreateLibrary( UObject::StaticClass(), true, GIsEditor );
 		ObjectLibrary->AddToRoot();
 	}
-	
-	//const auto Count = ObjectLibrary->LoadAssetsFromPaths( FoldersToLoad );
-	//UCubeSingletonDataLibrary::CustomLog( "Preloaded " + FString::FromInt( Count ) + " assets", LogDisplayType::Gameplay );
 
+	// Asset data only, the actual loads go through the streamable manager
 	for( auto Folder : GameData->FoldersToLoad )
 	{
 		const auto Count = ObjectLibrary->LoadAssetDataFromPath( Folder );
 		UCubeSingletonDataLibrary::CustomLog( "Requesting preloading asset data from path \"" + Folder + "\": " + FString::FromInt( Count ) + " assets", LogDisplayType::Gameplay );
+	}
 
-		TArray<FAssetData> AssetDatas;
-		ObjectLibrary->GetAssetDataList( AssetDatas );
+	TArray< FAssetData > AssetDatas;
+	ObjectLibrary->GetAssetDataList( AssetDatas );
 
-		UObject* Asset;
+	for( auto& AssetData : AssetDatas )
+		OutAssets.AddUnique( AssetData.ToSoftObjectPath() );
+}
 
-		for( int32 i = 0; i < AssetDatas.Num(); ++i )
+void UCubeDataSingleton::OnPreloadingFinished()
+{
+	CUBE_LLM_SCOPE( Preload );
+
+	if( PreloadHandle.IsValid() )
+	{
+		TArray< UObject* > LoadedAssets;
+		PreloadHandle->GetLoadedAssets( LoadedAssets );
+
+		for( auto* Asset : LoadedAssets )
+			LoadedObjectHandles.AddUnique( Asset );
+	}
+
+	HaveAsyncObjectsFinishedLoading = true;
+	UCubeSingletonDataLibrary::CustomLog( "Preloaded " + FString::FromInt( LoadedObjectHandles.Num() ) + " assets", LogDisplayType::Gameplay );
+	OnPreloadFinished.Broadcast();
+}
+
+void UCubeDataSingleton::OnLevelPreloadingFinished()
+{
+	CUBE_LLM_SCOPE( Preload );
+
+	HaveLevelObjectsFinishedLoading = true;
+	UCubeSingletonDataLibrary::CustomLog( "Level preloading finished", LogDisplayType::Gameplay );
+	OnLevelPreloadFinished.Broadcast();
+}
+
+#if WITH_EDITOR
+void UCubeDataSingleton::GenerateLevelManifest( const bool ClassicMode, const int32 Level, const TSet< UClass* >& PieceClasses )
+{
+	auto* Manifest = FindLevelManifest( ClassicMode, Level );
+
+	if( !Manifest )
+		return;
+
+	TArray< FSoftObjectPath > NewManifest;
+	GatherClassDependencies( PieceClasses, NewManifest );
+
+	NewManifest.Sort( []( const FSoftObjectPath& A, const FSoftObjectPath& B )
+	{
+		return A.ToString() < B.ToString();
+	} );
+
+	const FIntPoint Key( ClassicMode ? 1 : 0, Level );
+
+	if( NewManifest == *Manifest )
+	{
+		PendingLevelManifests.Remove( Key );
+		return;
+	}
+
+	UCubeSingletonDataLibrary::CustomLog( "Preload manifest for level " + FString::FromInt( Level ) + " is out of date (" + FString::FromInt( NewManifest.Num() ) + " assets), run cr.SaveLevelManifests to update it", LogDisplayType::Warn );
+	PendingLevelManifests.Add( Key, MoveTemp( NewManifest ) );
+}
+
+int32 UCubeDataSingleton::SaveLevelManifests()
+{
+	int32 Saved = 0;
+
+	for( auto& Pair : PendingLevelManifests )
+	{
+		if( auto* Manifest = FindLevelManifest( Pair.Key.X != 0, Pair.Key.Y ) )
 		{
-			FAssetData& AssetData = AssetDatas[i];
-			Asset = AssetData.GetAsset();
-			if( Asset )
+			*Manifest = MoveTemp( Pair.Value );
+			++Saved;
+		}
+	}
+
+	PendingLevelManifests.Empty();
+
+	if( Saved )
+		GameData->MarkPackageDirty();
+
+	UCubeSingletonDataLibrary::CustomLog( FString::FromInt( Saved ) + " level preload manifests updated, save the game data asset to keep them", LogDisplayType::Gameplay );
+	return Saved;
+}
+#endif
+
+void UCubeDataSingleton::GatherClassDependencies( const TSet< UClass* >& Classes, TArray< FSoftObjectPath >& OutAssets ) const
+{
+	auto& AssetRegistry = FModuleManager::LoadModuleChecked< FAssetRegistryModule >( "AssetRegistry" ).Get();
+
+	// Walk the hard package dependencies of every class, game content only
+	TSet< FName > Packages;
+	TArray< FName > PendingPackages;
+
+	for( auto* Class : Classes )
+		if( Class )
+			PendingPackages.Add( Class->GetOutermost()->GetFName() );
+
+	while( PendingPackages.Num() )
+	{
+		const auto PackageName = PendingPackages.Pop( false );
+
+		if( Packages.Contains( PackageName ) || !PackageName.ToString().StartsWith( TEXT( "/Game/" ) ) )
+			continue;
+
+		Packages.Add( PackageName );
+
+		TArray< FName > Dependencies;
+		AssetRegistry.GetDependencies( PackageName, Dependencies, UE::AssetRegistry::EDependencyCategory::Package, UE::AssetRegistry::EDependencyQuery::Hard );
+		PendingPackages.Append( Dependencies );
+	}
+
+	for( auto& PackageName : Packages )
+	{
+		TArray< FAssetData > Assets;
+		AssetRegistry.GetAssetsByPackageName( PackageName, Assets );
+
+		for( auto& Asset : Assets )
+			OutAssets.Add( Asset.ToSoftObjectPath() );
+	}
+}
+
+void UCubeDataSingleton::UpdatePieceResidency( const TSet< UClass* >& ReachableClasses )
+{
+	CUBE_LLM_SCOPE( Preload );
+
+	if( !GameData || !GameData->EnablePieceResidency )
+		return;
+
+	int32 Released = 0;
+	int32 Requested = 0;
+
+	// Release classes that can no longer be spawned
+	for( auto Iter = ResidentPieceHandles.CreateIterator(); Iter; ++Iter )
+	{
+		if( !ReachableClasses.Contains( Iter.Key() ) )
+		{
+			if( Iter.Value().IsValid() )
+				Iter.Value()->ReleaseHandle();
+
+			Iter.RemoveCurrent();
+			Released++;
+		}
+	}
+
+	for( auto* Class : ReachableClasses )
+	{
+		if( !Class || ResidentPieceHandles.Contains( Class ) )
+			continue;
+
+		TSet< UClass* > PieceClass;
+		PieceClass.Add( Class );
+
+		TArray< FSoftObjectPath > Assets;
+		GatherClassDependencies( PieceClass, Assets );
+
+		// Already loaded assets complete straight away, the handle just keeps them pinned
+		TSharedPtr< FStreamableHandle > Handle;
+
+		if( Assets.Num() )
+			Handle = AssetLoader.RequestAsyncLoad( Assets, FStreamableDelegate(), FStreamableManager::DefaultAsyncLoadPriority, true );
+
+		ResidentPieceHandles.Add( Class, Handle );
+		Requested++;
+	}
+
+	// The level manifest is covered by the resident classes from here on
+	if( LevelPreloadHandle.IsValid() && LevelPreloadHandle->HasLoadCompleted() )
+	{
+		LevelPreloadHandle->ReleaseHandle();
+		LevelPreloadHandle.Reset();
+	}
+
+	if( Released || Requested )
+		UCubeSingletonDataLibrary::CustomLog( "Piece residency: " + FString::FromInt( ResidentPieceHandles.Num() ) + " classes resident, " + 
+			FString::FromInt( Requested ) + " requested, " + FString::FromInt( Released ) + " released", LogDisplayType::Gameplay );
+}
+
+int64 UCubeDataSingleton::CalculateResidentMemory( TMap< UClass*, int64 >* OutClassMemory /*= nullptr*/ ) const
+{
+	TSet< UObject* > CountedAssets;
+	int64 TotalBytes = 0;
+
+	for( auto& Resident : ResidentPieceHandles )
+	{
+		if( !Resident.Value.IsValid() )
+			continue;
+
+		TArray< UObject* > Assets;
+		Resident.Value->GetLoadedAssets( Assets );
+
+		int64 ClassBytes = 0;
+
+		for( auto* Asset : Assets )
+		{
+			const int64 Bytes = Asset->GetResourceSizeBytes( EResourceSizeMode::EstimatedTotal );
+			ClassBytes += Bytes;
+
+			// Shared assets only count once towards the total
+			if( !CountedAssets.Contains( Asset ) )
 			{
-				LoadedObjectHandles.Add( Asset ); 
+				CountedAssets.Add( Asset );
+				TotalBytes += Bytes;
 			}
 		}
+
+		if( OutClassMemory )
+			OutClassMemory->Add( Resident.Key, ClassBytes );
 	}
 
-	const auto Total = ObjectLibrary->LoadAssetsFromAssetData();
-	UCubeSingletonDataLibrary::CustomLog( "Preloaded " + FString::FromInt( LoadedObjectHandles.Num() ) + " assets", LogDisplayType::Gameplay );
+	return TotalBytes;
 }
 
-bool UCubeDataSingleton::IsPreloadingFinished()
+void UCubeDataSingleton::ReportResidency( const FString& Context )
 {
-	return HaveAsyncObjectsFinishedLoading && ObjectLibrary->IsLibraryFullyLoaded();
-}
\ No newline at end of file
+	TMap< UClass*, int64 > ClassMemory;
+	const auto TotalBytes = CalculateResidentMemory( &ClassMemory );
+
+	ClassMemory.ValueSort( []( const int64 A, const int64 B ) { return A > B; } );
+
+	for( auto& Entry : ClassMemory )
+		UCubeSingletonDataLibrary::CustomLog( "    " + Entry.Key->GetName() + ": " + FString::SanitizeFloat( Entry.Value / 1024.0f ) + " KB", LogDisplayType::Gameplay );
+
+	UCubeSingletonDataLibrary::CustomLog( Context + ": " + FString::FromInt( ClassMemory.Num() ) + " piece classes resident, " + FString::SanitizeFloat( TotalBytes / ( 1024.0f * 1024.0f ) ) + " MB", LogDisplayType::Gameplay );
+}
+
+float UCubeDataSingleton::GetResidentMemoryMB() const
+{
+	return CalculateResidentMemory() / ( 1024.0f * 1024.0f );
+}
@@ -8,11 +8,13 @@
 #include "GameDataAssets.h"
 #include "CubeDataSingleton.generated.h"
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE( FPreloadFinishedSignature );
+
 UCLASS( Blueprintable )
 class CUBERUNNER_API UCubeDataSingleton : public UObject
 {
 	GENERATED_BODY()
-	
+
 public:
 	// Methods
 	UCubeDataSingleton( const FObjectInitializer& ObjectInitializer );
@@ -20,20 +22,77 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	void CorrectUpgradeSpawnOdds();
 
+	// Streams in AssetsToLoad and everything under FoldersToLoad at default priority
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	void PreloadGameObjects();
 
+	// Streams in the manifest for a level at high priority (Level -1 is endless mode)
+	UFUNCTION( BlueprintCallable, Category = "Utility" )
+	void PreloadLevel( const bool ClassicMode, const int32 Level );
+
+	UFUNCTION( BlueprintCallable, Category = "Utility" )
+	void CancelPreloading();
+
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	bool IsPreloadingFinished();
 
+	UFUNCTION( BlueprintCallable, Category = "Utility" )
+	bool IsLevelPreloadingFinished();
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	float GetPreloadingProgress() const;
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	float GetLevelPreloadingProgress() const;
+
+	TArray< FSoftObjectPath >* FindLevelManifest( const bool ClassicMode, const int32 Level ) const;
+
+#if WITH_EDITOR
+	// Rebuilds a level manifest from the hard dependencies of the piece classes it can spawn, a changed one is
+	// only held here so playing never dirties the game data, cr.SaveLevelManifests writes them to the asset
+	void GenerateLevelManifest( const bool ClassicMode, const int32 Level, const TSet< UClass* >& PieceClasses );
+	int32 SaveLevelManifests();
+#endif
+
+	// Pins the assets of the given piece classes and releases those of any other piece class
+	void UpdatePieceResidency( const TSet< UClass* >& ReachableClasses );
+
+	UFUNCTION( BlueprintCallable, Category = "Utility" )
+	void ReportResidency( const FString& Context );
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	float GetResidentMemoryMB() const;
+
+private:
+	void GatherFolderAssets( TArray< FSoftObjectPath >& OutAssets );
+	void GatherClassDependencies( const TSet< UClass* >& Classes, TArray< FSoftObjectPath >& OutAssets ) const;
+	int64 CalculateResidentMemory( TMap< UClass*, int64 >* OutClassMemory = nullptr ) const;
+	void OnPreloadingFinished();
+	void OnLevelPreloadingFinished();
+
 	// Members
+public:
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Game Data" ) UGameDataAssets* GameData;
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Game Data" ) bool EnableDebugLogging;
 
+	UPROPERTY( BlueprintAssignable, Category = "Events" ) FPreloadFinishedSignature OnPreloadFinished;
+	UPROPERTY( BlueprintAssignable, Category = "Events" ) FPreloadFinishedSignature OnLevelPreloadFinished;
+
 private:
 
 	bool HaveAsyncObjectsFinishedLoading = false;
+	bool HaveLevelObjectsFinishedLoading = false;
 	FStreamableManager AssetLoader;
 	UObjectLibrary* ObjectLibrary = nullptr;
 	TArray< UObject* > LoadedObjectHandles;
+
+	TSharedPtr< FStreamableHandle > PreloadHandle;
+	TSharedPtr< FStreamableHandle > LevelPreloadHandle;
+	FIntPoint LevelPreloadKey = FIntPoint( INDEX_NONE, INDEX_NONE );
+
+	TMap< UClass*, TSharedPtr< FStreamableHandle > > ResidentPieceHandles;
+
+#if WITH_EDITOR
+	TMap< FIntPoint, TArray< FSoftObjectPath > > PendingLevelManifests;
+#endif
 };
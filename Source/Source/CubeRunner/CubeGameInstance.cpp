@@ -5,6 +5,21 @@
 #include "CubeSaveGame.h"
 #include "CubeDataSingleton.h"
 #include "CubeSingletonDataLibrary.h"
+#include "BasePlayerPawn.h"
+#include "ObstacleLayoutCache.h"
+#include "BaseFloorPiece.h"
+#include "BaseRandomisedFloorPiece.h"
+#include "FloorPieceProfiler.h"
+#include "CubeMemory.h"
+#include "CubeRunnerGameMode.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+
+namespace
+{
+	TAutoConsoleVariable< int32 > CVarLowPowerMode( TEXT( "cr.LowPowerMode" ), 1, TEXT( "Pause the game, cap the frame rate and free pools and caches on focus loss or backgrounding" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarLowPowerMaxFPS( TEXT( "cr.LowPowerMaxFPS" ), 5.0f, TEXT( "t.MaxFPS while in low power mode" ), ECVF_Default );
+}
 
 UCubeGameInstance::UCubeGameInstance( const FObjectInitializer& ObjectInitializer )
 {
@@ -13,9 +28,30 @@ UCubeGameInstance::UCubeGameInstance( const FObjectInitializer& ObjectInitialize
 
 void UCubeGameInstance::Init()
 {
+	FCubeMemory::RegisterTags();
+
 	LoginChangedHandle = FCoreDelegates::OnUserLoginChangedEvent.AddUObject( this, &UCubeGameInstance::OnLoginChanged );
-	EnteringForegroundHandle = FCoreDelegates::ApplicationHasEnteredForegroundDelegate.AddUObject( this, &UCubeGameInstance::OnEnteringForeground );
-	EnteringBackgroundHandle = FCoreDelegates::ApplicationWillEnterBackgroundDelegate.AddUObject( this, &UCubeGameInstance::OnEnteringBackground );
+	EnteringForegroundHandle = FCoreDelegates::ApplicationHasEnteredForegroundDelegate.AddUObject( this, &UCubeGameInstance::HandleEnteringForeground );
+	EnteringBackgroundHandle = FCoreDelegates::ApplicationWillEnterBackgroundDelegate.AddUObject( this, &UCubeGameInstance::HandleEnteringBackground );
+
+	if( FParse::Value( FCommandLine::Get(), TEXT( "CubeReplay=" ), ReplayPath ) )
+	{
+		if( Replay.Load( ReplayPath ) )
+		{
+			ReplayMode = ECubeReplayMode::ECRM_PLAYBACK;
+			ReplayBenchmark = FParse::Param( FCommandLine::Get(), TEXT( "CubeReplayBenchmark" ) );
+		}
+	}
+	else if( FParse::Param( FCommandLine::Get(), TEXT( "CubeRecord" ) ) )
+	{
+		ReplayMode = ECubeReplayMode::ECRM_RECORD;
+	}
+
+#if WITH_EDITOR
+	// Blueprints may have been edited since the last play session
+	FObstacleLayoutCache::Get().Empty();
+	ABaseFloorPiece::ResetVariationTables();
+#endif
 
 	Super::Init();
 }
@@ -23,12 +59,102 @@ void UCubeGameInstance::Init()
 void UCubeGameInstance::Shutdown()
 {
 	FCoreDelegates::OnUserLoginChangedEvent.Remove( LoginChangedHandle );
-	FCoreDelegates::OnUserLoginChangedEvent.Remove( EnteringForegroundHandle );
-	FCoreDelegates::OnUserLoginChangedEvent.Remove( EnteringBackgroundHandle );
+	FCoreDelegates::ApplicationHasEnteredForegroundDelegate.Remove( EnteringForegroundHandle );
+	FCoreDelegates::ApplicationWillEnterBackgroundDelegate.Remove( EnteringBackgroundHandle );
+
+	if( IsInLowPowerMode() )
+	{
+		LowPowerReasons = 0;
+		RestoreFromLowPowerMode();
+	}
+
+	EndRun();
+
+	if( ReplaySaveTask.IsValid() )
+		ReplaySaveTask.Wait();
+
+	FObstacleLayoutCache::Get().Save();
 
 	Super::Shutdown();
 }
 
+void UCubeGameInstance::HandleEnteringForeground()
+{
+	ExitLowPowerMode( ELowPowerReason::Background );
+	OnEnteringForeground();
+}
+
+void UCubeGameInstance::HandleEnteringBackground()
+{
+	// Blueprint goes first so a pause it makes is left for it to undo
+	OnEnteringBackground();
+	EnterLowPowerMode( ELowPowerReason::Background );
+}
+
+void UCubeGameInstance::EnterLowPowerMode( const ELowPowerReason Reason )
+{
+	if( !CVarLowPowerMode.GetValueOnGameThread() || IsReplayPlayback() )
+		return;
+
+	// Clicking between editor panels shouldn't pause PIE
+	if( GIsEditor && Reason == ELowPowerReason::FocusLost )
+		return;
+
+	const bool WasLowPower = IsInLowPowerMode();
+	LowPowerReasons |= ( uint8 )Reason;
+
+	if( WasLowPower )
+		return;
+
+	auto* World = GetWorld();
+	LowPowerPausedGame = World && !UGameplayStatics::IsGamePaused( World ) && UGameplayStatics::SetGamePaused( World, true );
+
+	if( auto* MaxFPS = IConsoleManager::Get().FindConsoleVariable( TEXT( "t.MaxFPS" ) ) )
+	{
+		LowPowerSavedMaxFPS = MaxFPS->GetFloat();
+		MaxFPS->Set( CVarLowPowerMaxFPS.GetValueOnGameThread(), ECVF_SetByCode );
+	}
+
+	if( auto* GameMode = Cast< ACubeRunnerGameMode >( UGameplayStatics::GetGameMode( World ) ) )
+		GameMode->ReleaseCachedResources();
+
+	// A backgrounded app can be killed without warning, so flush anything unsaved now
+	if( InstanceSaveGameData )
+		SaveGame();
+
+	if( ReplaySaveTask.IsValid() )
+		ReplaySaveTask.Wait();
+
+	FObstacleLayoutCache::Get().Save();
+
+	UCubeSingletonDataLibrary::CustomLog( "Entered low power mode", LogDisplayType::Gameplay );
+}
+
+void UCubeGameInstance::ExitLowPowerMode( const ELowPowerReason Reason )
+{
+	if( !IsInLowPowerMode() )
+		return;
+
+	LowPowerReasons &= ~( uint8 )Reason;
+
+	if( !IsInLowPowerMode() )
+		RestoreFromLowPowerMode();
+}
+
+void UCubeGameInstance::RestoreFromLowPowerMode()
+{
+	if( auto* MaxFPS = IConsoleManager::Get().FindConsoleVariable( TEXT( "t.MaxFPS" ) ) )
+		MaxFPS->Set( LowPowerSavedMaxFPS, ECVF_SetByCode );
+
+	// Pools and layouts aren't rebuilt here, they refill as pieces spawn
+	if( LowPowerPausedGame && GetWorld() )
+		UGameplayStatics::SetGamePaused( GetWorld(), false );
+
+	LowPowerPausedGame = false;
+
+	UCubeSingletonDataLibrary::CustomLog( "Left low power mode", LogDisplayType::Gameplay );
+}
+
 float UCubeGameInstance::GetOptionValueScaled( float Value, float Min, float Max )
 {
 	return Min + ( Max - Min ) * Value;
@@ -41,6 +167,8 @@ float UCubeGameInstance::GetOptionValueRaw( float Value, float Min, float Max )
 
 void UCubeGameInstance::CompleteLevel( const bool ClassicMode, const int32 Level )
 {
+	CUBE_LLM_SCOPE( SaveData );
+
 	if( !CheckSaveGame() )
 		return;
 
@@ -117,6 +245,8 @@ TArray< int32 > UCubeGameInstance::LoadUncompletedLevelsOfDifficulty( const bool
 
 void UCubeGameInstance::SaveCompletedLevels( const bool ClassicMode, const TArray< int32 >& Levels )
 {
+	CUBE_LLM_SCOPE( SaveData );
+
 	if( !CheckSaveGame() )
 		return;
 
@@ -155,6 +285,8 @@ bool UCubeGameInstance::HasUnlockedDifficulty( const TArray< int32 >& Levels, co
 
 void UCubeGameInstance::SaveGame()
 {
+	CUBE_LLM_SCOPE( SaveData );
+
 	if( !CheckSaveGame() )
 		return;
 
@@ -189,6 +321,8 @@ bool UCubeGameInstance::LoadCustomBool( FString Key, bool& LoadedValue )
 
 void UCubeGameInstance::SaveCustomValue( FString Key, float Value )
 {
+	CUBE_LLM_SCOPE( SaveData );
+
 	if( !CheckSaveGame() )
 		return;
 
@@ -197,6 +331,8 @@ void UCubeGameInstance::SaveCustomValue( FString Key, float Value )
 
 void UCubeGameInstance::SaveCustomBool( FString Key, bool Value )
 {
+	CUBE_LLM_SCOPE( SaveData );
+
 	if( !CheckSaveGame() )
 		return;
 
@@ -217,8 +353,157 @@ void UCubeGameInstance::RegisterOnlineID( FString NewOnlineID )
 	InitSaveGameSlot();
 }
 
+void UCubeGameInstance::SetReplayRecording( bool Enabled )
+{
+	if( ReplayMode != ECubeReplayMode::ECRM_PLAYBACK )
+		ReplayMode = Enabled ? ECubeReplayMode::ECRM_RECORD : ECubeReplayMode::ECRM_NONE;
+}
+
+int32 UCubeGameInstance::BeginRun()
+{
+	// Loaded once in Init, each run starts again from the first frame
+	if( ReplayMode == ECubeReplayMode::ECRM_PLAYBACK )
+	{
+		Replay.Rewind();
+		const auto& Header = Replay.GetHeader();
+		RunSeed = Header.Seed;
+		LevelIndex = Header.LevelIndex;
+		ClassicPlayerMode = Header.ClassicMode;
+		UCubeSingletonDataLibrary::CustomLog( "Playing back replay: " + ReplayPath, LogDisplayType::Gameplay );
+	}
+	else
+	{
+		RunSeed = int32( FPlatformTime::Cycles() );
+	}
+
+	FMath::RandInit( RunSeed );
+	FMath::SRandInit( RunSeed );
+	return RunSeed;
+}
+
+void UCubeGameInstance::StartReplay( ABasePlayerPawn* Pawn )
+{
+	ReplayActive = ReplayMode != ECubeReplayMode::ECRM_NONE;
+	Pawn->ReplayMode = ReplayMode;
+
+	if( ReplayMode == ECubeReplayMode::ECRM_RECORD )
+	{
+		FCubeReplayHeader Header;
+		Header.Seed = RunSeed;
+		Header.LevelIndex = LevelIndex;
+		Header.ClassicMode = ClassicPlayerMode;
+		Header.InputMode = ( uint8 )Pawn->InputMode;
+		Header.SimulationRate = ABasePlayerPawn::GetSimulationRate();
+		Replay.BeginRecording( Header );
+	}
+	else if( ReplayMode == ECubeReplayMode::ECRM_PLAYBACK )
+	{
+		Pawn->SetInputMode( ( EInputMode )Replay.GetHeader().InputMode );
+		ABasePlayerPawn::SetSimulationRate( Replay.GetHeader().SimulationRate );
+
+		// Every frame is stepped by its recorded delta so the run plays out exactly as it was recorded
+		HasNextReplayFrame = Replay.ReadFrame( NextReplayFrame );
+		FApp::SetUseFixedTimeStep( true );
+		FApp::SetFixedDeltaTime( NextReplayFrame.DeltaTime );
+
+		ReplayFrameTimes.Reset( 4096 );
+		ABaseRandomisedFloorPiece::ResetRecentreTotals();
+		LastReplayFrameTime = FPlatformTime::Seconds();
+	}
+}
+
+void UCubeGameInstance::EndRun()
+{
+	if( !ReplayActive )
+		return;
+
+	ReplayActive = false;
+
+	if( ReplayMode == ECubeReplayMode::ECRM_RECORD )
+	{
+		const auto Path = FPaths::ProjectSavedDir() / TEXT( "Replays" ) / TEXT( "Replay_" ) + FDateTime::Now().ToString() + TEXT( ".cuberep" );
+		UCubeSingletonDataLibrary::CustomLog( FString::Printf( TEXT( "Saving replay: %s (%d frames, %d bytes)" ), *Path, Replay.GetFrameCount(), Replay.GetSize() ), LogDisplayType::Gameplay );
+
+		if( ReplaySaveTask.IsValid() )
+			ReplaySaveTask.Wait();
+
+		ReplaySaveTask = Replay.SaveAsync( Path );
+	}
+	else if( ReplayMode == ECubeReplayMode::ECRM_PLAYBACK )
+	{
+		FApp::SetUseFixedTimeStep( false );
+		ReportReplayBenchmark();
+
+		// Headless benchmark runs are how the piece costs get collected
+		if( FFloorPieceProfiler::Get().IsEnabled() )
+			FFloorPieceProfiler::Get().ExportCSV();
+
+		// Soak runs with -LLM also check the subsystem memory budgets
+		if( !FCubeMemory::Report( *GLog, true ) )
+			UE_LOG( LogCubeBenchmark, Error, TEXT( "Replay benchmark exceeded a memory budget, see cr.MemReport" ) );
+
+		if( ReplayBenchmark )
+			FPlatformMisc::RequestExit( false );
+	}
+}
+
+void UCubeGameInstance::RecordReplayFrame( const FCubeReplayFrame& Frame )
+{
+	if( ReplayActive && ReplayMode == ECubeReplayMode::ECRM_RECORD )
+		Replay.RecordFrame( Frame );
+}
+
+bool UCubeGameInstance::ConsumeReplayFrame( FCubeReplayFrame& OutFrame )
+{
+	if( !ReplayActive || ReplayMode != ECubeReplayMode::ECRM_PLAYBACK )
+		return false;
+
+	if( !HasNextReplayFrame )
+	{
+		EndRun();
+		return false;
+	}
+
+	const auto Now = FPlatformTime::Seconds();
+	ReplayFrameTimes.Add( float( ( Now - LastReplayFrameTime ) * 1000.0 ) );
+	LastReplayFrameTime = Now;
+
+	OutFrame = NextReplayFrame;
+	HasNextReplayFrame = Replay.ReadFrame( NextReplayFrame );
+
+	if( HasNextReplayFrame )
+		FApp::SetFixedDeltaTime( NextReplayFrame.DeltaTime );
+
+	return true;
+}
+
+void UCubeGameInstance::ReportReplayBenchmark() const
+{
+	if( !ReplayFrameTimes.Num() )
+		return;
+
+	auto Sorted = ReplayFrameTimes;
+	Sorted.Sort();
+
+	float Total = 0.0f;
+	for( const auto Time : Sorted )
+		Total += Time;
+
+	const auto Percentile = [&Sorted]( const float Fraction ) { return Sorted[ FMath::Min( Sorted.Num() - 1, int32( Sorted.Num() * Fraction ) ) ]; };
+
+	UE_LOG( LogCubeBenchmark, Display, TEXT( "Replay benchmark: %d frames in %.2fs, avg %.2fms, p50 %.2fms, p99 %.2fms, max %.2fms" ),
+		Sorted.Num(), Total / 1000.0f, Total / Sorted.Num(), Percentile( 0.5f ), Percentile( 0.99f ), Sorted.Last() );
+
+	// Compare runs with "cr.FloorRecentreStep 0" (recentre every frame) against the default step
+	const auto RecentreStep = IConsoleManager::Get().FindConsoleVariable( TEXT( "cr.FloorRecentreStep" ) );
+	UE_LOG( LogCubeBenchmark, Display, TEXT( "Floor recentres: %d totalling %.2fms (cr.FloorRecentreStep %.1f)" ),
+		ABaseRandomisedFloorPiece::GetRecentreCount(), ABaseRandomisedFloorPiece::GetRecentreSeconds() * 1000.0, RecentreStep ? RecentreStep->GetFloat() : 0.0f );
+}
+
 void UCubeGameInstance::InitSaveGameSlot()
 {
+	CUBE_LLM_SCOPE( SaveData );
+
 	const FString SaveSlotName = GetSaveSlotName();
 	if( !UGameplayStatics::DoesSaveGameExist( SaveSlotName, 0 ) )
 	{
@@ -3,10 +3,18 @@
 #pragma once
 
 #include "Engine/GameInstance.h"
+#include "CubeReplay.h"
 #include "CubeGameInstance.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE( FLostFocusSignature );
 
+// Why the game is in low power mode, it is only left once every reason has cleared
+enum class ELowPowerReason : uint8
+{
+	FocusLost = 1 << 0,
+	Background = 1 << 1,
+};
+
 USTRUCT( BlueprintType )
 struct FGameplayStatistics
 {
@@ -99,12 +107,38 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Online" )
 	void RegisterOnlineID( FString NewOnlineID );
 
+	// Records the next run to Saved/Replays when it ends
+	UFUNCTION( BlueprintCallable, Category = "Replay" )
+	void SetReplayRecording( bool Enabled );
+
+	UFUNCTION( BlueprintPure, Category = "Replay" )
+	bool IsReplayPlayback() const { return ReplayMode == ECubeReplayMode::ECRM_PLAYBACK; }
+
+	// Seeds the run's random streams, a replay being played back also picks the level
+	int32 BeginRun();
+	void StartReplay( class ABasePlayerPawn* Pawn );
+	void EndRun();
+
+	void RecordReplayFrame( const FCubeReplayFrame& Frame );
+	bool ConsumeReplayFrame( FCubeReplayFrame& OutFrame );
+
+	// Pauses the game, caps the frame rate and frees pools and caches while nobody is watching (cr.LowPowerMode)
+	void EnterLowPowerMode( const ELowPowerReason Reason );
+	void ExitLowPowerMode( const ELowPowerReason Reason );
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	bool IsInLowPowerMode() const { return LowPowerReasons != 0; }
+
 protected:
 	void Init() override;
 	void Shutdown() override;
 	void InitSaveGameSlot();
 	FString GetSaveSlotName() const;
 	bool CheckSaveGame() const;
+	void ReportReplayBenchmark() const;
+	void HandleEnteringForeground();
+	void HandleEnteringBackground();
+	void RestoreFromLowPowerMode();
 
 	// Members
 public:
@@ -120,6 +154,9 @@ public:
 
 	UPROPERTY( BlueprintAssignable, Category = "Events" ) FLostFocusSignature OnLostFocus;
 
+	UPROPERTY( BlueprintReadOnly, Category = "Replay" ) ECubeReplayMode ReplayMode = ECubeReplayMode::ECRM_NONE;
+	UPROPERTY( BlueprintReadOnly, Category = "Replay" ) int32 RunSeed = 0;
+
 	UPROPERTY() class UCubeSaveGame* InstanceSaveGameData = nullptr;
 
 protected:	
@@ -129,4 +166,20 @@ protected:
 	FDelegateHandle LoginChangedHandle;
 	FDelegateHandle EnteringForegroundHandle;
 	FDelegateHandle EnteringBackgroundHandle;
+
+	// -CubeRecord, -CubeReplay=<File> and -CubeReplayBenchmark (run with -nullrhi to benchmark headless)
+	// Add -CubePieceProfile to a benchmark to also export per piece costs, see FFloorPieceProfiler
+	FCubeReplay Replay;
+	FString ReplayPath;
+	bool ReplayBenchmark = false;
+	bool ReplayActive = false;
+	FCubeReplayFrame NextReplayFrame;
+	bool HasNextReplayFrame = false;
+	TFuture< bool > ReplaySaveTask;
+	double LastReplayFrameTime = 0.0;
+	TArray< float > ReplayFrameTimes;
+
+	uint8 LowPowerReasons = 0;
+	bool LowPowerPausedGame = false;
+	float LowPowerSavedMaxFPS = 0.0f;
 };
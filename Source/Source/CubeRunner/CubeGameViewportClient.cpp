@@ -8,11 +8,20 @@
 void UCubeGameViewportClient::LostFocus( FViewport* _Viewport )
 {
 	UGameViewportClient::LostFocus( _Viewport );
-	static_cast<UCubeGameInstance*>( GameInstance )->OnLostFocus.Broadcast();
+	auto* CubeGameInstance = Cast< UCubeGameInstance >( GameInstance );
+
+	if( !CubeGameInstance )
+		return;
+
+	CubeGameInstance->OnLostFocus.Broadcast();
+	CubeGameInstance->EnterLowPowerMode( ELowPowerReason::FocusLost );
 }
 
 void UCubeGameViewportClient::ReceivedFocus( FViewport* _Viewport )
 {
 	UGameViewportClient::ReceivedFocus( _Viewport );
+
+	if( auto* CubeGameInstance = Cast< UCubeGameInstance >( GameInstance ) )
+		CubeGameInstance->ExitLowPowerMode( ELowPowerReason::FocusLost );
 }
 
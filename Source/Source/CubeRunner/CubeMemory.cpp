@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeMemory.h"
+#include "CubeRunner.h"
+#include "HAL/LowLevelMemStats.h"
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Floor Pieces" ), STAT_CubeFloorPiecesLLM, STATGROUP_LLMFULL );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Obstacle Instances" ), STAT_CubeObstacleInstancesLLM, STATGROUP_LLMFULL );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Spawn Queue" ), STAT_CubeSpawnQueueLLM, STATGROUP_LLMFULL );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Save Data" ), STAT_CubeSaveDataLLM, STATGROUP_LLMFULL );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Preload" ), STAT_CubePreloadLLM, STATGROUP_LLMFULL );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube AI Paths" ), STAT_CubeAIPathsLLM, STATGROUP_LLMFULL );
+
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Floor Pieces" ), STAT_CubeFloorPiecesSummaryLLM, STATGROUP_LLM );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Obstacle Instances" ), STAT_CubeObstacleInstancesSummaryLLM, STATGROUP_LLM );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Spawn Queue" ), STAT_CubeSpawnQueueSummaryLLM, STATGROUP_LLM );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Save Data" ), STAT_CubeSaveDataSummaryLLM, STATGROUP_LLM );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube Preload" ), STAT_CubePreloadSummaryLLM, STATGROUP_LLM );
+DECLARE_LLM_MEMORY_STAT( TEXT( "Cube AI Paths" ), STAT_CubeAIPathsSummaryLLM, STATGROUP_LLM );
+#endif
+
+namespace
+{
+	// Megabytes, 0 leaves the tag unchecked
+	TAutoConsoleVariable< float > CVarMemBudgetFloorPieces( TEXT( "cr.MemBudget.FloorPieces" ), 48.0f, TEXT( "LLM budget in MB for spawned and pooled floor pieces" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarMemBudgetObstacleInstances( TEXT( "cr.MemBudget.ObstacleInstances" ), 16.0f, TEXT( "LLM budget in MB for instanced obstacle data and child obstacles" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarMemBudgetSpawnQueue( TEXT( "cr.MemBudget.SpawnQueue" ), 1.0f, TEXT( "LLM budget in MB for the piece spawn queue" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarMemBudgetSaveData( TEXT( "cr.MemBudget.SaveData" ), 1.0f, TEXT( "LLM budget in MB for save game data" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarMemBudgetPreload( TEXT( "cr.MemBudget.Preload" ), 0.0f, TEXT( "LLM budget in MB for the preload set" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarMemBudgetAIPaths( TEXT( "cr.MemBudget.AIPaths" ), 2.0f, TEXT( "LLM budget in MB for AI path finding" ), ECVF_Default );
+
+	// memreport runs this too (see [MemReportCommands] in DefaultEngine.ini)
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice MemReportCommand( TEXT( "cr.MemReport" ), TEXT( "List the CubeRunner LLM tags against their budgets" ),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda( []( const TArray< FString >& Args, UWorld* World, FOutputDevice& Ar ) { FCubeMemory::Report( Ar, true ); } ) );
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	struct FCubeTagInfo
+	{
+		ECubeLLMTag Tag;
+		const TCHAR* Name;
+		FName StatName;
+		FName SummaryStatName;
+		TAutoConsoleVariable< float >* Budget;
+	};
+
+	const TArray< FCubeTagInfo >& GetTagInfo()
+	{
+		static const TArray< FCubeTagInfo > Tags =
+		{
+			{ ECubeLLMTag::FloorPieces, TEXT( "CubeFloorPieces" ), GET_STATFNAME( STAT_CubeFloorPiecesLLM ), GET_STATFNAME( STAT_CubeFloorPiecesSummaryLLM ), &CVarMemBudgetFloorPieces },
+			{ ECubeLLMTag::ObstacleInstances, TEXT( "CubeObstacleInstances" ), GET_STATFNAME( STAT_CubeObstacleInstancesLLM ), GET_STATFNAME( STAT_CubeObstacleInstancesSummaryLLM ), &CVarMemBudgetObstacleInstances },
+			{ ECubeLLMTag::SpawnQueue, TEXT( "CubeSpawnQueue" ), GET_STATFNAME( STAT_CubeSpawnQueueLLM ), GET_STATFNAME( STAT_CubeSpawnQueueSummaryLLM ), &CVarMemBudgetSpawnQueue },
+			{ ECubeLLMTag::SaveData, TEXT( "CubeSaveData" ), GET_STATFNAME( STAT_CubeSaveDataLLM ), GET_STATFNAME( STAT_CubeSaveDataSummaryLLM ), &CVarMemBudgetSaveData },
+			{ ECubeLLMTag::Preload, TEXT( "CubePreload" ), GET_STATFNAME( STAT_CubePreloadLLM ), GET_STATFNAME( STAT_CubePreloadSummaryLLM ), &CVarMemBudgetPreload },
+			{ ECubeLLMTag::AIPaths, TEXT( "CubeAIPaths" ), GET_STATFNAME( STAT_CubeAIPathsLLM ), GET_STATFNAME( STAT_CubeAIPathsSummaryLLM ), &CVarMemBudgetAIPaths },
+		};
+
+		return Tags;
+	}
+#endif
+}
+
+void FCubeMemory::RegisterTags()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	static bool Registered = false;
+
+	if( Registered )
+		return;
+
+	Registered = true;
+
+	for( const auto& Info : GetTagInfo() )
+		FLowLevelMemTracker::Get().RegisterProjectTag( ( int32 )Info.Tag, Info.Name, Info.StatName, Info.SummaryStatName );
+#endif
+}
+
+bool FCubeMemory::Report( FOutputDevice& Ar, const bool CheckBudgets )
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	if( !FLowLevelMemTracker::IsEnabled() )
+	{
+		Ar.Logf( TEXT( "CubeRunner memory: LLM isn't tracking, run with -LLM" ) );
+		return true;
+	}
+
+	const auto ToMB = []( const int64 Bytes ) { return Bytes / ( 1024.0 * 1024.0 ); };
+	bool WithinBudget = true;
+
+	Ar.Logf( TEXT( "CubeRunner memory (MB): tag, current, peak, budget" ) );
+
+	for( const auto& Info : GetTagInfo() )
+	{
+		const auto Current = FLowLevelMemTracker::Get().GetTagAmountForTracker( ELLMTracker::Default, ( ELLMTag )Info.Tag );
+		const auto Peak = FLowLevelMemTracker::Get().GetTagAmountForTracker( ELLMTracker::Default, ( ELLMTag )Info.Tag, true );
+		const auto Budget = Info.Budget->GetValueOnGameThread();
+		const bool OverBudget = CheckBudgets && Budget > 0.0f && ToMB( Peak ) > Budget;
+
+		Ar.Logf( OverBudget ? ELogVerbosity::Error : ELogVerbosity::Log, TEXT( "  %s, %.2f, %.2f, %s%s" ), Info.Name, ToMB( Current ), ToMB( Peak ),
+			Budget > 0.0f ? *FString::Printf( TEXT( "%.2f" ), Budget ) : TEXT( "-" ), OverBudget ? TEXT( " OVER BUDGET" ) : TEXT( "" ) );
+
+		WithinBudget &= !OverBudget;
+	}
+
+	return WithinBudget;
+#else
+	Ar.Logf( TEXT( "CubeRunner memory: LLM is compiled out of this build" ) );
+	return true;
+#endif
+}
@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+// Low level memory tracker tags for the game's own systems (run with -LLM)
+// Each one shows up in stat LLM and stat LLMFULL, and cr.MemReport lists them against their cr.MemBudget.* budgets
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+enum class ECubeLLMTag : LLM_TAG_TYPE
+{
+	FloorPieces = ( LLM_TAG_TYPE )ELLMTag::ProjectTagStart,
+	ObstacleInstances,
+	SpawnQueue,
+	SaveData,
+	Preload,
+	AIPaths,
+};
+
+#define CUBE_LLM_SCOPE( Tag ) LLM_SCOPE( ( ELLMTag )ECubeLLMTag::Tag )
+#else
+#define CUBE_LLM_SCOPE( Tag )
+#endif
+
+class CUBERUNNER_API FCubeMemory
+{
+public:
+	// Names the tags and hooks up their stats, has to run before anything is tracked under them
+	static void RegisterTags();
+
+	// Current and peak size of every tag, false if any is over its budget
+	static bool Report( FOutputDevice& Ar, const bool CheckBudgets );
+};
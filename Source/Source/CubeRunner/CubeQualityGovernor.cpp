@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeQualityGovernor.h"
+#include "CubeRunner.h"
+
+DECLARE_FLOAT_ACCUMULATOR_STAT( TEXT( "Quality Level" ), STAT_QualityLevel, STATGROUP_CubeRunner );
+DECLARE_FLOAT_ACCUMULATOR_STAT( TEXT( "Quality Frame Time Percentile (ms)" ), STAT_QualityFrameTime, STATGROUP_CubeRunner );
+DECLARE_FLOAT_ACCUMULATOR_STAT( TEXT( "Quality Cull Distance" ), STAT_QualityCullDistance, STATGROUP_CubeRunner );
+DECLARE_DWORD_ACCUMULATOR_STAT( TEXT( "Quality Visible Pieces" ), STAT_QualityVisiblePieces, STATGROUP_CubeRunner );
+
+namespace
+{
+	TAutoConsoleVariable< int32 > CVarQualityGovernor( TEXT( "cr.Quality.Governor" ), 1, TEXT( "Scale how many pieces ahead are rendered, obstacle cull distance and cosmetic effects to hold the target frame time. Obstacles and collision are never changed" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarQualityTargetFrameMs( TEXT( "cr.Quality.TargetFrameMs" ), 0.0f, TEXT( "Overrides the game data's target frame time, 0 to use the game data" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarQualityForceLevel( TEXT( "cr.Quality.ForceLevel" ), -1.0f, TEXT( "Pins the quality level between 0 and 1, negative to let the governor decide" ), ECVF_Default );
+
+	// Below the target by this much before quality is raised again, stops it oscillating
+	const float RaiseThreshold = 0.85f;
+}
+
+void FCubeQualityGovernor::Reset( const FQualityGovernorSettings& NewSettings )
+{
+	Settings = NewSettings;
+	FrameTimes.Init( 0.0f, FMath::Max( Settings.SampleFrames, 1 ) );
+	NextFrame = 0;
+	LastFrameTime = FPlatformTime::Seconds();
+	NextAdjustTime = LastFrameTime + Settings.AdjustInterval;
+	QualityLevel = 1.0f;
+	FrameTimePercentileMs = 0.0f;
+}
+
+bool FCubeQualityGovernor::Tick()
+{
+	if( !FrameTimes.Num() )
+		return false;
+
+	// Wall clock rather than the game delta, which is fixed during replays
+	const auto Now = FPlatformTime::Seconds();
+	FrameTimes[ NextFrame++ % FrameTimes.Num() ] = float( Now - LastFrameTime ) * 1000.0f;
+	LastFrameTime = Now;
+
+	const auto PreviousLevel = QualityLevel;
+	const auto ForcedLevel = CVarQualityForceLevel.GetValueOnGameThread();
+
+	if( ForcedLevel >= 0.0f )
+	{
+		QualityLevel = FMath::Clamp( ForcedLevel, 0.0f, 1.0f );
+	}
+	else if( CVarQualityGovernor.GetValueOnGameThread() && NextFrame >= FrameTimes.Num() && Now >= NextAdjustTime )
+	{
+		NextAdjustTime = Now + Settings.AdjustInterval;
+
+		SortedFrameTimes = FrameTimes;
+		SortedFrameTimes.Sort();
+		FrameTimePercentileMs = SortedFrameTimes[ FMath::Clamp( FMath::FloorToInt( Settings.FrameTimePercentile * SortedFrameTimes.Num() ), 0, SortedFrameTimes.Num() - 1 ) ];
+
+		const auto TargetOverride = CVarQualityTargetFrameMs.GetValueOnGameThread();
+		const auto Target = TargetOverride > 0.0f ? TargetOverride : Settings.TargetFrameTimeMs;
+
+		if( FrameTimePercentileMs > Target )
+			QualityLevel = FMath::Max( 0.0f, QualityLevel - Settings.StepDown );
+		else if( FrameTimePercentileMs < Target * RaiseThreshold )
+			QualityLevel = FMath::Min( 1.0f, QualityLevel + Settings.StepUp );
+	}
+
+	SET_FLOAT_STAT( STAT_QualityLevel, QualityLevel );
+	SET_FLOAT_STAT( STAT_QualityFrameTime, FrameTimePercentileMs );
+	SET_FLOAT_STAT( STAT_QualityCullDistance, GetCullDistance() );
+	SET_DWORD_STAT( STAT_QualityVisiblePieces, GetVisiblePieces() );
+
+	return QualityLevel != PreviousLevel;
+}
+
+int32 FCubeQualityGovernor::GetVisiblePieces() const
+{
+	return FMath::RoundToInt( FMath::Lerp( float( Settings.MinVisiblePieces ), float( Settings.MaxVisiblePieces ), QualityLevel ) );
+}
+
+float FCubeQualityGovernor::GetCullDistance() const
+{
+	return FMath::Lerp( Settings.MinCullDistance, Settings.MaxCullDistance, QualityLevel );
+}
+
+bool FCubeQualityGovernor::AreEffectsEnabled() const
+{
+	return QualityLevel >= Settings.EffectsMinQuality;
+}
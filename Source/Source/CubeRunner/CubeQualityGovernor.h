@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameDataAssets.h"
+
+// Tracks a percentile of recent frame times and trades visual detail for speed to hold a target frame time
+// Nothing it controls changes what the pawn can collide with, so runs stay deterministic per seed
+class CUBERUNNER_API FCubeQualityGovernor
+{
+public:
+	void Reset( const FQualityGovernorSettings& NewSettings );
+
+	// Returns true when the quality level changed
+	bool Tick();
+
+	float GetQualityLevel() const { return QualityLevel; }
+	float GetFrameTimePercentileMs() const { return FrameTimePercentileMs; }
+	int32 GetVisiblePieces() const;
+	float GetCullDistance() const;
+	bool AreEffectsEnabled() const;
+
+	const FQualityGovernorSettings& GetSettings() const { return Settings; }
+
+private:
+	FQualityGovernorSettings Settings;
+	TArray< float > FrameTimes;
+	TArray< float > SortedFrameTimes;
+	int32 NextFrame = 0;
+	double LastFrameTime = 0.0;
+	double NextAdjustTime = 0.0;
+	float QualityLevel = 1.0f;
+	float FrameTimePercentileMs = 0.0f;
+};
@@ -0,0 +1,225 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeReplay.h"
+#include "CubeRunner.h"
+#include "Async/Async.h"
+#include "Misc/FileHelper.h"
+#include "CubeSingletonDataLibrary.h"
+
+namespace
+{
+	const uint32 ReplayMagic = 0x4C505243; // "CRPL"
+	// 2 added the simulation rate, version 1 runs were stepped per frame and can't be played back the same way
+	const uint8 ReplayVersion = 2;
+
+	enum EReplayValue
+	{
+		ERV_DeltaTime,
+		ERV_Sideways,
+		ERV_Forwards,
+		ERV_GravityX,
+		ERV_GravityY,
+		ERV_GravityZ,
+		ERV_Count,
+	};
+
+	const uint8 JumpBit = 1 << ERV_Count;
+
+	uint32 ZigZag( const int32 Value ) { return ( uint32( Value ) << 1 ) ^ uint32( Value >> 31 ); }
+	int32 UnZigZag( const uint32 Value ) { return int32( Value >> 1 ) ^ -int32( Value & 1 ); }
+
+	void GetFrameValues( const FCubeReplayFrame& Frame, uint32* OutValues )
+	{
+		const float Floats[ERV_Count] = { Frame.DeltaTime, Frame.Sideways, Frame.Forwards, Frame.Gravity.X, Frame.Gravity.Y, Frame.Gravity.Z };
+
+		static_assert( sizeof( float ) == sizeof( uint32 ), "Replay values are stored as the bits of 32 bit floats" );
+		FMemory::Memcpy( OutValues, Floats, sizeof( Floats ) );
+	}
+
+	float AsFloat( const uint32 Value )
+	{
+		float Result;
+		FMemory::Memcpy( &Result, &Value, sizeof( Result ) );
+		return Result;
+	}
+}
+
+void FCubeReplay::Reset()
+{
+	Header = FCubeReplayHeader();
+	Data.Reset();
+	ReadOffset = 0;
+	FramesOffset = 0;
+	FrameCount = 0;
+	FMemory::Memzero( PreviousValues );
+}
+
+void FCubeReplay::Rewind()
+{
+	ReadOffset = FramesOffset;
+	FrameCount = 0;
+	FMemory::Memzero( PreviousValues );
+}
+
+void FCubeReplay::BeginRecording( const FCubeReplayHeader& NewHeader )
+{
+	Reset();
+	Header = NewHeader;
+
+	WriteVarint( ReplayMagic );
+	Data.Add( ReplayVersion );
+	WriteVarint( ZigZag( Header.Seed ) );
+	WriteVarint( ZigZag( Header.LevelIndex ) );
+	Data.Add( Header.ClassicMode ? 1 : 0 );
+	Data.Add( Header.InputMode );
+	WriteVarint( Header.SimulationRate );
+}
+
+void FCubeReplay::RecordFrame( const FCubeReplayFrame& Frame )
+{
+	uint32 Values[ERV_Count];
+	GetFrameValues( Frame, Values );
+
+	// Mask of what changed since the last frame, most frames only touch one or two inputs
+	uint8 Mask = Frame.Jump ? JumpBit : 0;
+
+	for( int32 i = 0; i < ERV_Count; ++i )
+		if( Values[i] != PreviousValues[i] )
+			Mask |= 1 << i;
+
+	Data.Add( Mask );
+
+	for( int32 i = 0; i < ERV_Count; ++i )
+		if( Mask & ( 1 << i ) )
+			WriteValue( Values[i], PreviousValues[i] );
+
+	FrameCount++;
+}
+
+TFuture< bool > FCubeReplay::SaveAsync( const FString& Path ) const
+{
+	return Async( EAsyncExecution::ThreadPool, [ Bytes = Data, Path ]()
+	{
+		return FFileHelper::SaveArrayToFile( Bytes, *Path );
+	} );
+}
+
+bool FCubeReplay::Load( const FString& Path )
+{
+	Reset();
+
+	if( !FFileHelper::LoadFileToArray( Data, *Path ) )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Failed to load replay: " + Path, LogDisplayType::Error );
+		return false;
+	}
+
+	uint32 Magic = 0, Seed = 0, Level = 0, Rate = 0;
+
+	if( !ReadVarint( Magic ) || Magic != ReplayMagic || ReadOffset >= Data.Num() )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Replay has an invalid header: " + Path, LogDisplayType::Error );
+		Reset();
+		return false;
+	}
+
+	const auto Version = Data[ReadOffset++];
+
+	if( Version != ReplayVersion )
+	{
+		UCubeSingletonDataLibrary::CustomLog( FString::Printf( TEXT( "Replay %s is version %d but this build plays version %d, it needs recording again" ), *Path, Version, ReplayVersion ), LogDisplayType::Error );
+		Reset();
+		return false;
+	}
+
+	if( !ReadVarint( Seed ) || !ReadVarint( Level ) || ReadOffset + 2 > Data.Num() )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Replay has an invalid header: " + Path, LogDisplayType::Error );
+		Reset();
+		return false;
+	}
+
+	Header.Seed = UnZigZag( Seed );
+	Header.LevelIndex = UnZigZag( Level );
+	Header.ClassicMode = Data[ReadOffset++] != 0;
+	Header.InputMode = Data[ReadOffset++];
+
+	if( !ReadVarint( Rate ) )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Replay has an invalid header: " + Path, LogDisplayType::Error );
+		Reset();
+		return false;
+	}
+
+	Header.SimulationRate = Rate;
+	FramesOffset = ReadOffset;
+	return true;
+}
+
+bool FCubeReplay::ReadFrame( FCubeReplayFrame& OutFrame )
+{
+	if( ReadOffset >= Data.Num() )
+		return false;
+
+	const auto Mask = Data[ReadOffset++];
+
+	for( int32 i = 0; i < ERV_Count; ++i )
+		if( ( Mask & ( 1 << i ) ) && !ReadValue( PreviousValues[i] ) )
+			return false;
+
+	OutFrame.DeltaTime = AsFloat( PreviousValues[ERV_DeltaTime] );
+	OutFrame.Sideways = AsFloat( PreviousValues[ERV_Sideways] );
+	OutFrame.Forwards = AsFloat( PreviousValues[ERV_Forwards] );
+	OutFrame.Gravity = FVector( AsFloat( PreviousValues[ERV_GravityX] ), AsFloat( PreviousValues[ERV_GravityY] ), AsFloat( PreviousValues[ERV_GravityZ] ) );
+	OutFrame.Jump = ( Mask & JumpBit ) != 0;
+	FrameCount++;
+	return true;
+}
+
+void FCubeReplay::WriteValue( const uint32 Value, uint32& Previous )
+{
+	// Small changes to a float only flip its low mantissa bits
+	WriteVarint( Value ^ Previous );
+	Previous = Value;
+}
+
+bool FCubeReplay::ReadValue( uint32& Previous )
+{
+	uint32 Delta = 0;
+
+	if( !ReadVarint( Delta ) )
+		return false;
+
+	Previous ^= Delta;
+	return true;
+}
+
+void FCubeReplay::WriteVarint( uint32 Value )
+{
+	while( Value >= 0x80 )
+	{
+		Data.Add( uint8( Value | 0x80 ) );
+		Value >>= 7;
+	}
+
+	Data.Add( uint8( Value ) );
+}
+
+bool FCubeReplay::ReadVarint( uint32& OutValue )
+{
+	OutValue = 0;
+
+	for( int32 Shift = 0; Shift < 35; Shift += 7 )
+	{
+		if( ReadOffset >= Data.Num() )
+			return false;
+
+		const auto Byte = Data[ReadOffset++];
+		OutValue |= uint32( Byte & 0x7F ) << Shift;
+
+		if( !( Byte & 0x80 ) )
+			return true;
+	}
+
+	return false;
+}
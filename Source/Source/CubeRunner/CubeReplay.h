@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "CubeReplay.generated.h"
+
+UENUM( BlueprintType )
+enum class ECubeReplayMode : uint8
+{
+	ECRM_NONE UMETA( DisplayName = "None" ),
+	ECRM_RECORD UMETA( DisplayName = "Record" ),
+	ECRM_PLAYBACK UMETA( DisplayName = "Playback" ),
+};
+
+// Inputs the player pawn received during one frame
+struct FCubeReplayFrame
+{
+	float DeltaTime = 0.0f;
+	float Sideways = 0.0f;
+	float Forwards = 0.0f;
+	FVector Gravity = FVector::ZeroVector;
+	bool Jump = false;
+};
+
+struct FCubeReplayHeader
+{
+	int32 Seed = 0;
+	int32 LevelIndex = 0;
+	bool ClassicMode = true;
+	uint8 InputMode = 0;
+	int32 SimulationRate = 60;
+};
+
+// A run's seed, level and per frame inputs. Each frame is a change mask followed by the changed values,
+// stored as the xor of their bits against the previous frame and varint encoded. Floats are kept bit exact so playback is deterministic
+class CUBERUNNER_API FCubeReplay
+{
+public:
+	void BeginRecording( const FCubeReplayHeader& NewHeader );
+	void RecordFrame( const FCubeReplayFrame& Frame );
+
+	// Writes a copy of the stream on the thread pool
+	TFuture< bool > SaveAsync( const FString& Path ) const;
+
+	bool Load( const FString& Path );
+	bool ReadFrame( FCubeReplayFrame& OutFrame );
+	void Reset();
+
+	// Moves playback back to the first frame of a loaded replay
+	void Rewind();
+
+	const FCubeReplayHeader& GetHeader() const { return Header; }
+	int32 GetFrameCount() const { return FrameCount; }
+	int32 GetSize() const { return Data.Num(); }
+
+private:
+	void WriteVarint( uint32 Value );
+	bool ReadVarint( uint32& OutValue );
+	void WriteValue( const uint32 Value, uint32& Previous );
+	bool ReadValue( uint32& Previous );
+
+	FCubeReplayHeader Header;
+	TArray< uint8 > Data;
+	int32 ReadOffset = 0;
+	int32 FramesOffset = 0;
+	int32 FrameCount = 0;
+	uint32 PreviousValues[6] = { 0 };
+};
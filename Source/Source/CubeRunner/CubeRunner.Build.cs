@@ -10,6 +10,8 @@ public class CubeRunner : ModuleRules
 
         PublicDependencyModuleNames.AddRange( new string[] { "Core", "CoreUObject", "Engine", "InputCore", "OnlineSubsystem" } );
 
+        PrivateDependencyModuleNames.AddRange( new string[] { "AssetRegistry" } );
+
         DynamicallyLoadedModuleNames.Add( "OnlineSubsystemNull" );
 
         if( Target.Platform == UnrealTargetPlatform.IOS )
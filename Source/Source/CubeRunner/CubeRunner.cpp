@@ -3,3 +3,5 @@
 #include "CubeRunner.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, CubeRunner, "CubeRunner" );
+
+DEFINE_LOG_CATEGORY( LogCubeBenchmark );
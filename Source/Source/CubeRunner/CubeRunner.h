@@ -2,4 +2,9 @@
 
 #pragma once
 
-#include "CoreMinimal.h"
\ No newline at end of file
+#include "CoreMinimal.h"
+
+DECLARE_STATS_GROUP( TEXT( "CubeRunner" ), STATGROUP_CubeRunner, STATCAT_Advanced );
+
+// Benchmark and profiler results, always logged unlike CustomLog which depends on EnableDebugLogging
+DECLARE_LOG_CATEGORY_EXTERN( LogCubeBenchmark, Log, All );
@@ -10,16 +10,35 @@
 #include "CubeGameInstance.h"
 #include "EndLevelPawn.h"
 #include "CubeDataSingleton.h"
+#include "ObstacleInstanceManager.h"
+#include "FloorPieceProfiler.h"
+#include "CubeMemory.h"
+#include "ObstacleLayoutCache.h"
+#include "CubeCoreBridge.h"
+#include "Core/CubePieceSelection.h"
+#include "Components/BoxComponent.h"
 
 #include <functional>
-#include <random>
 #include "CubeSingletonDataLibrary.h"
 
+namespace
+{
+	TAutoConsoleVariable< float > CVarOriginRebaseDistance( TEXT( "cr.OriginRebaseDistance" ), 100000.0f, TEXT( "Distance from the world origin at which the world is shifted back under the pawn, 0 to disable" ), ECVF_Default );
+	TAutoConsoleVariable< float > CVarFloorRecentreStep( TEXT( "cr.FloorRecentreStep" ), 200.0f, TEXT( "Lateral distance the player strafes before a randomised floor piece is recentred, 0 follows every frame" ), ECVF_Default );
+	TAutoConsoleVariable< int32 > CVarObstacleLayoutLookahead( TEXT( "cr.ObstacleLayoutLookahead" ), 3, TEXT( "Queued pieces whose randomised obstacles are generated ahead of time on worker threads" ), ECVF_Default );
+	TAutoConsoleVariable< int32 > CVarFloorPiecePoolSize( TEXT( "cr.FloorPiecePoolSize" ), 4, TEXT( "Removed floor pieces kept hidden for reuse per class and variation, 0 destroys them" ), ECVF_Default );
+}
+
+DECLARE_CYCLE_STAT( TEXT( "Fast Restart" ), STAT_FastRestart, STATGROUP_CubeRunner );
+DECLARE_DWORD_COUNTER_STAT( TEXT( "Floor Pieces Reused" ), STAT_FloorPiecesReused, STATGROUP_CubeRunner );
+
 ACubeRunnerGameMode::ACubeRunnerGameMode( const FObjectInitializer& ObjectInitializer )
 	: Super( ObjectInitializer )
 	, PlayerRef( nullptr )
 	, EndlessMode( true )
+	, RunSeed( 0 )
 	, FloorPieceOverride( nullptr )
+	, FloorPieceVariationOverride( INDEX_NONE )
 	, RemovalDelay( 1 )
 	, GameProgress( 1.0f )
 	, GameProgressPerMinute( 4.0f )
@@ -29,13 +48,21 @@ ACubeRunnerGameMode::ACubeRunnerGameMode( const FObjectInitializer& ObjectInitia
 	, LevelRandomisedFloorPieceDensity( 400 )
 	, DistanceMoved( 0.0f )
 	, UpdateNewFloorPiecePosition( false )
+	, FloorRecentreStep( MAX_int32 )
 	, RepeatCount( 1 )
 	, PreSpawnedPieces( -1 )
+	, TrackNodeIndex( 0 )
+	, TrackNodesRemoved( 0 )
+	, TrackProgress( 0.0f )
+	, LastTrackLocation( FVector::ZeroVector )
+	, HasLastTrackLocation( false )
 	, ClassicMode( true )
+	, GameLevel( false )
 	, PrivateFamily( EPieceFamily::EPF_RANDOMISED )
 	, PrivateLengthRemaining( 0 )
-	, SpawnQueueRoot( nullptr )
-	, SpawnQueueCurrent( nullptr )
+	, PendingObstacleLayoutClass( nullptr )
+	, PendingObstacleLayoutSeed( 0 )
+	, ObstacleLayoutSeedCount( 0 )
 	, LevelOptionsSet( false )
 	, LevelPreSpawningEnabled( true )
 	, LevelPreSpawningCount( 0 )
@@ -43,6 +70,8 @@ ACubeRunnerGameMode::ACubeRunnerGameMode( const FObjectInitializer& ObjectInitia
 	, LevelPlayerStartSpeed( 800.0f )
 	, LevelPlayerAcceleration( 15.0f )
 	, LevelSpawnAfterFinish( true )
+	, ObstacleInstanceManager( nullptr )
+	, ResidencyTier( INDEX_NONE )
 {
 
 }
@@ -63,43 +92,16 @@ void ACubeRunnerGameMode::BeginPlay()
 
 		// Initial player spawn etc..
 		auto* GameInstance = Cast< UCubeGameInstance >( UGameplayStatics::GetGameInstance( GetWorld() ) );
+		RunSeed = GameInstance->BeginRun();
+		GameLevel = true;
+		QualityGovernor.Reset( UCubeSingletonDataLibrary::GetGameData()->QualityGovernor );
+		ApplyQualitySettings();
 		ClassicMode = GameInstance->ClassicPlayerMode;
 		const auto LevelIndex = GameInstance->LevelIndex;
 		EndlessMode = LevelIndex == -1;
 
-		FActorSpawnParameters SpawnParams;
-		SpawnParams.Name = FName( TEXT( "Player" ) );
-		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-		FTransform Transform;
-
-		// Spawn, possess, start timer
-		PlayerRef = Cast< ABasePlayerPawn >( GetWorld()->SpawnActor( ClassicMode ? ClassicPawnClass : AdvancedPawnClass, &Transform, SpawnParams ) );
-		Transform.SetLocation( FVector( 400.0f, 0.0f, PlayerRef->HoverHeight ) );
-		PlayerRef->SetActorTransform( Transform );
-
-		if( !PlayerRef )
-		{
-			UCubeSingletonDataLibrary::CustomLog( "Player Pawn failed to spawn!", LogDisplayType::Error );
+		if( !SpawnPlayerPawn() )
 			return;
-		}
-
-		UGameplayStatics::GetPlayerController( GetWorld(), 0 )->Possess( PlayerRef );
-		PlayerRef->StartTimer = 5.0f;
-
-		// Load game options
-		if( !GameInstance->LoadCustomValue( "PlayerTiltSensitivity", PlayerRef->RotationRateSensitivity ) )
-			UCubeSingletonDataLibrary::CustomLog( "RotationRateSensitivity value failed to load!", LogDisplayType::Error );
-
-		if( UGameplayStatics::GetPlatformName() == "Android" || UGameplayStatics::GetPlatformName() == "IOS" )
-		{
-			bool MobileRotation = false;
-			if( !GameInstance->LoadCustomBool( "MobileRotationInput", MobileRotation ) )
-				UCubeSingletonDataLibrary::CustomLog( "RotationRateSensitivity value failed to load!", LogDisplayType::Error );
-
-			PlayerRef->SetInputMode( MobileRotation ? EInputMode::EIM_GYROSCOPIC : EInputMode::EIM_SCREEN_BUTTONS );
-		}
-		else
-			PlayerRef->SetInputMode( EInputMode::EIM_KEYBOARD );
 
 		// Registry	
 		RegisterFloorPieceFamilies();
@@ -113,29 +115,23 @@ void ACubeRunnerGameMode::BeginPlay()
 		}
 		else 
 			UCubeSingletonDataLibrary::CustomLog( "Endless Mode Started", LogDisplayType::Gameplay );
+
+#if WITH_EDITOR
+		// Flags level manifests that no longer match what the level can spawn, see cr.SaveLevelManifests
+		TSet< UClass* > LevelPieceClasses;
+		GatherLevelPieceClasses( LevelPieceClasses );
+		DataSingleton->GenerateLevelManifest( ClassicMode, LevelIndex, LevelPieceClasses );
+#endif
+
+		// Stream this level's assets ahead of the rest of the preload set
+		DataSingleton->PreloadLevel( ClassicMode, LevelIndex );
 	}
 
 	// BP BeginPlay
 	ReceiveBeginPlay();
 
-	// Load level options
-	if( LevelOptionsSet )
-	{
-		PlayerRef->SetSpeed( LevelPlayerStartSpeed );
-		PlayerRef->ForwardSpeedIncrease = LevelPlayerAcceleration;
-
-		if( LevelPlayerStartTransform.GetLocation() != FVector( 0.0f, 0.0f, 0.0f ) )
-			PlayerRef->SetActorTransform( LevelPlayerStartTransform );
-
-		PlayerRef->AddActorWorldOffset( LevelStartLocation );
-	}
-
-	// First piece is always a randomised cube field
 	if( EndlessMode )
 	{
-		SpawnQueueCurrent = nullptr;
-		SpawnFloorPiece( FTransform( ), UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass );
-		
 		// Normalise probabilities
 		TArray< float > TotalWeights;
 		TotalWeights.SetNum( 10 );
@@ -154,18 +150,88 @@ void ACubeRunnerGameMode::BeginPlay()
 		// This sorts the array by difficulty (by overriding the FFloorPieceType struct < operator)
 		FloorPieceBPClasses.Sort();
 	}
+
+	StartTrack();
+}
+
+bool ACubeRunnerGameMode::SpawnPlayerPawn()
+{
+	auto* GameInstance = Cast< UCubeGameInstance >( UGameplayStatics::GetGameInstance( GetWorld() ) );
+	auto* PawnClass = ClassicMode ? ClassicPawnClass : AdvancedPawnClass;
+
+	// A pawn destroyed by a fast restart keeps its name until it is garbage collected
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Name = MakeUniqueObjectName( GetWorld()->GetCurrentLevel(), PawnClass, FName( TEXT( "Player" ) ) );
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	FTransform Transform;
+
+	// Spawn, possess, start timer
+	PlayerRef = Cast< ABasePlayerPawn >( GetWorld()->SpawnActor( PawnClass, &Transform, SpawnParams ) );
+
+	if( !PlayerRef )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Player Pawn failed to spawn!", LogDisplayType::Error );
+		return false;
+	}
+
+	Transform.SetLocation( FVector( 400.0f, 0.0f, PlayerRef->HoverHeight ) );
+	PlayerRef->SetActorTransform( Transform );
+
+	UGameplayStatics::GetPlayerController( GetWorld(), 0 )->Possess( PlayerRef );
+	PlayerRef->StartTimer = 5.0f;
+
+	// Load game options
+	if( !GameInstance->LoadCustomValue( "PlayerTiltSensitivity", PlayerRef->RotationRateSensitivity ) )
+		UCubeSingletonDataLibrary::CustomLog( "RotationRateSensitivity value failed to load!", LogDisplayType::Error );
+
+	if( UGameplayStatics::GetPlatformName() == "Android" || UGameplayStatics::GetPlatformName() == "IOS" )
+	{
+		bool MobileRotation = false;
+		if( !GameInstance->LoadCustomBool( "MobileRotationInput", MobileRotation ) )
+			UCubeSingletonDataLibrary::CustomLog( "RotationRateSensitivity value failed to load!", LogDisplayType::Error );
+
+		PlayerRef->SetInputMode( MobileRotation ? EInputMode::EIM_GYROSCOPIC : EInputMode::EIM_SCREEN_BUTTONS );
+	}
+	else
+		PlayerRef->SetInputMode( EInputMode::EIM_KEYBOARD );
+
+	GameInstance->StartReplay( PlayerRef );
+	return true;
+}
+
+void ACubeRunnerGameMode::StartTrack()
+{
+	// Load level options
+	if( LevelOptionsSet )
+	{
+		PlayerRef->SetSpeed( LevelPlayerStartSpeed );
+		PlayerRef->ForwardSpeedIncrease = LevelPlayerAcceleration;
+
+		if( LevelPlayerStartTransform.GetLocation() != FVector( 0.0f, 0.0f, 0.0f ) )
+			PlayerRef->SetActorTransform( LevelPlayerStartTransform );
+
+		PlayerRef->AddActorWorldOffset( LevelStartLocation );
+		PlayerRef->ResetSimulationInterpolation();
+	}
+
+	// First piece is always a randomised cube field
+	if( EndlessMode )
+	{
+		SpawnQueue.ClearCursor();
+		SpawnFloorPiece( FTransform( ), UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass );
+	}
 	else
 	{
 		// Queue the end piece
-		SpawnQueueCurrent = nullptr;
+		SpawnQueue.ClearCursor();
 
 		// Pre spawn pieces if required
-		while( SpawnQueueRoot )
+		while( SpawnQueue.Root() )
 		{
 			FTransform Transform;
 
 			if( FloorPieceArray.Num() )
-				Transform = FloorPieceArray.Last()->ConnectionPoint->GetComponentTransform();
+				Transform = FloorPieceArray.Last()->GetConnectionTransform();
 			else
 				Transform.SetLocation( LevelStartLocation );
 
@@ -174,13 +240,16 @@ void ACubeRunnerGameMode::BeginPlay()
 			if( !IsValid( Cast< ABaseTransitionFloorPiece >( FloorPieceArray.Last() ) ) )
 				PreSpawnedPieces++;
 
-			if( !SpawnQueueRoot || SpawnQueueRoot->PieceClass == UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass )
+			if( !SpawnQueue.Root() || SpawnQueue.Root()->PieceClass == UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass )
 				break;
 
 			if( !LevelPreSpawningEnabled || ( LevelPreSpawningCount && PreSpawnedPieces >= ( LevelPreSpawningCount - 1 ) ) )
 				break;
 		}
 	}
+
+	if( PlayerRef )
+		UpdatePieceResidency();
 }
 
 void ACubeRunnerGameMode::Tick( float DeltaTime )
@@ -190,6 +259,21 @@ void ACubeRunnerGameMode::Tick( float DeltaTime )
 	// Advance the game (slowly spawns higher difficulty pieces) - limit to 10 difficulty
 	GameProgress = FMath::Min( 10.0f, GameProgress + DeltaTime * GameProgressPerMinute / 60.0f );
 
+	// Spawning, removal, split branches and turns
+	UpdateTrackProgress();
+
+	// Keep the action near the origin so precision doesn't degrade on long runs
+	UpdateWorldOrigin();
+
+	if( QualityGovernor.Tick() )
+		ApplyQualitySettings();
+	else
+		UpdatePieceVisibility();
+
+	// A new difficulty tier brings new piece classes into reach
+	if( EndlessMode && IsValid( PlayerRef ) && int32( GameProgress ) != ResidencyTier )
+		UpdatePieceResidency();
+
 	// This handles updating the new floor peice position so that it stays within a certain range of the player (sideways movement)
 	// Used for randomised cube field floor piece where there is infinite sideways movement
 	if( UpdateNewFloorPiecePosition && IsValid( PlayerRef ) )
@@ -208,13 +292,378 @@ void ACubeRunnerGameMode::Tick( float DeltaTime )
 			auto AlignedRightVector = FVector( PlayerRef->GetActorRightVector().X, PlayerRef->GetActorRightVector().Y, 0.0f );
 			auto Dist = FVector::DotProduct( ( PlayerRef->GetActorLocation() - FloorPiece2->FloorMesh->GetComponentLocation() ), AlignedRightVector );
 
-			auto Pos = FloorPiece2->FloorMesh->GetComponentLocation();
-			auto XOffset = FloorPiece2->GetActorForwardVector() * FloorPiece2->FloorMesh->GetRelativeLocation().X * 2.0f;
-			auto RightOffset = AlignedRightVector * Dist;
+			// Snap to whole steps so the piece only moves when the player crosses a step boundary
+			const auto StepSize = CVarFloorRecentreStep.GetValueOnGameThread();
+			const auto Step = StepSize > 0.0f ? FMath::RoundToInt( Dist / StepSize ) : 0;
+
+			if( StepSize > 0.0f )
+				Dist = Step * StepSize;
+
+			if( StepSize <= 0.0f || Step != FloorRecentreStep )
+			{
+				FloorRecentreStep = Step;
+
+				auto Pos = FloorPiece2->FloorMesh->GetComponentLocation();
+				auto XOffset = FloorPiece2->GetActorForwardVector() * FloorPiece2->FloorMesh->GetRelativeLocation().X * 2.0f;
+				auto RightOffset = AlignedRightVector * Dist;
+
+				FloorPiece1->MoveFloor( Pos + RightOffset + XOffset, RightOffset.Size() * FMath::Sign( Dist ) );
+			}
+		}
+	}
+}
+
+void ACubeRunnerGameMode::UpdateWorldOrigin()
+{
+	const auto RebaseDistance = CVarOriginRebaseDistance.GetValueOnGameThread();
+
+	// Mid turn the pawn is following the arc, wait until it is back on a straight
+	if( RebaseDistance <= 0.0f || !IsValid( PlayerRef ) || IsValid( PlayerRef->CurrentTurnFloorPiece ) )
+		return;
+
+	const auto Location = PlayerRef->GetActorLocation();
+
+	if( FVector2D( Location ).SizeSquared() < RebaseDistance * RebaseDistance )
+		return;
+
+	// Whole units only so pieces stay on the grid LocationRounded snaps them to, the height is left alone
+	const auto Shift = FIntVector( FMath::RoundToInt( Location.X ), FMath::RoundToInt( Location.Y ), 0 );
+	UCubeSingletonDataLibrary::CustomLog( "Rebasing world origin by " + Shift.ToString() );
+	GetWorld()->SetNewWorldOrigin( GetWorld()->OriginLocation + Shift );
+}
+
+void ACubeRunnerGameMode::ApplyWorldOffset( const FVector& InOffset, bool bWorldShift )
+{
+	Super::ApplyWorldOffset( InOffset, bWorldShift );
+
+	for( auto& Node : TrackNodes )
+	{
+		Node.Entry.Point += InOffset;
+		Node.Exit.Point += InOffset;
+		Node.Trigger.Point += InOffset;
+		Node.TurnStart.Point += InOffset;
+		Node.FloorEnd.Point += InOffset;
+	}
+
+	TrackCentreline.ApplyWorldOffset( InOffset );
+	LastTrackLocation += InOffset;
+	LevelStartLocation += InOffset;
+	LevelPlayerStartTransform.AddToTranslation( InOffset );
+}
+
+void ACubeRunnerGameMode::ApplyQualitySettings()
+{
+	GetObstacleInstanceManager()->SetCullDistance( QualityGovernor.GetCullDistance() );
+	UpdatePieceVisibility();
+}
+
+void ACubeRunnerGameMode::UpdatePieceVisibility()
+{
+	// Pieces further ahead still spawn as normal, they are always shown again before the pawn can reach them
+	const auto LastVisible = TrackNodeIndex + QualityGovernor.GetVisiblePieces();
+
+	for( int32 i = 0; i < TrackNodes.Num(); ++i )
+	{
+		auto* Piece = TrackNodes[ i ].Piece;
+		const bool Hidden = i > LastVisible;
+
+		if( IsValid( Piece ) && Piece->IsHidden() != Hidden )
+		{
+			Piece->SetActorHiddenInGame( Hidden );
+			Piece->SetInstancedObstaclesHidden( Hidden );
+		}
+	}
+}
+
+void ACubeRunnerGameMode::GatherLevelPieceClasses( TSet< UClass* >& OutClasses, const bool ReachableOnly /*= false*/ ) const
+{
+	if( ReachableOnly )
+	{
+		for( auto* Piece : FloorPieceArray )
+			if( IsValid( Piece ) )
+				OutClasses.Add( Piece->GetClass() );
+	}
+
+	if( EndlessMode )
+	{
+		// Pieces are picked between the minimum difficulty and the current progress, keep one tier of lookahead
+		const int32 MaxDifficulty = FloorPieceBPClasses.Num() ? FloorPieceBPClasses[ 0 ].Difficulty + int32( GameProgress ) : 0;
+
+		for( auto& PieceType : FloorPieceBPClasses )
+			if( !ReachableOnly || PieceType.Difficulty <= MaxDifficulty )
+				OutClasses.Add( PieceType.FloorPieceBPClass );
+
+		OutClasses.Add( UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass );
+	}
+	else
+	{
+		TArray< const FSpawnQueueItem* > PendingItems;
+
+		if( SpawnQueue.Root() )
+			PendingItems.Add( SpawnQueue.Root() );
+
+		while( PendingItems.Num() )
+		{
+			const auto* Item = PendingItems.Pop( false );
+			OutClasses.Add( Item->PieceClass );
+
+			for( const auto* NextItem : Item->NextQueueItems )
+				if( NextItem )
+					PendingItems.Add( NextItem );
+		}
+	}
+
+	// Transition pieces of every family that can show up
+	const auto PieceClasses = OutClasses.Array();
+
+	for( auto* Class : PieceClasses )
+	{
+		const auto* Piece = Class ? Cast< ABaseFloorPiece >( Class->GetDefaultObject() ) : nullptr;
+		const auto* Family = Piece ? PieceFamilyData.Find( Piece->PieceFamily ) : nullptr;
+
+		if( Family )
+		{
+			OutClasses.Add( Family->StartTransitionPiece );
+			OutClasses.Add( Family->EndTransitionPiece );
+		}
+	}
+
+	OutClasses.Remove( nullptr );
+}
+
+void ACubeRunnerGameMode::UpdatePieceResidency()
+{
+	ResidencyTier = int32( GameProgress );
+
+	if( !UCubeSingletonDataLibrary::GetGameData()->EnablePieceResidency )
+		return;
+
+	// Only called at level start and on a new difficulty tier, the reachable set doesn't change in between
+	TSet< UClass* > ReachableClasses;
+	GatherLevelPieceClasses( ReachableClasses, true );
+
+	UCubeSingletonDataLibrary::GetSingletonGameData()->UpdatePieceResidency( ReachableClasses );
+
+	// Pooled pieces would keep classes we can no longer reach resident
+	for( auto It = FloorPiecePool.CreateIterator(); It; ++It )
+	{
+		if( ReachableClasses.Contains( It->Key.Key ) )
+			continue;
+
+		for( auto* Piece : It->Value )
+			if( IsValid( Piece ) )
+				Piece->Destroy();
+
+		It.RemoveCurrent();
+	}
+}
+
+void ACubeRunnerGameMode::AddTrackNode( ABaseFloorPiece* Piece )
+{
+	// Marker on the near or far face of a box along the given direction
+	const auto BoxMarker = []( const UPrimitiveComponent* Box, const FVector& Direction, const bool FarSide )
+	{
+		const auto& Extent = Box->Bounds.BoxExtent;
+		const auto Reach = FMath::Abs( Extent.X * Direction.X ) + FMath::Abs( Extent.Y * Direction.Y ) + FMath::Abs( Extent.Z * Direction.Z );
+		return FTrackMarker( Box->Bounds.Origin + Direction * ( FarSide ? Reach : -Reach ), Direction );
+	};
+
+	FTrackNode Node;
+	Node.Piece = Piece;
+	Node.Entry = FTrackMarker( Piece->GetActorLocation(), Piece->GetActorForwardVector() );
+	const auto Connection = Piece->GetConnectionTransform();
+	Node.Exit = FTrackMarker( Connection.GetLocation(), Connection.GetUnitAxis( EAxis::X ) );
+	Node.Trigger = BoxMarker( Piece->SpawnCollison, Node.Entry.Normal, false );
+
+	if( auto* TurnPiece = Cast< ABaseTurnFloorPiece >( Piece ) )
+	{
+		Node.TurnPiece = TurnPiece;
+		Node.TurnStart = BoxMarker( TurnPiece->TurnZone, Node.Entry.Normal, false );
+	}
+
+	if( auto* RandomisedPiece = Cast< ABaseRandomisedFloorPiece >( Piece ) )
+	{
+		Node.HasFloorEnd = true;
+		Node.FloorEnd = BoxMarker( RandomisedPiece->EndCollision, Node.Entry.Normal, true );
+	}
+
+	TrackNodes.Add( Node );
+	TrackCentreline.AddPiece( Piece );
+}
+
+void ACubeRunnerGameMode::RemoveTrackNode( ABaseFloorPiece* Piece )
+{
+	TrackCentreline.RemovePiece( Piece );
+
+	const auto Index = TrackNodes.IndexOfByPredicate( [Piece]( const FTrackNode& Node ) { return Node.Piece == Piece; } );
+
+	if( Index == INDEX_NONE )
+		return;
+
+	TrackNodes.RemoveAt( Index );
+	TrackNodesRemoved++;
+
+	if( Index < TrackNodeIndex )
+		TrackNodeIndex--;
+}
+
+float ACubeRunnerGameMode::FindTrackDistance( const FVector& Location ) const
+{
+	return TrackCentreline.FindNearestDistance( Location );
+}
+
+float ACubeRunnerGameMode::FindTrackLateralOffset( const FVector& Location ) const
+{
+	float LateralOffset = 0.0f;
+	TrackCentreline.FindNearestDistance( Location, &LateralOffset );
+	return LateralOffset;
+}
+
+FTransform ACubeRunnerGameMode::GetTrackTransformAtDistance( const float Distance ) const
+{
+	return TrackCentreline.GetTransformAtDistance( Distance );
+}
+
+ABaseFloorPiece* ACubeRunnerGameMode::GetTrackPieceAtDistance( const float Distance ) const
+{
+	return TrackCentreline.GetPieceAtDistance( Distance );
+}
+
+void ACubeRunnerGameMode::UpdateTrackProgress()
+{
+	if( !IsValid( PlayerRef ) )
+		return;
+
+	const auto Location = PlayerRef->GetActorLocation();
+	const auto PreviousLocation = HasLastTrackLocation ? LastTrackLocation : Location;
+	LastTrackLocation = Location;
+	HasLastTrackLocation = true;
+
+	// Walk every node reached this frame so nothing is skipped at high speed
+	// Events can spawn or remove pieces, so the current node is looked up again after each one
+	while( TrackNodes.IsValidIndex( TrackNodeIndex ) )
+	{
+		if( ProcessTrackEvent( PreviousLocation, Location ) )
+			continue;
+
+		if( !TrackNodes[ TrackNodeIndex ].Exit.HasPassed( Location ) )
+			break;
+
+		TrackNodeIndex++;
+	}
+
+	const auto NodeProgress = TrackNodes.IsValidIndex( TrackNodeIndex ) ? FMath::Clamp( TrackNodes[ TrackNodeIndex ].GetProgress( Location ), 0.0f, 1.0f ) : 0.0f;
+	TrackProgress = TrackNodesRemoved + TrackNodeIndex + NodeProgress;
+}
+
+bool ACubeRunnerGameMode::ProcessTrackEvent( const FVector& PreviousLocation, const FVector& Location )
+{
+	auto& Node = TrackNodes[ TrackNodeIndex ];
+	auto* Piece = Node.Piece;
+
+	if( !IsValid( Piece ) )
+		return false;
+
+	// Turns
+	if( Node.TurnPiece )
+	{
+		if( !Node.TurnStarted && PlayerRef->IsAlive && Node.TurnStart.HasPassed( Location ) )
+		{
+			Node.TurnStarted = true;
+			PlayerRef->EnterTurnPiece( Node.TurnPiece );
+			return true;
+		}
+
+		if( Node.TurnStarted && !Node.TurnFinished && ( Node.TurnPiece->IsTurnComplete() || Node.Exit.HasPassed( Location ) ) )
+		{
+			Node.TurnFinished = true;
+			PlayerRef->ExitTurnPiece( Node.TurnPiece );
+			return true;
+		}
+	}
+
+	// Randomised pieces stop following the player sideways once they have left it
+	if( Node.HasFloorEnd && !Node.FloorEndPassed && Node.FloorEnd.HasPassed( Location ) )
+	{
+		Node.FloorEndPassed = true;
+		UpdateNewFloorPiecePosition = false;
+		return true;
+	}
+
+	if( Node.Triggered || !PlayerRef->IsAlive )
+		return false;
+
+	// Split pieces follow whichever branch the pawn drives into, the movement since the last update is
+	// swept through each branch box as a fast pawn can cross one between updates
+	if( Piece->MultiConnections.Num() > 1 )
+	{
+		for( int32 i = 0; i < Piece->MultiConnections.Num(); ++i )
+		{
+			const auto* Collider = Piece->MultiConnections[ i ].Collider;
+
+			if( !Collider )
+				continue;
+
+			// Only the footprint matters, height is flattened out
+			const auto& ColliderTransform = Collider->GetComponentTransform();
+			const auto LocalStart = ColliderTransform.InverseTransformPosition( PreviousLocation ) * FVector( 1.0f, 1.0f, 0.0f );
+			const auto LocalEnd = ColliderTransform.InverseTransformPosition( Location ) * FVector( 1.0f, 1.0f, 0.0f );
+			const auto Extent = Collider->GetUnscaledBoxExtent();
+			const FBox Footprint( FVector( -Extent.X, -Extent.Y, -1.0f ), FVector( Extent.X, Extent.Y, 1.0f ) );
 
-			FloorPiece1->MoveFloor( Pos + RightOffset + XOffset, RightOffset.Size() * FMath::Sign( Dist ) );
+			if( FMath::LineBoxIntersection( Footprint, LocalStart, LocalEnd, LocalEnd - LocalStart ) )
+			{
+				// The node now ends at this branch's connection rather than the first one
+				const auto Connection = Piece->GetMultiConnectionTransform( i );
+				Node.Exit = FTrackMarker( Connection.GetLocation(), Connection.GetUnitAxis( EAxis::X ) );
+				Node.Triggered = true;
+				SpawnQueue.SelectBranch( i );
+				SpawnFloorPiece( Connection );
+				return true;
+			}
 		}
+
+		return false;
 	}
+
+	if( !Node.Trigger.HasPassed( Location ) )
+		return false;
+
+	Node.Triggered = true;
+	OnPieceTriggered( Piece );
+	return true;
+}
+
+void ACubeRunnerGameMode::OnPieceTriggered( ABaseFloorPiece* FloorPiece )
+{
+	FloorPiece->HasTriggered = true;
+
+	// Handle end collision
+	if( FloorPiece->EndLevelPiece )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Level Complete" );
+		GameEnd( EGameEndState::EGES_SUCCESS );
+
+		if( !LevelSpawnAfterFinish )
+			return;
+	}
+
+	// Only spawn / remove if not a transition piece
+	if( !IsValid( Cast< ABaseTransitionFloorPiece >( FloorPiece ) ) || ( !LevelSpawnTransitions && PlayerRef->HasFirstCollision ) )
+	{
+		if( PreSpawnedPieces >= 1 )
+		{
+			PreSpawnedPieces--;
+			UCubeSingletonDataLibrary::CustomLog( "ACubeRunnerGameMode | PreSpawnedPieces: " + FString::FromInt( PreSpawnedPieces ) );
+		}
+		else
+		{
+			SpawnFloorPiece( FloorPiece->GetConnectionTransform() );
+			RemoveFloorPiece();
+		}
+	}
+
+	PlayerRef->HasFirstCollision = true;
 }
 
 FVector ACubeRunnerGameMode::LocationRounded( const FVector& Loc )
@@ -242,26 +691,35 @@ void ACubeRunnerGameMode::SpawnFloorPiece( const FTransform& Transform, UClass*
 	else
 	{
 		// Find piece pseudo randomly
-		if( !SpawnQueueRoot )
+		if( !SpawnQueue.Root() )
 			FindFloorPieceToSpawn();
 
 		// Pop from front of queue and use that
-		auto* CurrentQueue = SpawnQueueRoot;
+		auto* CurrentQueue = SpawnQueue.Root();
 		FloorPieceType = CurrentQueue->PieceClass;
 
+		PendingObstacleLayout = MoveTemp( CurrentQueue->ObstacleLayout );
+		PendingObstacleLayoutClass = FloorPieceType;
+		PendingObstacleLayoutSeed = CurrentQueue->LayoutSeed;
+
 		// Spawn
 		auto* NewPiece = SpawnFloorPieceInternal( FloorPieceType, VariationOverride == 0 ? CurrentQueue->Variation : VariationOverride, false, Transform, true );
 
+		PendingObstacleLayout = TFuture< FRandomisedObstacleLayout >();
+		PendingObstacleLayoutClass = nullptr;
+
 		// Spawn all extra connections pieces now (split piece)
-		if( CurrentQueue->NextQueueItems.Num() > 1 )
+		if( CurrentQueue->NextQueueItems.size() > 1 )
 		{
 			//SpawnExtraConnections( NewPiece );
+			PrefetchObstacleLayouts();
 			return;
 		}
 
 		// We only move along the queue if this isn't a multi piece (this is because we don't know which path down the multi piece we are going yet)
-		SpawnQueueRoot = ( CurrentQueue->NextQueueItems.Num() ? CurrentQueue->NextQueueItems[ 0 ] : nullptr );
-		delete CurrentQueue;
+		SpawnQueue.PopFront();
+
+		PrefetchObstacleLayouts();
 	}
 
 	UCubeSingletonDataLibrary::CustomLog( "Spawning Piece: " + FloorPieceType->GetName() + " with variation: " + ( VariationOverride == -1 ? " Random" : FString::FromInt( VariationOverride ) ) );
@@ -271,11 +729,58 @@ void ACubeRunnerGameMode::SpawnFloorPiece( const FTransform& Transform, UClass*
 		( FloorPieceArray.Num() > 1 && FloorPieceArray[ FloorPieceArray.Num() - 2 ]->GetClass() == UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass ) )
 	{
 		UpdateNewFloorPiecePosition = true;
+		FloorRecentreStep = MAX_int32;
+	}
+}
+
+void ACubeRunnerGameMode::PrefetchObstacleLayouts()
+{
+	CUBE_LLM_SCOPE( SpawnQueue );
+
+	int32 Remaining = CVarObstacleLayoutLookahead.GetValueOnGameThread();
+	TArray< FSpawnQueueItem* > PendingItems;
+
+	if( SpawnQueue.Root() )
+		PendingItems.Add( SpawnQueue.Root() );
+
+	// Breadth first so both sides of a split are covered
+	for( int32 i = 0; i < PendingItems.Num() && Remaining > 0; ++i, --Remaining )
+	{
+		auto* Item = PendingItems[ i ];
+
+		if( Item->PieceClass && Item->PieceClass->IsChildOf< ABaseRandomisedFloorPiece >() && !Item->ObstacleLayout.IsValid() )
+			Item->ObstacleLayout = ABaseRandomisedFloorPiece::GenerateLayoutAsync( Item->PieceClass, ( float )LevelRandomisedFloorPieceDensity, Item->LayoutSeed );
+
+		for( auto* NextItem : Item->NextQueueItems )
+			if( NextItem )
+				PendingItems.Add( NextItem );
 	}
 }
 
+int32 ACubeRunnerGameMode::MakeObstacleLayoutSeed()
+{
+	// Handed out in queue order, which only depends on the run seed
+	return ( int32 )HashCombine( GetTypeHash( RunSeed ), GetTypeHash( ObstacleLayoutSeedCount++ ) );
+}
+
+TFuture< FRandomisedObstacleLayout > ACubeRunnerGameMode::TakeObstacleLayout( UClass* PieceClass, int32& OutSeed )
+{
+	// Pieces spawned outside the queue still get a seed from the run
+	if( !PieceClass || PieceClass != PendingObstacleLayoutClass )
+	{
+		OutSeed = MakeObstacleLayoutSeed();
+		return TFuture< FRandomisedObstacleLayout >();
+	}
+
+	OutSeed = PendingObstacleLayoutSeed;
+	PendingObstacleLayoutClass = nullptr;
+	return MoveTemp( PendingObstacleLayout );
+}
+
 ABaseFloorPiece* ACubeRunnerGameMode::SpawnFloorPieceInternal( UClass* PieceClass, int32 PieceVariation, bool TransitionPiece, const FTransform& Transform, const bool AddToArray )
 {
+	CUBE_LLM_SCOPE( FloorPieces );
+
 	const auto* DataSingleton = Cast<UCubeDataSingleton>( GEngine->GameSingleton );
 
 	//-----------------------------------------------------------
@@ -284,20 +789,48 @@ ABaseFloorPiece* ACubeRunnerGameMode::SpawnFloorPieceInternal( UClass* PieceClas
 	PieceTransform.SetScale3D( FVector( 1.0f, 1.0f, 1.0f ) );
 	PieceTransform.SetLocation( LocationRounded( Transform.GetLocation() ) );
 
-	//auto NewPiece = Cast< ABaseFloorPiece >( GetWorld()->SpawnActor( PieceClass, &PieceTransform ) );	
-	// Deffer so we can set the variation BEFORE the construction script gets called for the piece
-	auto NewPiece = Cast< ABaseFloorPiece >( UGameplayStatics::BeginDeferredActorSpawnFromClass( this, PieceClass, PieceTransform, ESpawnActorCollisionHandlingMethod::AlwaysSpawn ) );
-	//NewPiece->SetActorTransform( PieceTransform );
-	if( !IsValid( NewPiece ) )
+	const auto* Defaults = PieceClass ? Cast< ABaseFloorPiece >( PieceClass->GetDefaultObject() ) : nullptr;
+
+	if( !Defaults )
 	{
 		UCubeSingletonDataLibrary::CustomLog( "Spawning floor piece failed! Class: " + ( PieceClass != nullptr ? PieceClass->GetName() : "nullptr" ), LogDisplayType::Error );
 		return nullptr;
 	}
 
-	//NewPiece->AddActorLocalOffset( -NewPiece->RootDir->GetRelativeTransform().GetLocation() );
-	//PieceTransform.AddToTranslation( -NewPiece->RootDir->GetRelativeTransform().GetLocation() );
-	NewPiece->Variation = PieceVariation == -1 ? FMath::RandRange( 0, ClassicMode ? NewPiece->MaxVariationClassic : NewPiece->MaxVariationAdvanced ) : PieceVariation;
-	UGameplayStatics::FinishSpawningActor( NewPiece, PieceTransform );
+	FFloorPieceProfiler::FScopedSpawn ProfileScope;
+	double ConstructionSeconds = 0.0;
+
+	// Transition pieces keep their own variation
+	if( FloorPieceVariationOverride != INDEX_NONE && !TransitionPiece )
+		PieceVariation = FloorPieceVariationOverride;
+
+	// The variation has to be known up front to find a pooled piece
+	const auto SpawnVariation = PieceVariation == -1 ? FMath::RandRange( 0, ClassicMode ? Defaults->MaxVariationClassic : Defaults->MaxVariationAdvanced ) : PieceVariation;
+	auto NewPiece = AcquireFloorPiece( PieceClass, SpawnVariation );
+	const bool Reused = NewPiece != nullptr;
+
+	if( !Reused )
+	{
+		//auto NewPiece = Cast< ABaseFloorPiece >( GetWorld()->SpawnActor( PieceClass, &PieceTransform ) );	
+		// Deffer so we can set the variation BEFORE the construction script gets called for the piece
+		NewPiece = Cast< ABaseFloorPiece >( UGameplayStatics::BeginDeferredActorSpawnFromClass( this, PieceClass, PieceTransform, ESpawnActorCollisionHandlingMethod::AlwaysSpawn ) );
+		//NewPiece->SetActorTransform( PieceTransform );
+		if( !IsValid( NewPiece ) )
+		{
+			UCubeSingletonDataLibrary::CustomLog( "Spawning floor piece failed! Class: " + PieceClass->GetName(), LogDisplayType::Error );
+			return nullptr;
+		}
+
+		//NewPiece->AddActorLocalOffset( -NewPiece->RootDir->GetRelativeTransform().GetLocation() );
+		//PieceTransform.AddToTranslation( -NewPiece->RootDir->GetRelativeTransform().GetLocation() );
+		NewPiece->Variation = SpawnVariation;
+
+		// Runs the construction script
+		const auto ConstructionStart = FPlatformTime::Seconds();
+		UGameplayStatics::FinishSpawningActor( NewPiece, PieceTransform );
+		ConstructionSeconds = FPlatformTime::Seconds() - ConstructionStart;
+	}
+
 	NewPiece->SetActorTransform( PieceTransform );
 	//--------------------------------------------------------------
 
@@ -321,11 +854,11 @@ ABaseFloorPiece* ACubeRunnerGameMode::SpawnFloorPieceInternal( UClass* PieceClas
 			if( PreviousPieceData.EndTransitionPiece != nullptr && DifferingFamily )
 			{
 				// Spawn it
-				SpawnFloorPieceInternal( PreviousPieceData.EndTransitionPiece, 0, true, FloorPieceArray.Last()->ConnectionPoint->GetComponentTransform(), true );
+				SpawnFloorPieceInternal( PreviousPieceData.EndTransitionPiece, 0, true, FloorPieceArray.Last()->GetConnectionTransform(), true );
 				UCubeSingletonDataLibrary::CustomLog( "Spawning end transition piece: " + PreviousPieceData.EndTransitionPiece->GetName() );
 
 				// Update the transform of the new main piece (needs to be "pushed forward")
-				FTransform UpdatedPieceTransform = FloorPieceArray.Last()->ConnectionPoint->GetComponentTransform();
+				FTransform UpdatedPieceTransform = FloorPieceArray.Last()->GetConnectionTransform();
 				UpdatedPieceTransform.SetScale3D( FVector( 1.0f, 1.0f, 1.0f ) );
 				UpdatedPieceTransform.SetLocation( LocationRounded( UpdatedPieceTransform.GetLocation() ) );
 				NewPiece->SetActorTransform( UpdatedPieceTransform );
@@ -352,14 +885,14 @@ ABaseFloorPiece* ACubeRunnerGameMode::SpawnFloorPieceInternal( UClass* PieceClas
 
 				// Must check this because it can be spawned as the first piece (which will use a default transform)
 				if ( FloorPieceArray.Num() )
-					NewTransform = FloorPieceArray.Last()->ConnectionPoint->GetComponentTransform();
+					NewTransform = FloorPieceArray.Last()->GetConnectionTransform();
 
 				// Spawn it
 				SpawnFloorPieceInternal( NewPieceData->StartTransitionPiece, 0, true, NewTransform, true );
 				UCubeSingletonDataLibrary::CustomLog( "Spawning start transition piece: " + NewPieceData->StartTransitionPiece->GetName() );
 
 				// Update the main floor piece with new transform (changed because of the spawned start transition piece)
-				FTransform UpdatedPieceTransform = FloorPieceArray.Last()->ConnectionPoint->GetComponentTransform();
+				FTransform UpdatedPieceTransform = FloorPieceArray.Last()->GetConnectionTransform();
 				UpdatedPieceTransform.SetScale3D( FVector( 1.0f, 1.0f, 1.0f ) );
 				UpdatedPieceTransform.SetLocation( LocationRounded( UpdatedPieceTransform.GetLocation() ) );
 				NewPiece->SetActorTransform( UpdatedPieceTransform );
@@ -384,18 +917,28 @@ ABaseFloorPiece* ACubeRunnerGameMode::SpawnFloorPieceInternal( UClass* PieceClas
 	}
 
 	// Custom begin play 
-	Cast< ABaseFloorPiece >( NewPiece )->FloorPieceBeginPlay();
+	if( Reused )
+		NewPiece->FloorPieceReused();
+	else
+		NewPiece->FloorPieceBeginPlay();
+
+	ProfileScope.Finish( NewPiece, Reused, ConstructionSeconds );
 
 	// Add the piece to the spawned pieces array
 	if( AddToArray )
+	{
 		FloorPieceArray.Add( NewPiece );
+		AddTrackNode( NewPiece );
+	}
 
 	return NewPiece;
 }
 
 void ACubeRunnerGameMode::SpawnExtraConnections( ABaseFloorPiece* BaseMultiPiece )
 {
-	for( int32 i = 0; i < SpawnQueueRoot->NextQueueItems.Num(); ++i )
+	const auto& NextQueueItems = SpawnQueue.Root()->NextQueueItems;
+
+	for( int32 i = 0; i < ( int32 )NextQueueItems.size(); ++i )
 	{
 		if( i > BaseMultiPiece->MultiConnections.Num() )
 		{
@@ -403,42 +946,30 @@ void ACubeRunnerGameMode::SpawnExtraConnections( ABaseFloorPiece* BaseMultiPiece
 			break;
 		}
 
-		const auto& item = *SpawnQueueRoot->NextQueueItems[i];
-		auto* ExtraPiece = SpawnFloorPieceInternal( item.PieceClass, item.Variation, false, BaseMultiPiece->MultiConnections[i].ConnectionPoint->GetComponentTransform(), false );
+		const auto& item = *NextQueueItems[i];
+		auto* ExtraPiece = SpawnFloorPieceInternal( item.PieceClass, item.Variation, false, BaseMultiPiece->GetMultiConnectionTransform( i ), false );
 		BaseMultiPiece->MultiConnections[i].ConnectedSpawnPiece = ExtraPiece;
 	}
 }
 
 void ACubeRunnerGameMode::MultiPieceCollision( ABaseFloorPiece* BaseMultiPiece, const int32 index )
 {
-	if( !SpawnQueueRoot )
+	if( !SpawnQueue.Root() )
 	{
 		UCubeSingletonDataLibrary::CustomLog( "CheckMultiPieceCollision: SpawnQueueRoot is not valid", LogDisplayType::Error );
 		return;
 	}
 
-	// Move the queue forwards down the correct multi piece path
-	auto* CurrentQueue = SpawnQueueRoot;
-	SpawnQueueRoot = ( index < SpawnQueueRoot->NextQueueItems.Num() ? SpawnQueueRoot->NextQueueItems[ index ] : nullptr );
+	// Move the queue forwards down the correct multi piece path, the other paths are freed
+	SpawnQueue.SelectBranch( index );
 
-	const bool NextIsMulti = SpawnQueueRoot && SpawnQueueRoot->NextQueueItems.Num() > 1;
-	SpawnQueueRoot = ( NextIsMulti ? SpawnQueueRoot : SpawnQueueRoot->NextQueueItems.Num() ? SpawnQueueRoot->NextQueueItems.Last() : nullptr );
+	// The branch's first piece was already spawned with the multi piece, unless it splits again itself
+	const bool NextIsMulti = SpawnQueue.Root() && SpawnQueue.Root()->NextQueueItems.size() > 1;
 
-	// We must delete the other possible paths now before they are lost
-	for( int32 j = 0; j < CurrentQueue->NextQueueItems.Num(); ++j )
-	{
-		if( j != index )
-		{
-			CurrentQueue->NextQueueItems[ j ]->PropagateDeletionToChildren = true;
-			delete CurrentQueue->NextQueueItems[ j ];
-			CurrentQueue->NextQueueItems[ j ] = nullptr;
-		}
-	}
+	if( !NextIsMulti )
+		SpawnQueue.PopFront();
 
-	// Delete the piece we have moved on from
-	delete CurrentQueue;
-
-	if( !SpawnQueueRoot )
+	if( !SpawnQueue.Root() )
 		UCubeSingletonDataLibrary::CustomLog( "Failed to find Multi Piece Queue info at index: " + FString::FromInt( index ), LogDisplayType::Error );
 
 	RemoveFloorPiece();
@@ -449,15 +980,12 @@ void ACubeRunnerGameMode::MultiPieceCollision( ABaseFloorPiece* BaseMultiPiece,
 
 void ACubeRunnerGameMode::FindFloorPieceToSpawn( const bool IgnoreSplitPieces /*= false*/ )
 {
-	const auto* DataSingleton = Cast<UCubeDataSingleton>( GEngine->GameSingleton );
+	FCubeCoreRandom Random;
 
-	if( ( ( RepeatCount <= 0 ) || 
-		( RepeatCount == 1 && FMath::RandRange( 0, 1 ) == 0 ) ||
-		( RepeatCount == 2 && FMath::RandRange( 0, 9 ) == 0 ) ) 
-		&& PrivateLengthRemaining == 0 )
+	if( CubeCore::ShouldQueueRandomisedRun( RepeatCount, PrivateLengthRemaining, Random ) )
 	{
 		RepeatCount++;
-		const int32 count = FMath::RandRange( 1, int32( GameProgress / 2 ) );
+		const int32 count = CubeCore::RandomisedRunLength( GameProgress, Random );
 		for( int32 i = 0; i < count; ++i )
 			QueuePiece( UCubeSingletonDataLibrary::GetGameData()->RandomisedFloorPieceBPClass );
 		return;
@@ -497,89 +1025,49 @@ void ACubeRunnerGameMode::FindFloorPieceToSpawn( const bool IgnoreSplitPieces /*
 	UCubeSingletonDataLibrary::CustomLog( "Valid floor pieces found: " + FString::FromInt( ValidFloorPieceBPClasses.Num() ) );
 
 	RepeatCount = 0;
-	const int32 Min = ValidFloorPieceBPClasses[ 0 ].Difficulty;
-	const int32 Max = ValidFloorPieceBPClasses[ ValidFloorPieceBPClasses.Num() - 1 ].Difficulty;
-	const int32 Range = Max - Min;
+	TArray< CubeCore::PieceCandidate > Candidates;
+	Candidates.Reserve( ValidFloorPieceBPClasses.Num() );
 
-	UCubeSingletonDataLibrary::CustomLog( "Min Difficulty: " + FString::FromInt( Min ) );
-	UCubeSingletonDataLibrary::CustomLog( "Max Difficulty: " + FString::FromInt( Max ) );
-	UCubeSingletonDataLibrary::CustomLog( "Progress: " + FString::SanitizeFloat( GameProgress ) );
+	for( const auto& PieceType : ValidFloorPieceBPClasses )
+		Candidates.Add( { PieceType.Difficulty, PieceType.Probability } );
 
-	std::default_random_engine generator;
-	std::normal_distribution< double > distribution( double( GameProgress ), double( Range / 3.0 ) );
+	UCubeSingletonDataLibrary::CustomLog( "Min Difficulty: " + FString::FromInt( Candidates[ 0 ].Difficulty ) );
+	UCubeSingletonDataLibrary::CustomLog( "Max Difficulty: " + FString::FromInt( Candidates.Last().Difficulty ) );
+	UCubeSingletonDataLibrary::CustomLog( "Progress: " + FString::SanitizeFloat( GameProgress ) );
 
-	int32 Safety = 0;
+	// Difficulty roll and weighted pick happen in the core, only the queueing is done here
+	const auto Selection = CubeCore::SelectPieceByDifficulty( Candidates.GetData(), Candidates.Num(), GameProgress, Random );
 
-	// Normal distribution of difficulty to find a piece appropriate	
-	while( Safety < 20 )
+	if( Selection.Result == CubeCore::PieceSelectionResult::Selected )
 	{
-		int32 DifficultyVal = 1;
+		const auto& Selected = ValidFloorPieceBPClasses[ Selection.Index ];
+		UCubeSingletonDataLibrary::CustomLog( "Difficulty selected: " + FString::FromInt( Selected.Difficulty ) );
 
-		if( !Range )
+		if( Selected.Connections <= 1 )
 		{
-			DifficultyVal = Min;
+			QueuePieceWithRandomVariation( Selected.FloorPieceBPClass );
 		}
 		else
 		{
-			// While loop to handle min / max cut offs
-			do
-			{
-				// Normal distribution around GameProgress with standard deviation of Range / 3
-				//DifficultyVal = ( int32 )distribution( generator );
-
-				// Linear distribution from min -> max
-				DifficultyVal = Min + FMath::RandHelper( FMath::Min( ( int32 )GameProgress, Range ) );
-			} 
-			while( DifficultyVal < Min || DifficultyVal > Max );
-		}
-
-		UCubeSingletonDataLibrary::CustomLog( "Difficulty selected: " + FString::FromInt( DifficultyVal ) );
-		float Random = FMath::FRand();
-		int32 Matches = 0;
-		int32 MatchIndex = 0;
+			QueuePieceSplitWithRandomVariation( Selected.FloorPieceBPClass );
 
-		// Weighted random selection from pieces that match the selected difficulty
-		for( int32 i = 0; i < ValidFloorPieceBPClasses.Num(); ++i )
-		{
-			if( ValidFloorPieceBPClasses[ i ].Difficulty == DifficultyVal )
+			// If it is a split piece, we must queue pieces for each direction
+			for( int32 j = 1; j < Selected.Connections; ++j )
 			{
-				Matches++;
-				MatchIndex = i;
-
-				if( Random < ValidFloorPieceBPClasses[ i ].Probability )
-				{
-					if( ValidFloorPieceBPClasses[ MatchIndex ].Connections <= 1 )
-					{
-						QueuePieceWithRandomVariation( ValidFloorPieceBPClasses[ i ].FloorPieceBPClass );
-					}
-					else
-					{
-						QueuePieceSplitWithRandomVariation( ValidFloorPieceBPClasses[ i ].FloorPieceBPClass );
-
-						// If it is a split piece, we must queue pieces for each direction
-						for( int32 j = 1; j < ValidFloorPieceBPClasses[ MatchIndex ].Connections; ++j )
-						{
-							FindFloorPieceToSpawn( true );
-							EndSplitPieceQueue();
-						}
-					}
-
-					return;
-				}
-				
-				Random -= ValidFloorPieceBPClasses[ i ].Probability;
+				FindFloorPieceToSpawn( true );
+				EndSplitPieceQueue();
 			}
 		}
 
-		// Matches were found but none got selected (can happen if the probabilies don't add up to 1.0)
-		if( Matches > 0 )
-		{
-			UCubeSingletonDataLibrary::CustomLog( "FindFloorPieceToSpawn: Matches found but none selected", LogDisplayType::Error );
-			QueuePiece( ValidFloorPieceBPClasses[ MatchIndex ].FloorPieceBPClass );
-			return;
-		}
+		return;
+	}
 
-		// No matches of this difficulty, try again
+	// Matches were found but none got selected (can happen if the probabilies don't add up to 1.0)
+	if( Selection.Result == CubeCore::PieceSelectionResult::Fallback )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "FindFloorPieceToSpawn: Matches found but none selected", LogDisplayType::Error );
+		QueuePiece( ValidFloorPieceBPClasses[ Selection.Index ].FloorPieceBPClass );
+		return;
 	}
 
 	// Catch any potential issues
@@ -591,8 +1079,8 @@ void ACubeRunnerGameMode::RemoveFloorPiece()
 {
 	if( FloorPieceArray.Num() > 0 && RemovalDelay == 0 )
 	{
-		FloorPieceArray[ 0 ]->Cleanup();
-		FloorPieceArray[ 0 ]->Destroy();
+		RemoveTrackNode( FloorPieceArray[ 0 ] );
+		ReleaseFloorPiece( FloorPieceArray[ 0 ] );
 		FloorPieceArray.RemoveAt( 0 );
 
 		if( FloorPieceArray.Num( ) > 0 && IsValid( Cast< ABaseTransitionFloorPiece >( FloorPieceArray[0] ) ) )
@@ -602,6 +1090,50 @@ void ACubeRunnerGameMode::RemoveFloorPiece()
 	RemovalDelay = FMath::Max( RemovalDelay - 1, 0 );
 }
 
+ABaseUpgrade* ACubeRunnerGameMode::AcquireUpgrade( const FTransform& Transform )
+{
+	while( UpgradePool.Num() )
+	{
+		auto* Upgrade = UpgradePool.Pop( false );
+
+		if( !IsValid( Upgrade ) )
+			continue;
+
+		Upgrade->SetActorTransform( Transform );
+		Upgrade->RollUpgradeType();
+		Upgrade->SetUpgradeActive( true );
+		return Upgrade;
+	}
+
+	// Placement already avoids obstacles so there is no need to collision test the spawn
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	auto* Upgrade = GetWorld()->SpawnActor< ABaseUpgrade >( UCubeSingletonDataLibrary::GetGameData()->DefaultUpgradeBPClass, Transform, SpawnParams );
+
+	if( !Upgrade )
+		UCubeSingletonDataLibrary::CustomLog( "ACubeRunnerGameMode::AcquireUpgrade | UpgradeBPClass failed to spawn", LogDisplayType::Warn );
+
+	return Upgrade;
+}
+
+AObstacleInstanceManager* ACubeRunnerGameMode::GetObstacleInstanceManager()
+{
+	if( !IsValid( ObstacleInstanceManager ) )
+		ObstacleInstanceManager = GetWorld()->SpawnActor< AObstacleInstanceManager >();
+
+	return ObstacleInstanceManager;
+}
+
+void ACubeRunnerGameMode::ReleaseUpgrade( ABaseUpgrade* Upgrade )
+{
+	if( !IsValid( Upgrade ) )
+		return;
+
+	Upgrade->SetUpgradeActive( false );
+	UpgradePool.Add( Upgrade );
+}
+
 void ACubeRunnerGameMode::GameEnd_Implementation( EGameEndState Reason )
 {
 	// Ensure we are dead!
@@ -611,6 +1143,10 @@ void ACubeRunnerGameMode::GameEnd_Implementation( EGameEndState Reason )
 	if( PlayerRef->TotalDistanceTravelled >= 10000.0f )
 		GameInstance->GamesPlayed++;
 
+	GameInstance->EndRun();
+
+	UCubeSingletonDataLibrary::GetSingletonGameData()->ReportResidency( EndlessMode ? FString( "Endless mode" ) : "Level " + FString::FromInt( GameInstance->LevelIndex ) );
+
 	if( Reason == EGameEndState::EGES_SUCCESS )
 	{
 		// Spawn end level pawn (static camera) and possess
@@ -654,12 +1190,184 @@ void ACubeRunnerGameMode::LoadMainMenu()
 
 void ACubeRunnerGameMode::TempRestartGame()
 {
+	// The menu has no run to reset so it still goes through a reload
+	if( GameLevel )
+	{
+		FastRestart();
+		return;
+	}
+
 	FName LevelName( *UGameplayStatics::GetCurrentLevelName( this, true ) );
 	UGameplayStatics::OpenLevel( this, LevelName );
 	//GetWorld()->GetFirstPlayerController()->ConsoleCommand( TEXT( "RestartLevel" ) );
 	UCubeSingletonDataLibrary::CustomLog( "Level restart" );
 }
 
+void ACubeRunnerGameMode::FastRestart()
+{
+	SCOPE_CYCLE_COUNTER( STAT_FastRestart );
+	const auto StartTime = FPlatformTime::Seconds();
+	auto* GameInstance = Cast< UCubeGameInstance >( UGameplayStatics::GetGameInstance( GetWorld() ) );
+
+	// Does nothing if the run already ended
+	GameInstance->EndRun();
+
+	// Live pieces go back to the pool, the registry, preloads and instance components are kept
+	for( auto* Piece : FloorPieceArray )
+		ReleaseFloorPiece( Piece );
+
+	FloorPieceArray.Reset();
+	TrackNodes.Reset();
+	TrackCentreline.Reset();
+	TrackNodeIndex = 0;
+	TrackNodesRemoved = 0;
+	TrackProgress = 0.0f;
+	HasLastTrackLocation = false;
+	ResetSpawnQueue();
+
+	// Level options are in the level's original space
+	if( GetWorld()->OriginLocation != FIntVector::ZeroValue )
+		GetWorld()->SetNewWorldOrigin( FIntVector::ZeroValue );
+
+	// Back to the state BeginPlay started from
+	const auto* Defaults = Cast< ACubeRunnerGameMode >( GetClass()->GetDefaultObject() );
+	GameProgress = Defaults->GameProgress;
+	RemovalDelay = Defaults->RemovalDelay;
+	RepeatCount = Defaults->RepeatCount;
+	PreSpawnedPieces = Defaults->PreSpawnedPieces;
+	PrivateFamily = Defaults->PrivateFamily;
+	PrivateLengthRemaining = Defaults->PrivateLengthRemaining;
+	DistanceMoved = 0.0f;
+	UpdateNewFloorPiecePosition = false;
+	FloorRecentreStep = MAX_int32;
+	ResidencyTier = INDEX_NONE;
+	PieceCooldownData.Empty();
+
+	GetWorldTimerManager().ClearTimer( pawn_destroy_handle );
+
+	// Completing a level leaves the controller on an end level pawn
+	auto* Controller = UGameplayStatics::GetPlayerController( GetWorld(), 0 );
+
+	if( Controller && IsValid( Controller->GetPawn() ) && Controller->GetPawn() != PlayerRef )
+		Controller->GetPawn()->Destroy();
+
+	if( IsValid( PlayerRef ) )
+		PlayerRef->Destroy();
+
+	PlayerRef = nullptr;
+
+	RunSeed = GameInstance->BeginRun();
+	QualityGovernor.Reset( UCubeSingletonDataLibrary::GetGameData()->QualityGovernor );
+	ApplyQualitySettings();
+
+	if( !SpawnPlayerPawn() )
+		return;
+
+	// Levels queue their pieces and options again
+	if( !EndlessMode )
+		ClassicMode ? LoadClassicLevel( GameInstance->LevelIndex ) : LoadAdvancedLevel( GameInstance->LevelIndex );
+
+	StartTrack();
+	OnFastRestart();
+
+	UCubeSingletonDataLibrary::CustomLog( FString::Printf( TEXT( "Fast restart took %.2fms" ), ( FPlatformTime::Seconds() - StartTime ) * 1000.0 ) );
+}
+
+void ACubeRunnerGameMode::ResetSpawnQueue()
+{
+	SpawnQueue.Reset();
+
+	PendingObstacleLayout = TFuture< FRandomisedObstacleLayout >();
+	PendingObstacleLayoutClass = nullptr;
+	ObstacleLayoutSeedCount = 0;
+}
+
+ABaseFloorPiece* ACubeRunnerGameMode::AcquireFloorPiece( UClass* PieceClass, const int32 Variation )
+{
+	auto* Pool = FloorPiecePool.Find( MakeTuple( PieceClass, Variation ) );
+
+	while( Pool && Pool->Num() )
+	{
+		auto* Piece = Pool->Pop( false );
+
+		if( !IsValid( Piece ) )
+			continue;
+
+		INC_DWORD_STAT( STAT_FloorPiecesReused );
+		return Piece;
+	}
+
+	return nullptr;
+}
+
+void ACubeRunnerGameMode::FlushFloorPiecePool()
+{
+	for( auto& Pool : FloorPiecePool )
+		for( auto* Piece : Pool.Value )
+			if( IsValid( Piece ) )
+				Piece->Destroy();
+
+	FloorPiecePool.Reset();
+}
+
+void ACubeRunnerGameMode::ReleaseCachedResources()
+{
+	FlushFloorPiecePool();
+
+	for( auto* Upgrade : UpgradePool )
+		if( IsValid( Upgrade ) )
+			Upgrade->Destroy();
+
+	UpgradePool.Empty();
+
+	TSet< UClass* > ReachableClasses;
+	GatherLevelPieceClasses( ReachableClasses, true );
+	FObstacleLayoutCache::Get().Trim( ReachableClasses );
+}
+
+int32 ACubeRunnerGameMode::GetPooledFloorPieceCount() const
+{
+	int32 Count = 0;
+
+	for( const auto& Pool : FloorPiecePool )
+		Count += Pool.Value.Num();
+
+	return Count;
+}
+
+void ACubeRunnerGameMode::ReleaseFloorPiece( ABaseFloorPiece* Piece )
+{
+	if( !IsValid( Piece ) )
+		return;
+
+	auto& Profiler = FFloorPieceProfiler::Get();
+	const auto StartTime = Profiler.IsEnabled() ? FPlatformTime::Seconds() : 0.0;
+	auto* Class = Piece->GetClass();
+	const auto PieceVariation = Piece->Variation;
+	auto Pooled = false;
+
+	if( Piece->CanBePooled() )
+	{
+		auto& Pool = FloorPiecePool.FindOrAdd( MakeTuple( Class, PieceVariation ) );
+
+		if( Pool.Num() < CVarFloorPiecePoolSize.GetValueOnGameThread() )
+		{
+			Piece->ReturnToPool();
+			Pool.Add( Piece );
+			Pooled = true;
+		}
+	}
+
+	if( !Pooled )
+	{
+		Piece->Cleanup();
+		Piece->Destroy();
+	}
+
+	if( Profiler.IsEnabled() )
+		Profiler.RecordRemoval( Class, PieceVariation, FPlatformTime::Seconds() - StartTime );
+}
+
 void ACubeRunnerGameMode::QueuePiece( UClass* Class )
 {
 	QueuePieceMultiWithVariation( Class, 1, 0 );
@@ -687,24 +1395,16 @@ void ACubeRunnerGameMode::QueuePieceMultiWithRandomVariation( UClass* Class, int
 
 void ACubeRunnerGameMode::QueuePieceMultiWithVariation( UClass* Class, int32 Count, int32 Variation )
 {
+	CUBE_LLM_SCOPE( SpawnQueue );
+
 	if( Count )
 	{
 		for( int32 i = 0; i < Count; ++i )
 		{		
-			FSpawnQueueItem* NewItem = new FSpawnQueueItem;
+			auto* NewItem = SpawnQueue.Append();
 			NewItem->PieceClass = Class;
 			NewItem->Variation = Variation;
-
-			if( !SpawnQueueRoot )
-			{			
-				SpawnQueueCurrent = NewItem;
-				SpawnQueueRoot = NewItem;
-			}
-			else
-			{
-				SpawnQueueCurrent->NextQueueItems.Add( NewItem );
-				SpawnQueueCurrent = NewItem;
-			}
+			NewItem->LayoutSeed = MakeObstacleLayoutSeed();
 		}
 	}
 }
@@ -721,41 +1421,23 @@ void ACubeRunnerGameMode::QueuePieceSplitWithRandomVariation( UClass* Class )
 
 void ACubeRunnerGameMode::QueuePieceSplitWithVariation( UClass* Class, int32 Variation )
 {
-	auto* NewItem = new FSpawnQueueItem();
+	CUBE_LLM_SCOPE( SpawnQueue );
+
+	auto* NewItem = SpawnQueue.AppendSplit();
 	NewItem->PieceClass = Class;
 	NewItem->Variation = Variation;
-	NewItem->QueueIndex = 0;
-
-	if( !SpawnQueueRoot )
-	{
-		SpawnQueueCurrent = NewItem;
-		SpawnQueueRoot = NewItem;
-	}
-	else
-	{
-		SpawnQueueCurrent->NextQueueItems.Add( NewItem );
-		SpawnQueueCurrent = NewItem;
-	}
-
-	SpawnQueueSplits.Add( SpawnQueueCurrent );
+	NewItem->LayoutSeed = MakeObstacleLayoutSeed();
 }
 
 void ACubeRunnerGameMode::EndSplitPieceQueue()
 {
-	if( SpawnQueueSplits.Num() )
-	{
-		SpawnQueueSplits.Last()->QueueIndex++;
-		SpawnQueueCurrent = SpawnQueueSplits.Last();
+	// The split closes as soon as any piece type would have no connections left
+	int32 MinConnections = MAX_int32;
 
-		for( auto& FloorPiece : FloorPieceBPClasses )
-		{
-			if( SpawnQueueSplits.Last()->QueueIndex >= FloorPiece.Connections - 1 )
-			{
-				SpawnQueueSplits.RemoveAt( SpawnQueueSplits.Num() - 1 );
-				break;
-			}
-		}
-	}
+	for( auto& FloorPiece : FloorPieceBPClasses )
+		MinConnections = FMath::Min( MinConnections, FloorPiece.Connections );
+
+	SpawnQueue.EndSplit( MinConnections );
 }
 
 void ACubeRunnerGameMode::SetLevelOptions( bool PreSpawnFloorPieces, float PlayerStartSpeed, float PlayerAcceleration, bool SpawnTransitions, FVector StartLocation, FTransform PlayerStartTransform, bool SpawnAfterFinish )
@@ -5,7 +5,13 @@
 
 #include "GameFramework/GameMode.h"
 #include "BaseFloorPiece.h"
+#include "BaseRandomisedFloorPiece.h"
 #include "BasePlayerPawn.h"
+#include "TrackCentreline.h"
+#include "CubeQualityGovernor.h"
+#include "Core/CubeSpawnQueue.h"
+#include "Core/CubeTrack.h"
+#include "CubeCoreBridge.h"
 #include "CubeRunnerGameMode.generated.h"
 
 USTRUCT( BlueprintType )
@@ -40,25 +46,52 @@ public:
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, meta = ( EditCondition = "PrivateFamily" ) ) int32 PrivateFamilyLengthMax;
 };
 
-struct FSpawnQueueItem
+struct FSpawnQueueEntry
 {
-	~FSpawnQueueItem()
-	{
-		if( PropagateDeletionToChildren )
-		{
-			for( int32 i = 0; i < NextQueueItems.Num(); ++i )
-			{
-				NextQueueItems[ i ]->PropagateDeletionToChildren = true;
-				delete NextQueueItems[ i ];
-			}
-		}
-	}
-
-	bool PropagateDeletionToChildren = false;
 	UClass* PieceClass = nullptr;
 	int32 Variation = -1;
-	int32 QueueIndex = 0;
-	TArray< FSpawnQueueItem* > NextQueueItems;
+
+	// Taken from the run seed when queued, so the layout doesn't depend on when it gets generated
+	int32 LayoutSeed = 0;
+
+	// Obstacles for a randomised piece, generated on a worker thread while it waits in the queue
+	TFuture< FRandomisedObstacleLayout > ObstacleLayout;
+};
+
+using FSpawnQueueItem = CubeCore::SpawnQueue< FSpawnQueueEntry >::Item;
+
+// Plane the pawn crosses when it reaches a point of interest along the track
+struct FTrackMarker
+{
+	FTrackMarker() {}
+	FTrackMarker( const FVector& InPoint, const FVector& InNormal ) : Point( InPoint ), Normal( InNormal.GetSafeNormal() ) {}
+
+	bool HasPassed( const FVector& Location ) const { return CubeCore::HasPassedPlane( ToCore( Location ), ToCore( Point ), ToCore( Normal ) ); }
+
+	FVector Point = FVector::ZeroVector;
+	FVector Normal = FVector::ForwardVector;
+};
+
+// One floor piece in the ordered chain the pawn travels along
+struct FTrackNode
+{
+	// 0 at the piece's entry and 1 at its connection point
+	float GetProgress( const FVector& Location ) const { return CubeCore::TrackProgress( ToCore( Location ), ToCore( Entry.Point ), ToCore( Exit.Point ) ); }
+
+	ABaseFloorPiece* Piece = nullptr;
+	ABaseTurnFloorPiece* TurnPiece = nullptr;
+
+	FTrackMarker Entry;
+	FTrackMarker Exit;
+	FTrackMarker Trigger;
+	FTrackMarker TurnStart;
+	FTrackMarker FloorEnd;
+
+	bool HasFloorEnd = false;
+	bool Triggered = false;
+	bool TurnStarted = false;
+	bool TurnFinished = false;
+	bool FloorEndPassed = false;
 };
 
 UENUM( BlueprintType )
@@ -88,9 +121,14 @@ public:
 
 	virtual void BeginPlay() override;
 	virtual void Tick( float DeltaSeconds ) override;
+	virtual void ApplyWorldOffset( const FVector& InOffset, bool bWorldShift ) override;
 
 	void SpawnExtraConnections( ABaseFloorPiece* BaseMultiPiece );
 	void MultiPieceCollision( ABaseFloorPiece* BaseMultiPiece, const int32 index );
+	void GatherLevelPieceClasses( TSet< UClass* >& OutClasses, const bool ReachableOnly = false ) const;
+	ABaseUpgrade* AcquireUpgrade( const FTransform& Transform );
+	void ReleaseUpgrade( ABaseUpgrade* Upgrade );
+	class AObstacleInstanceManager* GetObstacleInstanceManager();
 
 	UFUNCTION( BlueprintImplementableEvent, Category = "Setup" )
 	void RegisterFloorPieceFamilies();
@@ -125,9 +163,51 @@ public:
 	UFUNCTION( BlueprintCallable, Category = "Events" )
 	void TempRestartGame();
 
+	// Starts the run again in place, live pieces are pooled for the next run rather than the map being reloaded
+	UFUNCTION( BlueprintCallable, Category = "Events" )
+	void FastRestart();
+
+	// BP BeginPlay isn't run again by a fast restart, reset anything it set up here
+	UFUNCTION( BlueprintImplementableEvent, Category = "Events" )
+	void OnFastRestart();
+
+	// Destroys the pooled pieces, for when what a class and variation spawns has changed
+	void FlushFloorPiecePool();
+	int32 GetPooledFloorPieceCount() const;
+
+	// Frees the piece and upgrade pools and cached layouts of unreachable classes, all refill as pieces spawn
+	void ReleaseCachedResources();
+
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	void QueuePiece( UClass* Class );
 
+	// Hands the prefetched obstacle layout to the piece being spawned, invalid if there isn't one for its class
+	// OutSeed is always set to the seed the layout should be generated from
+	TFuture< FRandomisedObstacleLayout > TakeObstacleLayout( UClass* PieceClass, int32& OutSeed );
+
+	// Pieces passed since the level started plus the fraction of the current piece
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	float GetTrackProgress() const { return TrackProgress; }
+
+	// Centreline queries, distances are measured along the track from the start of the level
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	float FindTrackDistance( const FVector& Location ) const;
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	float FindTrackLateralOffset( const FVector& Location ) const;
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	FTransform GetTrackTransformAtDistance( const float Distance ) const;
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	ABaseFloorPiece* GetTrackPieceAtDistance( const float Distance ) const;
+
+	UFUNCTION( BlueprintPure, Category = "Utility" )
+	float GetTrackEndDistance() const { return TrackCentreline.GetEndDistance(); }
+
+	const FTrackCentreline& GetTrackCentreline() const { return TrackCentreline; }
+	ABaseFloorPiece* GetCurrentTrackPiece() const { return TrackNodes.IsValidIndex( TrackNodeIndex ) ? TrackNodes[ TrackNodeIndex ].Piece : nullptr; }
+
 	UFUNCTION( BlueprintCallable, Category = "Utility" )
 	void QueuePieceWithVariation( UClass* Class, int32 Variation );
 
@@ -180,14 +260,32 @@ private:
 	void FindFloorPieceToSpawn( const bool IgnoreSplitPieces = false );
 	FVector LocationRounded( const FVector& Loc );
 	void DestroyPawn();
+	bool SpawnPlayerPawn();
+	void StartTrack();
+	void ResetSpawnQueue();
+	ABaseFloorPiece* AcquireFloorPiece( UClass* PieceClass, const int32 Variation );
+	void ReleaseFloorPiece( ABaseFloorPiece* Piece );
+	void UpdatePieceResidency();
+	void AddTrackNode( ABaseFloorPiece* Piece );
+	void RemoveTrackNode( ABaseFloorPiece* Piece );
+	void UpdateTrackProgress();
+	bool ProcessTrackEvent( const FVector& PreviousLocation, const FVector& Location );
+	void OnPieceTriggered( ABaseFloorPiece* FloorPiece );
+	void PrefetchObstacleLayouts();
+	int32 MakeObstacleLayoutSeed();
+	void ApplyQualitySettings();
+	void UpdatePieceVisibility();
+	void UpdateWorldOrigin();
 	ABaseFloorPiece* SpawnFloorPieceInternal( UClass* PieceClass, int32 PieceVariation, bool TransitionPiece, const FTransform& Transform, const bool AddToArray );
 
 	// Members
 public:
 	UPROPERTY( BlueprintReadWrite, Category = "Data" ) ABasePlayerPawn* PlayerRef;
 	UPROPERTY( BlueprintReadWrite, Category = "Data" ) bool EndlessMode;
+	UPROPERTY( BlueprintReadOnly, Category = "Data" ) int32 RunSeed;
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Data" ) TArray< FFloorPieceType > FloorPieceBPClasses;
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Data" ) UClass* FloorPieceOverride;
+	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Data" ) int32 FloorPieceVariationOverride;
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Data" ) int32 RemovalDelay;
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Data" ) float GameProgress;
 	UPROPERTY( BlueprintReadWrite, EditAnywhere, Category = "Data" ) float GameProgressPerMinute;
@@ -200,16 +298,37 @@ public:
 	TArray< ABaseFloorPiece* > FloorPieceArray;
 	float DistanceMoved;
 	bool UpdateNewFloorPiecePosition;	
+	int32 FloorRecentreStep;
 	int32 RepeatCount;
 	int32 PreSpawnedPieces;
 	bool ClassicMode;
 
+	// Set once BeginPlay has started a run, false on the menu
+	bool GameLevel;
+
 	EPieceFamily PrivateFamily;
 	int32 PrivateLengthRemaining;
 
-	FSpawnQueueItem* SpawnQueueRoot;
-	FSpawnQueueItem* SpawnQueueCurrent;
-	TArray< FSpawnQueueItem* > SpawnQueueSplits;
+	// Ordered chain of live pieces, events fire as the pawn passes their markers
+	TArray< FTrackNode > TrackNodes;
+	int32 TrackNodeIndex;
+	int32 TrackNodesRemoved;
+	float TrackProgress;
+	FTrackCentreline TrackCentreline;
+
+	// Where the pawn was on the previous update, branch boxes are swept from here so none are skipped
+	FVector LastTrackLocation;
+	bool HasLastTrackLocation;
+
+	CubeCore::SpawnQueue< FSpawnQueueEntry > SpawnQueue;
+
+	// Layout of the queue item currently being spawned
+	TFuture< FRandomisedObstacleLayout > PendingObstacleLayout;
+	UClass* PendingObstacleLayoutClass;
+	int32 PendingObstacleLayoutSeed;
+
+	// Layout seeds handed out this run, mixed with the run seed
+	int32 ObstacleLayoutSeedCount;
 
 	// Level settings
 	bool LevelOptionsSet;
@@ -230,4 +349,19 @@ public:
 
 	// Storage for family data 
 	TMap< EPieceFamily, FFloorPieceFamily > PieceFamilyData;
+
+	// Shared instanced obstacle components for every piece
+	class AObstacleInstanceManager* ObstacleInstanceManager;
+
+	// Upgrades hidden and waiting to be placed on a new piece
+	TArray< ABaseUpgrade* > UpgradePool;
+
+	// Removed pieces hidden and waiting to be reused, keyed by class and variation
+	TMap< TPair< UClass*, int32 >, TArray< ABaseFloorPiece* > > FloorPiecePool;
+
+	// Endless mode difficulty tier the resident piece classes were last computed for
+	int32 ResidencyTier;
+
+	// Scales visual detail to the device, see FCubeQualityGovernor
+	FCubeQualityGovernor QualityGovernor;
 };
@@ -0,0 +1,202 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "FloorPieceProfiler.h"
+#include "CubeRunner.h"
+#include "BaseFloorPiece.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	TAutoConsoleVariable< int32 > CVarPieceProfiler( TEXT( "cr.PieceProfiler" ), 0, TEXT( "Record spawn and removal costs for every floor piece class and variation" ), ECVF_Default );
+
+	FAutoConsoleCommand PieceProfilerDumpCommand( TEXT( "cr.PieceProfiler.Dump" ), TEXT( "Log the floor piece profiler aggregates, most expensive first" ),
+		FConsoleCommandDelegate::CreateLambda( []() { FFloorPieceProfiler::Get().Dump(); } ) );
+
+	FAutoConsoleCommand PieceProfilerExportCommand( TEXT( "cr.PieceProfiler.Export" ), TEXT( "Write the floor piece profiler aggregates to a CSV, optionally at the given path" ),
+		FConsoleCommandWithArgsDelegate::CreateLambda( []( const TArray< FString >& Args ) { FFloorPieceProfiler::Get().ExportCSV( Args.Num() ? Args[ 0 ] : FString() ); } ) );
+
+	FAutoConsoleCommand PieceProfilerResetCommand( TEXT( "cr.PieceProfiler.Reset" ), TEXT( "Clear the floor piece profiler aggregates" ),
+		FConsoleCommandDelegate::CreateLambda( []() { FFloorPieceProfiler::Get().Reset(); } ) );
+
+	double ToMs( const double Seconds ) { return Seconds * 1000.0; }
+	double Average( const double Total, const int32 Count ) { return Count > 0 ? Total / Count : 0.0; }
+}
+
+FFloorPieceProfiler& FFloorPieceProfiler::Get()
+{
+	static FFloorPieceProfiler Instance;
+	return Instance;
+}
+
+bool FFloorPieceProfiler::IsEnabled() const
+{
+	static const bool CommandLineEnabled = FParse::Param( FCommandLine::Get(), TEXT( "CubePieceProfile" ) );
+	return CommandLineEnabled || CVarPieceProfiler.GetValueOnGameThread() != 0;
+}
+
+int64 FFloorPieceProfiler::GetUsedMemory()
+{
+	return int64( FPlatformMemory::GetStats().UsedPhysical );
+}
+
+FFloorPieceProfiler::FScopedSpawn::FScopedSpawn()
+{
+	auto& Profiler = FFloorPieceProfiler::Get();
+
+	if( !Profiler.IsEnabled() )
+		return;
+
+	FActiveSpawn Spawn;
+	Spawn.StartMemory = GetUsedMemory();
+	Spawn.StartTime = FPlatformTime::Seconds();
+	Profiler.ActiveSpawns.Add( Spawn );
+	Active = true;
+}
+
+FFloorPieceProfiler::FScopedSpawn::~FScopedSpawn()
+{
+	// The spawn failed before it finished
+	if( Active )
+		FFloorPieceProfiler::Get().ActiveSpawns.Pop( false );
+}
+
+void FFloorPieceProfiler::FScopedSpawn::Finish( const ABaseFloorPiece* Piece, const bool Reused, const double ConstructionSeconds )
+{
+	if( !Active )
+		return;
+
+	Active = false;
+
+	auto& Profiler = FFloorPieceProfiler::Get();
+	const auto Spawn = Profiler.ActiveSpawns.Pop( false );
+	const auto Elapsed = FPlatformTime::Seconds() - Spawn.StartTime;
+	const auto MemoryDelta = GetUsedMemory() - Spawn.StartMemory;
+
+	// Our parent shouldn't be charged for us
+	if( Profiler.ActiveSpawns.Num() )
+	{
+		Profiler.ActiveSpawns.Last().ChildSeconds += Elapsed;
+		Profiler.ActiveSpawns.Last().ChildMemory += MemoryDelta;
+	}
+
+	if( !IsValid( Piece ) )
+		return;
+
+	auto& Stats = Profiler.FindOrAddStats( Piece->GetClass(), Piece->Variation );
+	const auto SpawnSeconds = Elapsed - Spawn.ChildSeconds;
+
+	Stats.Spawns++;
+	Stats.Reuses += Reused ? 1 : 0;
+	Stats.SpawnSeconds += SpawnSeconds;
+	Stats.MaxSpawnSeconds = FMath::Max( Stats.MaxSpawnSeconds, SpawnSeconds );
+	Stats.ConstructionSeconds += ConstructionSeconds;
+	Stats.MaxConstructionSeconds = FMath::Max( Stats.MaxConstructionSeconds, ConstructionSeconds );
+	Stats.Components += Piece->GetComponents().Num();
+	Stats.Traces += Spawn.Traces;
+	Stats.MemoryBytes += MemoryDelta - Spawn.ChildMemory;
+
+	for( const auto& Instance : Piece->InstancedObstacleData )
+		Stats.Instances += Instance.Value.LocalTransforms.Num();
+}
+
+void FFloorPieceProfiler::RecordRemoval( const UClass* Class, const int32 Variation, const double Seconds )
+{
+	if( !Class )
+		return;
+
+	auto& PieceStats = FindOrAddStats( Class, Variation );
+	PieceStats.Removals++;
+	PieceStats.RemovalSeconds += Seconds;
+	PieceStats.MaxRemovalSeconds = FMath::Max( PieceStats.MaxRemovalSeconds, Seconds );
+}
+
+void FFloorPieceProfiler::CountTrace()
+{
+	if( ActiveSpawns.Num() )
+		ActiveSpawns.Last().Traces++;
+}
+
+FFloorPieceProfiler::FPieceStats& FFloorPieceProfiler::FindOrAddStats( const UClass* Class, const int32 Variation )
+{
+	auto& PieceStats = Stats.FindOrAdd( MakeTuple( FName( *Class->GetPathName() ), Variation ) );
+
+	if( PieceStats.ClassName.IsEmpty() )
+	{
+		PieceStats.ClassName = Class->GetName();
+		PieceStats.Variation = Variation;
+	}
+
+	return PieceStats;
+}
+
+TArray< const FFloorPieceProfiler::FPieceStats* > FFloorPieceProfiler::GetSortedStats() const
+{
+	TArray< const FPieceStats* > Sorted;
+
+	for( const auto& Pair : Stats )
+		Sorted.Add( &Pair.Value );
+
+	Sorted.Sort( []( const FPieceStats& A, const FPieceStats& B ) { return Average( A.SpawnSeconds, A.Spawns ) > Average( B.SpawnSeconds, B.Spawns ); } );
+	return Sorted;
+}
+
+void FFloorPieceProfiler::Dump() const
+{
+	if( !Stats.Num() )
+	{
+		UE_LOG( LogCubeBenchmark, Warning, TEXT( "Piece profiler: nothing recorded, enable it with cr.PieceProfiler 1" ) );
+		return;
+	}
+
+	UE_LOG( LogCubeBenchmark, Display, TEXT( "Piece profiler: class / variation, spawns (reused), spawn avg/max ms, construction avg/max ms, components, instances, traces, memory KB, removal avg/max ms" ) );
+
+	for( const auto* PieceStats : GetSortedStats() )
+	{
+		const auto& S = *PieceStats;
+		UE_LOG( LogCubeBenchmark, Display, TEXT( "  %s / %d: %d (%d), %.2f/%.2f, %.2f/%.2f, %.0f, %.0f, %.1f, %.1f, %.2f/%.2f" ),
+			*S.ClassName, S.Variation, S.Spawns, S.Reuses,
+			ToMs( Average( S.SpawnSeconds, S.Spawns ) ), ToMs( S.MaxSpawnSeconds ),
+			ToMs( Average( S.ConstructionSeconds, S.Spawns ) ), ToMs( S.MaxConstructionSeconds ),
+			Average( double( S.Components ), S.Spawns ), Average( double( S.Instances ), S.Spawns ), Average( double( S.Traces ), S.Spawns ),
+			Average( double( S.MemoryBytes ), S.Spawns ) / 1024.0,
+			ToMs( Average( S.RemovalSeconds, S.Removals ) ), ToMs( S.MaxRemovalSeconds ) );
+	}
+}
+
+bool FFloorPieceProfiler::ExportCSV( const FString& Path /*= FString()*/ ) const
+{
+	const auto FilePath = Path.IsEmpty() ? FPaths::ProfilingDir() / TEXT( "FloorPieces_" ) + FDateTime::Now().ToString() + TEXT( ".csv" ) : Path;
+
+	TArray< FString > Lines;
+	Lines.Add( TEXT( "Class,Variation,Spawns,Reused,AvgSpawnMs,MaxSpawnMs,AvgConstructionMs,MaxConstructionMs,AvgComponents,AvgInstances,AvgTraces,AvgMemoryKB,Removals,AvgRemovalMs,MaxRemovalMs" ) );
+
+	for( const auto* PieceStats : GetSortedStats() )
+	{
+		const auto& S = *PieceStats;
+		Lines.Add( FString::Printf( TEXT( "%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.2f,%.1f,%d,%.3f,%.3f" ),
+			*S.ClassName, S.Variation, S.Spawns, S.Reuses,
+			ToMs( Average( S.SpawnSeconds, S.Spawns ) ), ToMs( S.MaxSpawnSeconds ),
+			ToMs( Average( S.ConstructionSeconds, S.Spawns ) ), ToMs( S.MaxConstructionSeconds ),
+			Average( double( S.Components ), S.Spawns ), Average( double( S.Instances ), S.Spawns ), Average( double( S.Traces ), S.Spawns ),
+			Average( double( S.MemoryBytes ), S.Spawns ) / 1024.0,
+			S.Removals, ToMs( Average( S.RemovalSeconds, S.Removals ) ), ToMs( S.MaxRemovalSeconds ) ) );
+	}
+
+	if( !FFileHelper::SaveStringArrayToFile( Lines, *FilePath ) )
+	{
+		UE_LOG( LogCubeBenchmark, Error, TEXT( "Piece profiler: failed to write %s" ), *FilePath );
+		return false;
+	}
+
+	UE_LOG( LogCubeBenchmark, Display, TEXT( "Piece profiler: wrote %d pieces to %s" ), Stats.Num(), *FilePath );
+	return true;
+}
+
+void FFloorPieceProfiler::Reset()
+{
+	Stats.Empty();
+}
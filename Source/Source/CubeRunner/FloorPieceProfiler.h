@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABaseFloorPiece;
+
+// Opt-in cost breakdown of every floor piece class and variation spawned, enabled with cr.PieceProfiler or -CubePieceProfile
+// Report with cr.PieceProfiler.Dump, write a CSV with cr.PieceProfiler.Export (done automatically at the end of a replay benchmark)
+class CUBERUNNER_API FFloorPieceProfiler
+{
+public:
+	static FFloorPieceProfiler& Get();
+
+	bool IsEnabled() const;
+
+	// Wraps a piece's own spawn, transition pieces spawned from inside it are taken back out of its numbers
+	class CUBERUNNER_API FScopedSpawn
+	{
+	public:
+		FScopedSpawn();
+		~FScopedSpawn();
+
+		void Finish( const ABaseFloorPiece* Piece, const bool Reused, const double ConstructionSeconds );
+
+	private:
+		bool Active = false;
+	};
+
+	void RecordRemoval( const UClass* Class, const int32 Variation, const double Seconds );
+
+	// Traces issued by piece code while a spawn is in progress
+	void CountTrace();
+
+	void Dump() const;
+	bool ExportCSV( const FString& Path = FString() ) const;
+	void Reset();
+
+private:
+	struct FActiveSpawn
+	{
+		double StartTime = 0.0;
+		int64 StartMemory = 0;
+		double ChildSeconds = 0.0;
+		int64 ChildMemory = 0;
+		int32 Traces = 0;
+	};
+
+	struct FPieceStats
+	{
+		FString ClassName;
+		int32 Variation = 0;
+		int32 Spawns = 0;
+		int32 Reuses = 0;
+		double SpawnSeconds = 0.0;
+		double MaxSpawnSeconds = 0.0;
+		double ConstructionSeconds = 0.0;
+		double MaxConstructionSeconds = 0.0;
+		int64 Components = 0;
+		int64 Instances = 0;
+		int64 Traces = 0;
+		int64 MemoryBytes = 0;
+		int32 Removals = 0;
+		double RemovalSeconds = 0.0;
+		double MaxRemovalSeconds = 0.0;
+	};
+
+	static int64 GetUsedMemory();
+	FPieceStats& FindOrAddStats( const UClass* Class, const int32 Variation );
+	TArray< const FPieceStats* > GetSortedStats() const;
+
+	TArray< FActiveSpawn > ActiveSpawns;
+	TMap< TPair< FName, int32 >, FPieceStats > Stats;
+};
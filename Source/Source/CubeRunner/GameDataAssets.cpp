@@ -15,6 +15,55 @@ UGameDataAssets::UGameDataAssets( const FObjectInitializer& ObjectInitializer )
 	, AdvancedDifficultyLevels( 4 )
 	, UpgradeSpawnChancePerPiecePercent( 10 )
 	, UpgradeIsNegativeEffectChancePercent( 20 )
+	, EnablePieceResidency( false )
 {
 
-}
\ No newline at end of file
+}
+
+#if WITH_EDITOR
+namespace
+{
+	TArray< FString > GetLevelsMissingManifests( const UGameDataAssets& GameData )
+	{
+		TArray< FString > Missing;
+
+		if( !GameData.EndlessPreloadManifest.Num() )
+			Missing.Add( TEXT( "Endless mode" ) );
+
+		for( int32 i = 0; i < GameData.ClassicLevelInformation.Num(); ++i )
+			if( !GameData.ClassicLevelInformation[ i ].PreloadManifest.Num() )
+				Missing.Add( FString::Printf( TEXT( "Classic level %d (%s)" ), i, *GameData.ClassicLevelInformation[ i ].Name ) );
+
+		for( int32 i = 0; i < GameData.AdvancedLevelInformation.Num(); ++i )
+			if( !GameData.AdvancedLevelInformation[ i ].PreloadManifest.Num() )
+				Missing.Add( FString::Printf( TEXT( "Advanced level %d (%s)" ), i, *GameData.AdvancedLevelInformation[ i ].Name ) );
+
+		return Missing;
+	}
+}
+
+EDataValidationResult UGameDataAssets::IsDataValid( TArray< FText >& ValidationErrors )
+{
+	auto Result = Super::IsDataValid( ValidationErrors );
+
+	for( const auto& Level : GetLevelsMissingManifests( *this ) )
+	{
+		ValidationErrors.Add( FText::FromString( Level + " has no preload manifest, play it in the editor and run cr.SaveLevelManifests" ) );
+		Result = EDataValidationResult::Invalid;
+	}
+
+	return Result;
+}
+
+void UGameDataAssets::PreSave( const ITargetPlatform* TargetPlatform )
+{
+	Super::PreSave( TargetPlatform );
+
+	// Only set when cooking, the levels can't be generated here as their pieces are picked by the level blueprints
+	if( !TargetPlatform )
+		return;
+
+	for( const auto& Level : GetLevelsMissingManifests( *this ) )
+		UE_LOG( LogTemp, Error, TEXT( "%s has no preload manifest, play it in the editor and run cr.SaveLevelManifests" ), *Level );
+}
+#endif
\ No newline at end of file
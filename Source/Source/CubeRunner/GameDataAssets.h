@@ -18,6 +18,7 @@ public:
 	FLevelInfo() { }
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) FString Name;
 	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) UTexture2D* Image = nullptr;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) TArray< FSoftObjectPath > PreloadManifest;
 };
 
 USTRUCT( BlueprintType )
@@ -32,6 +33,29 @@ public:
 	UPROPERTY( VisibleAnywhere, BlueprintReadOnly, Category = Data ) bool IsNegative;
 };
 
+// Bounds the quality governor works within, quality 1 is the full experience
+USTRUCT( BlueprintType )
+struct FQualityGovernorSettings
+{
+	GENERATED_USTRUCT_BODY()
+
+public:
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) float TargetFrameTimeMs = 16.6f;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data, meta = ( ClampMin = "0.5", ClampMax = "1.0" ) ) float FrameTimePercentile = 0.9f;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) int32 SampleFrames = 120;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) float AdjustInterval = 1.0f;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) float StepDown = 0.1f;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) float StepUp = 0.05f;
+
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) int32 MinVisiblePieces = 3;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) int32 MaxVisiblePieces = 8;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) float MinCullDistance = 8000.0f;
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data ) float MaxCullDistance = 30000.0f;
+
+	// Below this quality cosmetic effects such as the upgrade particle are skipped
+	UPROPERTY( EditAnywhere, BlueprintReadWrite, Category = Data, meta = ( ClampMin = "0.0", ClampMax = "1.0" ) ) float EffectsMinQuality = 0.5f;
+};
+
 UCLASS( BlueprintType )
 class CUBERUNNER_API UGameDataAssets : public UDataAsset
 {
@@ -40,6 +64,12 @@ class CUBERUNNER_API UGameDataAssets : public UDataAsset
 public:
 	UGameDataAssets( const FObjectInitializer& ObjectInitializer );
 
+#if WITH_EDITOR
+	// Levels without a preload manifest load nothing up front, they are recorded in play and written by cr.SaveLevelManifests
+	virtual EDataValidationResult IsDataValid( TArray< FText >& ValidationErrors ) override;
+	virtual void PreSave( const class ITargetPlatform* TargetPlatform ) override;
+#endif
+
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TSubclassOf< ABaseFloorPiece > RandomisedFloorPieceBPClass;
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TSubclassOf< ABaseUpgrade > DefaultUpgradeBPClass;
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TSubclassOf< UBaseObstacleComponent > ClassicCubeObstacleBPClass;
@@ -54,10 +84,17 @@ public:
 
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TArray< FStringAssetReference > AssetsToLoad;
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TArray< FString > FoldersToLoad;
+	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TArray< FSoftObjectPath > EndlessPreloadManifest;
+
+	// Streams piece assets per difficulty tier instead of preloading FoldersToLoad. Off by default, the hard
+	// UClass references in the game mode's piece registry keep every piece loaded so it saves no memory yet
+	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) bool EnablePieceResidency;
 
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) int32 UpgradeSpawnChancePerPiecePercent;
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) int32 UpgradeIsNegativeEffectChancePercent;
 
+	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) FQualityGovernorSettings QualityGovernor;
+
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TArray< FLevelInfo > ClassicLevelInformation;
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TArray< FLevelInfo > AdvancedLevelInformation;
 	UPROPERTY( BlueprintReadOnly, EditAnywhere, Category = "Game Data" ) TArray< FUpgradeInfo > UpgradeInformation;
@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ObstacleInstanceManager.h"
+#include "CubeRunner.h"
+#include "CubeSingletonDataLibrary.h"
+#include "Engine/StaticMesh.h"
+#include "Algo/BinarySearch.h"
+
+AObstacleInstanceManager::AObstacleInstanceManager( const FObjectInitializer& ObjectInitializer )
+	: Super( ObjectInitializer )
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	Root = CreateDefaultSubobject<USceneComponent>( TEXT( "Root" ) );
+	RootComponent = Root;
+}
+
+int32 AObstacleInstanceManager::AllocateRange( UStaticMesh* Mesh, const TArray< FTransform >& Transforms )
+{
+	if( !Mesh || !Transforms.Num() )
+		return INDEX_NONE;
+
+	auto& Instances = MeshInstances.FindOrAdd( Mesh );
+
+	if( !Instances.Component )
+	{
+		Instances.Component = NewObject< UInstancedStaticMeshComponent >( this );
+
+		if( !Instances.Component )
+		{
+			UCubeSingletonDataLibrary::CustomLog( "Spawning UInstancedStaticMeshComponent failed", LogDisplayType::Error );
+			return INDEX_NONE;
+		}
+
+		Instances.Component->AttachToComponent( RootComponent, FAttachmentTransformRules::KeepRelativeTransform );
+		Instances.Component->SetStaticMesh( Mesh );
+		Instances.Component->SetCullDistances( 0, FMath::RoundToInt( CullDistance ) );
+		Instances.Component->RegisterComponent();
+	}
+
+	const auto MeshExtent = Mesh->GetBounds().BoxExtent.GetMin();
+
+	for( const auto& Transform : Transforms )
+		SmallestObstacleExtent = FMath::Min( SmallestObstacleExtent, MeshExtent * Transform.GetScale3D().GetAbsMin() );
+
+	const auto Count = Transforms.Num();
+	const auto& InstanceTransforms = ToInstanceSpace( Transforms );
+
+	// First released range that fits
+	for( int32 i = 0; i < Instances.FreeRanges.Num(); ++i )
+	{
+		auto& Range = Instances.FreeRanges[ i ];
+
+		if( Range.Y < Count )
+			continue;
+
+		const auto Start = Range.X;
+		Range.X += Count;
+		Range.Y -= Count;
+
+		if( Range.Y == 0 )
+			Instances.FreeRanges.RemoveAt( i, 1, false );
+
+		Instances.Component->BatchUpdateInstancesTransforms( Start, InstanceTransforms, false, true, true );
+		return Start;
+	}
+
+	const auto Start = Instances.Component->GetInstanceCount();
+	Instances.Component->AddInstances( InstanceTransforms, false );
+	return Start;
+}
+
+void AObstacleInstanceManager::UpdateRange( UStaticMesh* Mesh, const int32 Start, const TArray< FTransform >& Transforms )
+{
+	auto* Instances = MeshInstances.Find( Mesh );
+
+	if( !Instances || !IsValid( Instances->Component ) || Start == INDEX_NONE || !Transforms.Num() )
+		return;
+
+	Instances->Component->BatchUpdateInstancesTransforms( Start, ToInstanceSpace( Transforms ), false, true, true );
+}
+
+const TArray< FTransform >& AObstacleInstanceManager::ToInstanceSpace( const TArray< FTransform >& Transforms )
+{
+	// Instances are relative to the manager, which moves away from the origin when the world is rebased
+	if( GetActorLocation().IsZero() )
+		return Transforms;
+
+	LocalTransforms.Reset( Transforms.Num() );
+
+	for( const auto& Transform : Transforms )
+		LocalTransforms.Add( Transform.GetRelativeTransform( GetActorTransform() ) );
+
+	return LocalTransforms;
+}
+
+void AObstacleInstanceManager::HideRange( UStaticMesh* Mesh, const int32 Start, const int32 Count )
+{
+	auto* Instances = MeshInstances.Find( Mesh );
+
+	if( !Instances || !IsValid( Instances->Component ) || Start == INDEX_NONE || Count <= 0 )
+		return;
+
+	// Zero scale hides the instances and stops them creating physics bodies
+	HiddenTransforms.Init( FTransform( FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector ), Count );
+	Instances->Component->BatchUpdateInstancesTransforms( Start, HiddenTransforms, false, true, true );
+}
+
+void AObstacleInstanceManager::ReleaseRange( UStaticMesh* Mesh, const int32 Start, const int32 Count )
+{
+	auto* Instances = MeshInstances.Find( Mesh );
+
+	if( !Instances || !IsValid( Instances->Component ) || Start == INDEX_NONE || Count <= 0 )
+		return;
+
+	HideRange( Mesh, Start, Count );
+
+	auto& FreeRanges = Instances->FreeRanges;
+	auto Index = Algo::LowerBoundBy( FreeRanges, Start, []( const FIntPoint& Range ) { return Range.X; } );
+	FreeRanges.Insert( FIntPoint( Start, Count ), Index );
+
+	if( Index + 1 < FreeRanges.Num() && FreeRanges[ Index ].X + FreeRanges[ Index ].Y == FreeRanges[ Index + 1 ].X )
+	{
+		FreeRanges[ Index ].Y += FreeRanges[ Index + 1 ].Y;
+		FreeRanges.RemoveAt( Index + 1, 1, false );
+	}
+
+	if( Index > 0 && FreeRanges[ Index - 1 ].X + FreeRanges[ Index - 1 ].Y == FreeRanges[ Index ].X )
+	{
+		FreeRanges[ Index - 1 ].Y += FreeRanges[ Index ].Y;
+		FreeRanges.RemoveAt( Index, 1, false );
+	}
+}
+
+UInstancedStaticMeshComponent* AObstacleInstanceManager::FindComponent( UStaticMesh* Mesh ) const
+{
+	const auto* Instances = MeshInstances.Find( Mesh );
+	return Instances ? Instances->Component : nullptr;
+}
+
+void AObstacleInstanceManager::SetCullDistance( const float Distance )
+{
+	if( CullDistance == Distance )
+		return;
+
+	CullDistance = Distance;
+
+	for( auto& Pair : MeshInstances )
+		if( IsValid( Pair.Value.Component ) )
+			Pair.Value.Component->SetCullDistances( 0, FMath::RoundToInt( CullDistance ) );
+}
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "ObstacleInstanceManager.generated.h"
+
+// Owns one instanced mesh component per obstacle mesh for the whole world
+// Floor pieces are handed a contiguous range of instances which is reused once released
+UCLASS()
+class CUBERUNNER_API AObstacleInstanceManager : public AActor
+{
+	GENERATED_BODY()
+
+	// Functions
+public:
+	AObstacleInstanceManager( const FObjectInitializer& ObjectInitializer );
+
+	// Returns the first index of the range holding the given world transforms
+	int32 AllocateRange( UStaticMesh* Mesh, const TArray< FTransform >& Transforms );
+	void ReleaseRange( UStaticMesh* Mesh, const int32 Start, const int32 Count );
+
+	// Stops an allocated range rendering or colliding until UpdateRange restores it
+	void HideRange( UStaticMesh* Mesh, const int32 Start, const int32 Count );
+
+	// Overwrites an allocated range in place with new world transforms
+	void UpdateRange( UStaticMesh* Mesh, const int32 Start, const TArray< FTransform >& Transforms );
+
+	UInstancedStaticMeshComponent* FindComponent( UStaticMesh* Mesh ) const;
+
+	// 0 never culls
+	void SetCullDistance( const float Distance );
+	int32 GetComponentCount() const { return MeshInstances.Num(); }
+
+	// Smallest half extent of any instance placed so far, MAX_flt before the first
+	float GetSmallestObstacleExtent() const { return SmallestObstacleExtent; }
+
+private:
+	const TArray< FTransform >& ToInstanceSpace( const TArray< FTransform >& Transforms );
+
+	struct FMeshInstances
+	{
+		UInstancedStaticMeshComponent* Component = nullptr;
+
+		// Released ranges as ( Start, Count ), sorted by start and merged with their neighbours
+		TArray< FIntPoint > FreeRanges;
+	};
+
+	// Members
+public:
+	UPROPERTY( VisibleAnywhere, BlueprintReadWrite, Category = Members, meta = ( AllowPrivateAccess = "true" ) ) class USceneComponent* Root;
+
+private:
+	TMap< UStaticMesh*, FMeshInstances > MeshInstances;
+	TArray< FTransform > HiddenTransforms;
+	TArray< FTransform > LocalTransforms;
+	float CullDistance = 0.0f;
+	float SmallestObstacleExtent = MAX_flt;
+};
@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ObstacleLayoutCache.h"
+#include "CubeRunner.h"
+#include "BaseFloorPiece.h"
+#include "CubeSingletonDataLibrary.h"
+#include "CubeMemory.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT( TEXT( "Obstacle Layouts Cached" ), STAT_ObstacleLayoutsCached, STATGROUP_CubeRunner );
+DECLARE_DWORD_COUNTER_STAT( TEXT( "Obstacle Layout Cache Hits" ), STAT_ObstacleLayoutCacheHits, STATGROUP_CubeRunner );
+DECLARE_DWORD_COUNTER_STAT( TEXT( "Obstacle Layout Cache Misses" ), STAT_ObstacleLayoutCacheMisses, STATGROUP_CubeRunner );
+
+namespace
+{
+	// Pieces can change between editor sessions, so only cooked builds keep layouts on disk by default
+	TAutoConsoleVariable< int32 > CVarObstacleLayoutCachePersist( TEXT( "cr.ObstacleLayoutCache.Persist" ), WITH_EDITOR ? 0 : 1, TEXT( "Load and save generated obstacle layouts under Saved/ between runs" ), ECVF_Default );
+
+	const uint32 LayoutCacheMagic = 0x434C4243; // "CBLC"
+	// 2 added a content hash to every layout
+	const int32 LayoutCacheVersion = 2;
+}
+
+UStaticMesh* FObstacleLayoutMesh::Resolve()
+{
+	if( !Mesh.IsValid() )
+		Mesh = Cast< UStaticMesh >( MeshPath.ResolveObject() );
+
+	return Mesh.Get();
+}
+
+FObstacleLayoutCache& FObstacleLayoutCache::Get()
+{
+	static FObstacleLayoutCache Instance;
+	return Instance;
+}
+
+FObstacleLayoutCache::FKey FObstacleLayoutCache::MakeKey( const UClass* Class, const int32 Variation, const bool ClassicMode )
+{
+	FKey Key;
+	Key.ClassPath = FName( *Class->GetPathName() );
+	Key.Variation = Variation;
+	Key.ClassicMode = ClassicMode;
+	return Key;
+}
+
+uint32 FObstacleLayoutCache::GetContentHash( const UClass* Class )
+{
+	uint32 Hash = 0;
+
+	// Native parents only change with the build version, which the file header already checks
+	for( auto* Current = Class; Current; Current = Current->GetSuperClass() )
+		if( Current->IsA< UBlueprintGeneratedClass >() )
+			Hash = HashCombine( Hash, GetTypeHash( Current->GetOutermost()->GetGuid() ) );
+
+	return Hash;
+}
+
+FString FObstacleLayoutCache::GetCachePath()
+{
+	return FPaths::ProjectSavedDir() / TEXT( "ObstacleLayouts.bin" );
+}
+
+FObstacleLayout* FObstacleLayoutCache::Find( const UClass* Class, const int32 Variation, const bool ClassicMode )
+{
+	if( !LoadAttempted )
+		Load();
+
+	const auto Key = MakeKey( Class, Variation, ClassicMode );
+	auto* Layout = Layouts.Find( Key );
+
+	// Loaded from a previous run of a piece that has been changed since
+	if( Layout && Layout->ContentHash != GetContentHash( Class ) )
+	{
+		Layouts.Remove( Key );
+		Layout = nullptr;
+		Dirty = true;
+	}
+
+	if( Layout )
+	{
+		for( auto& LayoutMesh : Layout->Meshes )
+		{
+			if( !LayoutMesh.Resolve() )
+			{
+				Layout = nullptr;
+				break;
+			}
+		}
+	}
+
+	if( Layout )
+		INC_DWORD_STAT( STAT_ObstacleLayoutCacheHits );
+	else
+		INC_DWORD_STAT( STAT_ObstacleLayoutCacheMisses );
+
+	return Layout;
+}
+
+void FObstacleLayoutCache::Add( const UClass* Class, const int32 Variation, const bool ClassicMode, const TMap< UStaticMesh*, FInstancedObstacleDataContainer >& Obstacles )
+{
+	CUBE_LLM_SCOPE( ObstacleInstances );
+
+	FObstacleLayout Layout;
+	Layout.ContentHash = GetContentHash( Class );
+
+	for( const auto& Pair : Obstacles )
+	{
+		if( !Pair.Key )
+			continue;
+
+		auto& LayoutMesh = Layout.Meshes.AddDefaulted_GetRef();
+		LayoutMesh.MeshPath = FSoftObjectPath( Pair.Key );
+		LayoutMesh.Mesh = Pair.Key;
+		LayoutMesh.LocalTransforms = Pair.Value.LocalTransforms;
+		LayoutMesh.Variations.Reserve( Pair.Value.Data.Num() );
+
+		for( const auto& Data : Pair.Value.Data )
+			LayoutMesh.Variations.Add( Data.Variations );
+	}
+
+	Layouts.Add( MakeKey( Class, Variation, ClassicMode ), MoveTemp( Layout ) );
+	Dirty = true;
+
+	SET_DWORD_STAT( STAT_ObstacleLayoutsCached, Layouts.Num() );
+}
+
+void FObstacleLayoutCache::Empty()
+{
+	Layouts.Empty();
+	LoadAttempted = false;
+	Dirty = false;
+
+	SET_DWORD_STAT( STAT_ObstacleLayoutsCached, 0 );
+}
+
+void FObstacleLayoutCache::Trim( const TSet< UClass* >& KeepClasses )
+{
+	Save();
+
+	TSet< FName > KeepPaths;
+
+	for( const auto* Class : KeepClasses )
+		if( Class )
+			KeepPaths.Add( FName( *Class->GetPathName() ) );
+
+	for( auto It = Layouts.CreateIterator(); It; ++It )
+		if( !KeepPaths.Contains( It.Key().ClassPath ) )
+			It.RemoveCurrent();
+
+	Layouts.Compact();
+	Layouts.Shrink();
+	LoadAttempted = false;
+
+	SET_DWORD_STAT( STAT_ObstacleLayoutsCached, Layouts.Num() );
+}
+
+bool FObstacleLayoutCache::Load()
+{
+	LoadAttempted = true;
+
+	if( !CVarObstacleLayoutCachePersist.GetValueOnGameThread() )
+		return false;
+
+	TArray< uint8 > Data;
+
+	if( !FFileHelper::LoadFileToArray( Data, *GetCachePath(), FILEREAD_Silent ) )
+		return false;
+
+	FMemoryReader Reader( Data );
+	uint32 Magic = 0;
+	int32 Version = 0;
+	FString BuildVersion;
+	int32 Count = 0;
+	Reader << Magic << Version << BuildVersion << Count;
+
+	if( Reader.IsError() || Magic != LayoutCacheMagic || Version != LayoutCacheVersion || BuildVersion != FApp::GetBuildVersion() )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Obstacle layout cache is out of date, it will be regenerated", LogDisplayType::Warn );
+		return false;
+	}
+
+	for( int32 i = 0; i < Count && !Reader.IsError(); ++i )
+	{
+		FString ClassPath;
+		FKey Key;
+		int32 MeshCount = 0;
+		FObstacleLayout Layout;
+		Reader << ClassPath << Key.Variation << Key.ClassicMode << Layout.ContentHash << MeshCount;
+		Key.ClassPath = FName( *ClassPath );
+
+		for( int32 j = 0; j < MeshCount && !Reader.IsError(); ++j )
+		{
+			FString MeshPath;
+			auto& LayoutMesh = Layout.Meshes.AddDefaulted_GetRef();
+			Reader << MeshPath << LayoutMesh.LocalTransforms << LayoutMesh.Variations;
+			LayoutMesh.MeshPath = FSoftObjectPath( MeshPath );
+		}
+
+		// Layouts generated this run take priority
+		if( !Layouts.Contains( Key ) )
+			Layouts.Add( Key, MoveTemp( Layout ) );
+	}
+
+	if( Reader.IsError() )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Obstacle layout cache is corrupt, it will be regenerated", LogDisplayType::Error );
+		Empty();
+		LoadAttempted = true;
+		return false;
+	}
+
+	SET_DWORD_STAT( STAT_ObstacleLayoutsCached, Layouts.Num() );
+	return true;
+}
+
+bool FObstacleLayoutCache::Save()
+{
+	if( !Dirty || !CVarObstacleLayoutCachePersist.GetValueOnGameThread() )
+		return false;
+
+	TArray< uint8 > Data;
+	FMemoryWriter Writer( Data );
+	uint32 Magic = LayoutCacheMagic;
+	int32 Version = LayoutCacheVersion;
+	FString BuildVersion = FApp::GetBuildVersion();
+	int32 Count = Layouts.Num();
+	Writer << Magic << Version << BuildVersion << Count;
+
+	for( auto& Pair : Layouts )
+	{
+		FString ClassPath = Pair.Key.ClassPath.ToString();
+		int32 Variation = Pair.Key.Variation;
+		bool ClassicMode = Pair.Key.ClassicMode;
+		int32 MeshCount = Pair.Value.Meshes.Num();
+		Writer << ClassPath << Variation << ClassicMode << Pair.Value.ContentHash << MeshCount;
+
+		for( auto& LayoutMesh : Pair.Value.Meshes )
+		{
+			FString MeshPath = LayoutMesh.MeshPath.ToString();
+			Writer << MeshPath << LayoutMesh.LocalTransforms << LayoutMesh.Variations;
+		}
+	}
+
+	if( !FFileHelper::SaveArrayToFile( Data, *GetCachePath() ) )
+	{
+		UCubeSingletonDataLibrary::CustomLog( "Failed to save the obstacle layout cache to " + GetCachePath(), LogDisplayType::Error );
+		return false;
+	}
+
+	Dirty = false;
+	return true;
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/SoftObjectPath.h"
+
+class UStaticMesh;
+struct FInstancedObstacleDataContainer;
+
+// Most obstacles belong to one or two variations, so these stay off the heap
+typedef TArray< int32, TInlineAllocator< 4 > > FObstacleVariations;
+
+// The instanced obstacles a piece's construction script placed with one mesh, relative to the piece
+struct FObstacleLayoutMesh
+{
+	FSoftObjectPath MeshPath;
+	TWeakObjectPtr< UStaticMesh > Mesh;
+	TArray< FTransform > LocalTransforms;
+	TArray< FObstacleVariations > Variations;
+
+	UStaticMesh* Resolve();
+};
+
+struct FObstacleLayout
+{
+	TArray< FObstacleLayoutMesh > Meshes;
+
+	// Of the piece blueprint packages it was generated from, see FObstacleLayoutCache::GetContentHash
+	uint32 ContentHash = 0;
+};
+
+// Construction script obstacle layouts only depend on the piece class, its variation and the game mode,
+// so they are generated on the first spawn and replayed for every later one
+class CUBERUNNER_API FObstacleLayoutCache
+{
+public:
+	static FObstacleLayoutCache& Get();
+
+	// Null if the layout hasn't been generated yet or one of its meshes isn't loaded
+	FObstacleLayout* Find( const UClass* Class, const int32 Variation, const bool ClassicMode );
+	void Add( const UClass* Class, const int32 Variation, const bool ClassicMode, const TMap< UStaticMesh*, FInstancedObstacleDataContainer >& Obstacles );
+	void Empty();
+
+	// Saves, then drops the layouts of any class not kept, persisted ones are loaded again on the next Find
+	void Trim( const TSet< UClass* >& KeepClasses );
+
+	// Only used when cr.ObstacleLayoutCache.Persist is set, files written by a different build are ignored
+	bool Load();
+	bool Save();
+
+	int32 Num() const { return Layouts.Num(); }
+
+private:
+	struct FKey
+	{
+		FName ClassPath;
+		int32 Variation = 0;
+		bool ClassicMode = true;
+
+		bool operator==( const FKey& Other ) const { return ClassPath == Other.ClassPath && Variation == Other.Variation && ClassicMode == Other.ClassicMode; }
+		friend uint32 GetTypeHash( const FKey& Key ) { return HashCombine( GetTypeHash( Key.ClassPath ), GetTypeHash( Key.Variation * 2 + ( Key.ClassicMode ? 1 : 0 ) ) ); }
+	};
+
+	static FKey MakeKey( const UClass* Class, const int32 Variation, const bool ClassicMode );
+
+	// Changes whenever the blueprint or one of its blueprint parents is saved, so content only patches invalidate layouts
+	static uint32 GetContentHash( const UClass* Class );
+	static FString GetCachePath();
+
+	TMap< FKey, FObstacleLayout > Layouts;
+	bool LoadAttempted = false;
+	bool Dirty = false;
+};
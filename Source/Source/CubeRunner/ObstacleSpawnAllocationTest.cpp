@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CubeRunner.h"
+#include "BaseFloorPiece.h"
+#include "ObstacleSpawnTestComponent.h"
+#include "CubeMemory.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// How much the obstacle instance tag grew while Body ran, INDEX_NONE when LLM isn't tracking (run with -LLM)
+	int64 MeasureObstacleInstanceGrowth( TFunctionRef< void() > Body )
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		if( !FLowLevelMemTracker::IsEnabled() )
+		{
+			Body();
+			return INDEX_NONE;
+		}
+
+		// Anything the spawn functions allocate outside their own scopes lands in the same tag
+		CUBE_LLM_SCOPE( ObstacleInstances );
+
+		auto& Tracker = FLowLevelMemTracker::Get();
+		Tracker.UpdateStatsPerFrame();
+		const auto Before = Tracker.GetTagAmountForTracker( ELLMTracker::Default, ( ELLMTag )ECubeLLMTag::ObstacleInstances );
+
+		Body();
+
+		Tracker.UpdateStatsPerFrame();
+		return Tracker.GetTagAmountForTracker( ELLMTracker::Default, ( ELLMTag )ECubeLLMTag::ObstacleInstances ) - Before;
+#else
+		Body();
+		return INDEX_NONE;
+#endif
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FObstacleSpawnAllocationTest, "CubeRunner.Obstacles.SpawnAllocations", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter )
+
+bool FObstacleSpawnAllocationTest::RunTest( const FString& Parameters )
+{
+	const int32 ObstacleCount = 256;
+	const int32 Variations[] = { 0, 2, 5 };
+	const int32 Mask[] = { 3, 1, 2 };
+	const FVector ControlPoints[] = { FVector( 0.0f, -1000.0f, 0.0f ), FVector( 2000.0f, 0.0f, 0.0f ), FVector( 0.0f, 1000.0f, 0.0f ) };
+
+	auto* Mesh = LoadObject< UStaticMesh >( nullptr, TEXT( "/Engine/BasicShapes/Cube.Cube" ) );
+
+	if( !TestNotNull( TEXT( "Engine cube mesh" ), Mesh ) )
+		return false;
+
+	UClass* ObstacleClass = UObstacleSpawnTestComponent::StaticClass();
+	GetMutableDefault< UObstacleSpawnTestComponent >()->SetStaticMesh( Mesh );
+
+	auto* World = UWorld::CreateWorld( EWorldType::Game, false );
+	auto& WorldContext = GEngine->CreateNewWorldContext( EWorldType::Game );
+	WorldContext.SetCurrentWorld( World );
+
+	const bool WasInstanced = ABaseFloorPiece::IsInstancedObstacleSpawningEnabled();
+	ABaseFloorPiece::SetInstancedObstacleSpawningEnabled( true );
+
+	// No layout cache so every obstacle goes through the spawn path rather than a replay
+	auto* Piece = World->SpawnActorDeferred< ABaseFloorPiece >( ABaseFloorPiece::StaticClass(), FTransform::Identity );
+	Piece->CacheObstacleLayout = false;
+	Piece->FinishSpawning( FTransform::Identity );
+
+	// Every entry point blueprints place obstacles through, the masked ones first as their first call clears the piece
+	const auto SpawnAll = [ & ]()
+	{
+		Piece->SpawnObstaclesWithMaskMultiVariations( MakeArrayView( ControlPoints ), ObstacleCount, ESpawnObstaclesType::ESOAT_FOLLOW_ROTATION, MakeArrayView( Mask ), MakeArrayView( Variations ), false, ObstacleClass );
+		Piece->SpawnObstaclesWithMaskMultiVariations( MakeArrayView( ControlPoints ), ObstacleCount, ESpawnObstaclesType::ESOAT_FOLLOW_ROTATION, MakeArrayView( Mask ), MakeArrayView( Variations ), true, ObstacleClass );
+
+		for( int32 i = 0; i < ObstacleCount; ++i )
+			Piece->SpawnObstacleMultiVariations( ObstacleClass, FTransform( FVector( i * 100.0f, 0.0f, 0.0f ) ), MakeArrayView( Variations ) );
+	};
+
+	const auto GetRecorded = [ & ]()
+	{
+		const auto* Instances = Piece->InstancedObstacleData.Find( Mesh );
+		return Instances ? Instances->Data.Num() : 0;
+	};
+
+	const auto ResetRecorded = [ & ]()
+	{
+		for( auto& Instance : Piece->InstancedObstacleData )
+		{
+			Instance.Value.LocalTransforms.Reset();
+			Instance.Value.Data.Reset();
+		}
+	};
+
+	// First pass grows the piece's per mesh arrays, steady state is a piece refilling the capacity it already has
+	SpawnAll();
+	const auto WarmRecorded = GetRecorded();
+	TestTrue( TEXT( "Masked and curve spawns recorded obstacles" ), WarmRecorded > ObstacleCount );
+
+	ResetRecorded();
+	const auto Growth = MeasureObstacleInstanceGrowth( SpawnAll );
+
+	TestEqual( TEXT( "Obstacles recorded" ), GetRecorded(), WarmRecorded );
+
+	if( Growth == INDEX_NONE )
+		AddWarning( TEXT( "LLM isn't tracking, run with -LLM to check obstacle spawn allocations" ) );
+	else
+		TestEqual( FString::Printf( TEXT( "Obstacle instance memory growth placing %d obstacles" ), WarmRecorded ), Growth, int64( 0 ) );
+
+	ABaseFloorPiece::SetInstancedObstacleSpawningEnabled( WasInstanced );
+	GEngine->DestroyWorldContext( World );
+	World->DestroyWorld( false );
+	GetMutableDefault< UObstacleSpawnTestComponent >()->SetStaticMesh( nullptr );
+	return true;
+}
+
+#endif
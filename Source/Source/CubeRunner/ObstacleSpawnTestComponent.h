@@ -0,0 +1,16 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "BaseObstacleComponent.h"
+#include "ObstacleSpawnTestComponent.generated.h"
+
+// Obstacle class for automation tests, they give its defaults a mesh so spawning takes the same path a blueprint obstacle does
+UCLASS( Transient, NotBlueprintable, HideDropdown )
+class UObstacleSpawnTestComponent : public UBaseObstacleComponent
+{
+	GENERATED_BODY()
+
+public:
+	UObstacleSpawnTestComponent( const FObjectInitializer& ObjectInitializer ) : Super( ObjectInitializer ) {}
+};
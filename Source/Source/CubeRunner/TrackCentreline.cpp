@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TrackCentreline.h"
+#include "CubeRunner.h"
+#include "BaseFloorPiece.h"
+#include "BaseTurnFloorPiece.h"
+#include "Algo/BinarySearch.h"
+
+namespace
+{
+	const float ArcSampleAngle = PI / 18.0f;
+}
+
+void FTrackCentreline::AddPiece( ABaseFloorPiece* Piece )
+{
+	const auto Entry = Piece->GetActorLocation();
+	CommitPendingBranch( Entry );
+	AppendPoint( Entry, Piece );
+
+	// Split pieces wait until we know which branch the track carries on from
+	if( Piece->MultiConnections.Num() > 1 )
+	{
+		PendingBranchPiece = Piece;
+		PendingBranches.Reset();
+
+		for( int32 i = 0; i < Piece->MultiConnections.Num(); ++i )
+			PendingBranches.Add( { Piece->GetMultiConnectionTransform( i ).GetLocation() } );
+
+		return;
+	}
+
+	if( auto* TurnPiece = Cast< ABaseTurnFloorPiece >( Piece ) )
+	{
+		const auto Start = TurnPiece->GetTurnStartTransform();
+		const auto End = TurnPiece->GetTurnEndTransform();
+
+		FTurnArc Arc;
+		Arc.Initialise( Start.GetLocation(), Start.GetUnitAxis( EAxis::X ), End.GetLocation(), End.GetUnitAxis( EAxis::X ) );
+
+		AppendPoint( Arc.GetLocation( 0.0f, Arc.Radius ), Piece );
+
+		const auto Steps = FMath::Max( 2, FMath::CeilToInt( Arc.SweepAngle / ArcSampleAngle ) );
+
+		for( int32 i = 1; i <= Steps; ++i )
+			AppendPoint( Arc.GetLocation( Arc.SweepAngle * i / Steps, Arc.Radius ), Piece );
+	}
+
+	AppendPoint( Piece->GetConnectionTransform().GetLocation(), Piece );
+}
+
+void FTrackCentreline::RemovePiece( ABaseFloorPiece* Piece )
+{
+	if( PendingBranchPiece == Piece )
+	{
+		PendingBranchPiece = nullptr;
+		PendingBranches.Reset();
+	}
+
+	// Pieces are removed from the front so trim every leading segment on this piece
+	int32 Count = 0;
+
+	while( Count + 1 < Samples.Num() && Samples[ Count + 1 ].Piece == Piece )
+		++Count;
+
+	if( Count )
+	{
+		Samples.RemoveAt( 0, Count, false );
+		BoundsDirty = true;
+	}
+}
+
+void FTrackCentreline::Reset()
+{
+	Samples.Reset();
+	PendingBranches.Reset();
+	PendingBranchPiece = nullptr;
+	BoundsDirty = true;
+}
+
+void FTrackCentreline::ApplyWorldOffset( const FVector& Offset )
+{
+	// Distances are unaffected, only the points move
+	for( auto& Sample : Samples )
+		Sample.Location += Offset;
+
+	for( auto& Branch : PendingBranches )
+		for( auto& Point : Branch )
+			Point += Offset;
+
+	BoundsDirty = true;
+}
+
+float FTrackCentreline::FindNearestDistance( const FVector& Location, float* OutLateralOffset /*= nullptr*/ ) const
+{
+	if( OutLateralOffset )
+		*OutLateralOffset = 0.0f;
+
+	if( IsEmpty() )
+		return GetStartDistance();
+
+	if( BoundsDirty )
+		BuildBounds();
+
+	auto BestDistSq = MAX_flt;
+	auto BestSegment = 0;
+	FindNearestSegment( 1, Location, BestDistSq, BestSegment );
+
+	const auto& Start = Samples[ BestSegment ];
+	const auto& End = Samples[ BestSegment + 1 ];
+	const auto Closest = FMath::ClosestPointOnSegment( Location, Start.Location, End.Location );
+	const auto Length = End.Distance - Start.Distance;
+	const auto Alpha = Length > KINDA_SMALL_NUMBER ? FVector::Dist( Start.Location, Closest ) / Length : 0.0f;
+
+	if( OutLateralOffset )
+	{
+		const auto Right = FVector::CrossProduct( FVector::UpVector, End.Location - Start.Location ).GetSafeNormal();
+		*OutLateralOffset = FVector::DotProduct( Location - Closest, Right );
+	}
+
+	return FMath::Lerp( Start.Distance, End.Distance, Alpha );
+}
+
+ABaseFloorPiece* FTrackCentreline::GetPieceAtDistance( const float Distance ) const
+{
+	return IsEmpty() ? nullptr : Samples[ FindSegment( Distance ) + 1 ].Piece;
+}
+
+FTransform FTrackCentreline::GetTransformAtDistance( const float Distance ) const
+{
+	if( IsEmpty() )
+		return Samples.Num() ? FTransform( Samples[ 0 ].Location ) : FTransform::Identity;
+
+	const auto Segment = FindSegment( Distance );
+	const auto& Start = Samples[ Segment ];
+	const auto& End = Samples[ Segment + 1 ];
+	const auto Length = End.Distance - Start.Distance;
+	const auto Alpha = Length > KINDA_SMALL_NUMBER ? FMath::Clamp( ( Distance - Start.Distance ) / Length, 0.0f, 1.0f ) : 0.0f;
+
+	return FTransform( FRotationMatrix::MakeFromX( End.Location - Start.Location ).ToQuat(), FMath::Lerp( Start.Location, End.Location, Alpha ) );
+}
+
+void FTrackCentreline::AppendPoint( const FVector& Location, ABaseFloorPiece* Piece )
+{
+	if( !Samples.Num() )
+	{
+		Samples.Add( { Location, 0.0f, Piece } );
+		return;
+	}
+
+	const auto Step = FVector::Dist( Samples.Last().Location, Location );
+
+	if( Step < 1.0f )
+		return;
+
+	Samples.Add( { Location, Samples.Last().Distance + Step, Piece } );
+	BoundsDirty = true;
+}
+
+void FTrackCentreline::CommitPendingBranch( const FVector& Entry )
+{
+	if( !PendingBranchPiece || !PendingBranches.Num() )
+		return;
+
+	auto BestBranch = 0;
+	auto BestDistSq = MAX_flt;
+
+	for( int32 i = 0; i < PendingBranches.Num(); ++i )
+	{
+		const auto DistSq = FVector::DistSquared( PendingBranches[ i ].Last(), Entry );
+
+		if( DistSq < BestDistSq )
+		{
+			BestDistSq = DistSq;
+			BestBranch = i;
+		}
+	}
+
+	auto* BranchPiece = PendingBranchPiece;
+	const auto Branch = MoveTemp( PendingBranches[ BestBranch ] );
+	PendingBranchPiece = nullptr;
+	PendingBranches.Reset();
+
+	for( const auto& Point : Branch )
+		AppendPoint( Point, BranchPiece );
+}
+
+int32 FTrackCentreline::FindSegment( const float Distance ) const
+{
+	const auto Index = Algo::UpperBoundBy( Samples, Distance, []( const FCentrelineSample& Sample ) { return Sample.Distance; } ) - 1;
+	return FMath::Clamp( Index, 0, Samples.Num() - 2 );
+}
+
+void FTrackCentreline::BuildBounds() const
+{
+	const auto SegmentCount = Samples.Num() - 1;
+	LeafCount = FMath::RoundUpToPowerOfTwo( FMath::Max( SegmentCount, 1 ) );
+	SegmentBounds.Init( FBox( ForceInit ), LeafCount * 2 );
+
+	for( int32 i = 0; i < SegmentCount; ++i )
+	{
+		auto& Bounds = SegmentBounds[ LeafCount + i ];
+		Bounds += Samples[ i ].Location;
+		Bounds += Samples[ i + 1 ].Location;
+	}
+
+	for( int32 Node = LeafCount - 1; Node >= 1; --Node )
+		SegmentBounds[ Node ] = SegmentBounds[ Node * 2 ] + SegmentBounds[ Node * 2 + 1 ];
+
+	BoundsDirty = false;
+}
+
+void FTrackCentreline::FindNearestSegment( const int32 Node, const FVector& Location, float& BestDistSq, int32& BestSegment ) const
+{
+	const auto& Bounds = SegmentBounds[ Node ];
+
+	if( !Bounds.IsValid || Bounds.ComputeSquaredDistanceToPoint( Location ) >= BestDistSq )
+		return;
+
+	if( Node >= LeafCount )
+	{
+		const auto Segment = Node - LeafCount;
+		const auto DistSq = FMath::PointDistToSegmentSquared( Location, Samples[ Segment ].Location, Samples[ Segment + 1 ].Location );
+
+		if( DistSq < BestDistSq )
+		{
+			BestDistSq = DistSq;
+			BestSegment = Segment;
+		}
+
+		return;
+	}
+
+	// Visit the closer child first so the other is more likely to be pruned
+	const auto Left = Node * 2;
+	const auto Right = Left + 1;
+	const auto LeftFirst = SegmentBounds[ Left ].ComputeSquaredDistanceToPoint( Location ) <= SegmentBounds[ Right ].ComputeSquaredDistanceToPoint( Location );
+
+	FindNearestSegment( LeftFirst ? Left : Right, Location, BestDistSq, BestSegment );
+	FindNearestSegment( LeftFirst ? Right : Left, Location, BestDistSq, BestSegment );
+}
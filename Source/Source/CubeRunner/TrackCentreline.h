@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABaseFloorPiece;
+
+struct FCentrelineSample
+{
+	FVector Location;
+	float Distance;
+
+	// Piece the segment ending at this sample lies on
+	ABaseFloorPiece* Piece;
+};
+
+// Polyline through the middle of every live floor piece, built as pieces are spawned and trimmed as they are removed
+// Distances are measured from the start of the level so they stay valid while the front is trimmed
+class CUBERUNNER_API FTrackCentreline
+{
+	// Functions
+public:
+	void AddPiece( ABaseFloorPiece* Piece );
+	void RemovePiece( ABaseFloorPiece* Piece );
+	void Reset();
+	void ApplyWorldOffset( const FVector& Offset );
+
+	bool IsEmpty() const { return Samples.Num() < 2; }
+	float GetStartDistance() const { return Samples.Num() ? Samples[ 0 ].Distance : 0.0f; }
+	float GetEndDistance() const { return Samples.Num() ? Samples.Last().Distance : 0.0f; }
+	const TArray< FCentrelineSample >& GetSamples() const { return Samples; }
+
+	// Distance along the centreline closest to the location, optionally with the signed offset to the right of it
+	float FindNearestDistance( const FVector& Location, float* OutLateralOffset = nullptr ) const;
+	ABaseFloorPiece* GetPieceAtDistance( const float Distance ) const;
+	FTransform GetTransformAtDistance( const float Distance ) const;
+
+private:
+	void AppendPoint( const FVector& Location, ABaseFloorPiece* Piece );
+	void CommitPendingBranch( const FVector& Entry );
+	int32 FindSegment( const float Distance ) const;
+	void BuildBounds() const;
+	void FindNearestSegment( const int32 Node, const FVector& Location, float& BestDistSq, int32& BestSegment ) const;
+
+	// Members
+	TArray< FCentrelineSample > Samples;
+
+	// Branches of the last split piece, whichever one the next piece connects to is kept
+	TArray< TArray< FVector > > PendingBranches;
+	ABaseFloorPiece* PendingBranchPiece = nullptr;
+
+	// Implicit bounding volume tree over the segments, rebuilt by the first query after a change
+	mutable TArray< FBox > SegmentBounds;
+	mutable int32 LeafCount = 0;
+	mutable bool BoundsDirty = true;
+};